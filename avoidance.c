@@ -0,0 +1,153 @@
+/** @file avoidance.c
+ * @brief Pauses the current move while a robot blocks the way.
+ * @sa avoidance.h
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+#include <uptime.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/position_manager.h>
+#include <holonomic/trajectory_manager.h>
+
+#include "cvra_cs.h"
+#include "obstacle_map.h"
+#include "path_follower.h"
+#include "avoidance.h"
+
+/* The order is given by the strategy and given again by avoidance_manage(),
+ * which runs in the timer interrupt, or in sim_step() on the host. */
+#define AVOIDANCE_LOCK()    CVRA_CS_LOCK()
+#define AVOIDANCE_UNLOCK()  CVRA_CS_UNLOCK()
+
+void avoidance_init(struct avoidance *a, struct robot_context *ctx) {
+    memset(a, 0, sizeof(struct avoidance));
+    a->ctx = ctx;
+    a->stop = AVOIDANCE_DEFAULT_STOP;
+    a->resume = AVOIDANCE_DEFAULT_RESUME;
+    a->clear_time = AVOIDANCE_DEFAULT_CLEAR;
+    a->give_up_time = AVOIDANCE_DEFAULT_GIVE_UP;
+    a->cone = AVOIDANCE_DEFAULT_CONE;
+    a->distance = a->resume;
+    a->enabled = 1;
+}
+
+void avoidance_enable(struct avoidance *a, int enabled) {
+    a->enabled = enabled;
+}
+
+void avoidance_goto_xy(struct avoidance *a, double x, double y) {
+    AVOIDANCE_LOCK();
+    a->goal_x = x;
+    a->goal_y = y;
+    a->goal_active = 1;
+    if(a->state != AVOIDANCE_PAUSED)
+        holonomic_trajectory_moving_straight_goto_xy_abs(&a->ctx->robot->traj, x, y);
+    AVOIDANCE_UNLOCK();
+}
+
+int avoidance_paused(struct avoidance *a) {
+    return a->state == AVOIDANCE_PAUSED;
+}
+
+int avoidance_gave_up(struct avoidance *a) {
+    int gave_up = a->gave_up;
+    a->gave_up = 0;
+    return gave_up;
+}
+
+static void avoidance_pause(struct avoidance *a, int32_t now) {
+    struct _rob *r = a->ctx->robot;
+
+    a->state = AVOIDANCE_PAUSED;
+    a->pause_start = now;
+    a->clear = 0;
+    a->pauses++;
+
+    /* Le suiveur freine tout seul, le trajectory manager ne sait pas. */
+    path_follower_pause(&r->follower);
+    if(a->goal_active) {
+        holonomic_delete_event(&r->traj);
+        rsh_set_speed(&r->rs, 0);
+        rsh_set_rotation_speed(&r->rs, 0);
+    }
+}
+
+static void avoidance_resume(struct avoidance *a) {
+    struct _rob *r = a->ctx->robot;
+
+    a->state = AVOIDANCE_CLEAR;
+    path_follower_resume(&r->follower);
+    if(a->goal_active)
+        holonomic_trajectory_moving_straight_goto_xy_abs(&r->traj, a->goal_x, a->goal_y);
+}
+
+/** Cancels the paused move, for the strategy to do something else. */
+static void avoidance_give_up(struct avoidance *a) {
+    struct _rob *r = a->ctx->robot;
+
+    a->state = AVOIDANCE_CLEAR;
+    a->goal_active = 0;
+    a->gave_up = 1;
+    a->give_ups++;
+
+    if(r->follower.active)
+        path_follower_stop(&r->follower);
+    path_follower_resume(&r->follower);
+}
+
+void avoidance_manage(struct avoidance *a) {
+    struct _rob *r = a->ctx->robot;
+    int32_t now = uptime_get();
+    double x, y;
+
+    /* A new move started : the last give up was not about it. */
+    if(a->gave_up && (r->follower.active || a->goal_active))
+        a->gave_up = 0;
+
+    if(a->goal_active && a->state == AVOIDANCE_CLEAR && holonomic_end_of_traj(&r->traj))
+        a->goal_active = 0;
+
+    if(!a->enabled) {
+        if(a->state == AVOIDANCE_PAUSED)
+            avoidance_resume(a);
+        return;
+    }
+
+    x = holonomic_position_get_x_double(&r->pos);
+    y = holonomic_position_get_y_double(&r->pos);
+
+    if(a->state == AVOIDANCE_CLEAR) {
+        /* Only the moves we know how to pause, and only when translating. */
+        if(!(r->follower.active || a->goal_active) ||
+           fabs(r->orca.desired_speed) < AVOIDANCE_MIN_SPEED) {
+            a->distance = a->resume;
+            return;
+        }
+
+        a->heading = r->orca.desired_heading;
+        if(r->orca.desired_speed < 0)
+            a->heading += M_PI;
+
+        a->distance = obstacle_map_nearest(&r->obstacles, x, y, a->heading, a->cone, a->resume);
+        if(a->distance < a->stop)
+            avoidance_pause(a, now);
+        return;
+    }
+
+    /* En pause : on garde la direction du mouvement interrompu. */
+    a->distance = obstacle_map_nearest(&r->obstacles, x, y, a->heading, a->cone, a->resume);
+
+    if(a->distance < a->resume)
+        a->clear = 0;
+    else if(!a->clear) {
+        a->clear = 1;
+        a->clear_since = now;
+    }
+
+    if(a->clear && now - a->clear_since >= a->clear_time)
+        avoidance_resume(a);
+    else if(now - a->pause_start >= a->give_up_time)
+        avoidance_give_up(a);
+}
@@ -0,0 +1,96 @@
+/** @file avoidance.h
+ * @brief Pauses the current move while a robot blocks the way.
+ *
+ * ORCA (see orca.h) slides around the other robots, but it cannot get past a
+ * robot parked in front of us. This is the last resort : when a robot or an
+ * obstacle (see obstacle_map.h) is closer than AVOIDANCE_DEFAULT_STOP in the
+ * direction we move, the current move is paused, and resumed where it was
+ * once the way is clear.
+ *
+ * Both thresholds have a hysteresis, so that a robot standing at the limit or
+ * a flickering beacon track does not make us stop and go at each tick :
+ *  - distance : the move pauses below stop and resumes only above resume ;
+ *  - time : the way must stay clear for clear_time before resuming.
+ *
+ * The paused move is kept, not deleted :
+ *  - the path follower brakes and waits on its path, then starts again from
+ *    zero speed (see path_follower_pause()) ;
+ *  - the trajectory manager cannot pause, so the order given through
+ *    avoidance_goto_xy() is cancelled and given again on resume.
+ * The control systems stay enabled during the pause : the wheels hold the
+ * robot still and nothing has to be enabled again.
+ *
+ * After give_up_time paused, the move is cancelled and test_traj_end()
+ * returns END_OBSTACLE : the strategy goes somewhere else and comes back
+ * later, an avoidance costs a few seconds at most.
+ */
+#ifndef _AVOIDANCE_H_
+#define _AVOIDANCE_H_
+
+#include <aversive.h>
+#include <math.h>
+
+#define AVOIDANCE_DEFAULT_STOP      250.      /**< mm, to the obstacle edge. */
+#define AVOIDANCE_DEFAULT_RESUME    400.      /**< mm, to the obstacle edge. */
+#define AVOIDANCE_DEFAULT_CLEAR     500000    /**< us */
+#define AVOIDANCE_DEFAULT_GIVE_UP   3000000   /**< us */
+#define AVOIDANCE_DEFAULT_CONE      (75. * M_PI / 180.) /**< rad, on each side. */
+
+/** Below this speed we are turning in place, nobody is in the way. */
+#define AVOIDANCE_MIN_SPEED         10.       /**< mm/s */
+
+typedef enum {
+    AVOIDANCE_CLEAR = 0,           /**< Moving normally. */
+    AVOIDANCE_PAUSED,              /**< A robot is in the way, the move waits. */
+} avoidance_state_t;
+
+struct robot_context;
+
+struct avoidance {
+    struct robot_context *ctx;
+
+    double stop, resume;           /**< Distance hysteresis, in mm. */
+    int32_t clear_time;            /**< The way must be clear this long to resume, in us. */
+    int32_t give_up_time;          /**< Paused this long, the move is cancelled, in us. */
+    double cone;                   /**< Robots further than this angle from our direction do not count, in rad. */
+
+    volatile avoidance_state_t state;
+    int32_t pause_start;           /**< us */
+    int32_t clear_since;           /**< Time the way became clear, in us. */
+    uint8_t clear;                 /**< =1 if the way is clear since clear_since. */
+    double heading;                /**< Direction of the paused move, in rad, table. */
+    double distance;               /**< To the nearest obstacle ahead, in mm, at most resume. */
+
+    /** Order of the trajectory manager, given again on resume. */
+    double goal_x, goal_y;
+    volatile uint8_t goal_active;
+
+    uint8_t enabled;
+    volatile uint8_t gave_up;      /**< =1 when a move was cancelled, see test_traj_end(). */
+    uint16_t pauses;
+    uint16_t give_ups;
+};
+
+/** Inits the state machine with the default parameters, enabled. */
+void avoidance_init(struct avoidance *a, struct robot_context *ctx);
+
+/** Enables or disables the pauses. Disabling resumes a paused move. */
+void avoidance_enable(struct avoidance *a, int enabled);
+
+/** Goes to (x, y) with the trajectory manager, in a way that can be paused.
+ *
+ * If the move is currently paused, the order is only given on resume.
+ */
+void avoidance_goto_xy(struct avoidance *a, double x, double y);
+
+/** Returns 1 while a move is paused. */
+int avoidance_paused(struct avoidance *a);
+
+/** Returns 1 once if a move was cancelled since the last call. */
+int avoidance_gave_up(struct avoidance *a);
+
+/** Looks for robots in the way and pauses or resumes the move.
+ * @note Must be called at each control tick, after path_follower_manage(). */
+void avoidance_manage(struct avoidance *a);
+
+#endif
@@ -0,0 +1,94 @@
+/** @file battery.c
+ * @brief Battery voltage, and compensation of its sag on the wheel PWMs.
+ * @sa battery.h
+ */
+
+#include <aversive.h>
+#include <string.h>
+#include <uptime.h>
+#include <scheduler.h>
+#include <cvra_dc.h>
+
+#include "hardware.h"
+#include "busstat.h"
+#include "log.h"
+#include "battery.h"
+
+void battery_init(struct battery *b, void *pwm_base) {
+    memset(b, 0, sizeof(struct battery));
+    b->pwm_base = pwm_base;
+    b->scale = 1.;
+    b->compensate = 0;
+
+    scheduler_add_periodical_event_priority(battery_manage, b, BATTERY_PERIOD / SCHEDULER_UNIT, 120);
+}
+
+void battery_set_compensation(struct battery *b, int enabled) {
+    b->compensate = enabled;
+    if(!enabled)
+        b->scale = 1.;
+}
+
+void battery_manage(void *data) {
+    struct battery *b = data;
+    double mv = (double)cvra_get_battery_voltage() * BATTERY_MV_PER_LSB;
+    double scale;
+    int32_t now = uptime_get();
+
+    if(mv < BATTERY_MIN_VALID_MV) {
+        b->valid = 0;
+        b->scale = 1.;
+        return;
+    }
+
+    /* Premiere mesure : le filtre part de la, pas de zero. */
+    if(!b->valid) {
+        b->voltage = b->min_voltage = mv;
+        b->valid = 1;
+    }
+    b->voltage += BATTERY_FILTER * (mv - b->voltage);
+    if(b->voltage < b->min_voltage)
+        b->min_voltage = b->voltage;
+
+    scale = BATTERY_NOMINAL_MV / b->voltage;
+    if(scale < BATTERY_MIN_SCALE)
+        scale = BATTERY_MIN_SCALE;
+    if(scale > BATTERY_MAX_SCALE)
+        scale = BATTERY_MAX_SCALE;
+    b->scale = b->compensate ? scale : 1.;
+
+    if(b->voltage < BATTERY_LOW_MV && !b->low) {
+        b->low = 1;
+        LWARNING(ERROR_DRIVERS, "battery low : %d mV", (int)b->voltage);
+    }
+
+    if(now - b->last_log >= BATTERY_LOG_PERIOD) {
+        b->last_log = now;
+        LNOTICE(ERROR_DRIVERS, "battery %d mV (min %d), pwm x%d/1000",
+                (int)b->voltage, (int)b->min_voltage, (int)(b->scale * 1000));
+    }
+}
+
+static int32_t battery_scale(struct battery *b, int32_t value) {
+    value = (int32_t)(value * b->scale);
+    if(value > BATTERY_PWM_MAX)
+        return BATTERY_PWM_MAX;
+    if(value < -BATTERY_PWM_MAX)
+        return -BATTERY_PWM_MAX;
+    return value;
+}
+
+void battery_set_pwm0(void *data, int32_t value) {
+    struct battery *b = data;
+    BUS_DC(cvra_dc_set_pwm0)(b->pwm_base, battery_scale(b, value));
+}
+
+void battery_set_pwm1(void *data, int32_t value) {
+    struct battery *b = data;
+    BUS_DC(cvra_dc_set_pwm1)(b->pwm_base, battery_scale(b, value));
+}
+
+void battery_set_pwm2(void *data, int32_t value) {
+    struct battery *b = data;
+    BUS_DC(cvra_dc_set_pwm2)(b->pwm_base, battery_scale(b, value));
+}
@@ -0,0 +1,66 @@
+/** @file battery.h
+ * @brief Battery voltage, and compensation of its sag on the wheel PWMs.
+ *
+ * The PIDs output a PWM duty, so the same output gives less voltage, so
+ * less torque, as the battery drains : the robot accelerates and tracks
+ * worse at the end of a match than at the start. The battery voltage is read
+ * on ADC_BATTERY_VOLTAGE and low-pass filtered, and the PWMs are multiplied
+ * by BATTERY_NOMINAL_MV / voltage on their way to the motor board : the
+ * motors get the voltage the PIDs were tuned with.
+ *
+ * The scale is limited to [BATTERY_MIN_SCALE, BATTERY_MAX_SCALE], and to
+ * 1 when the measure is missing (below BATTERY_MIN_VALID_MV, for example
+ * off the robot).
+ *
+ * @warning The divider on ADC_BATTERY_VOLTAGE is not wired yet : the channel
+ * floats and would scale the PWMs by noise. The measure is only compiled in
+ * with BATTERY_ENABLED (the BATTERY option of CMakeLists.txt), and the
+ * compensation starts disabled even then : enable it with the battery
+ * command once BATTERY_MV_PER_LSB is calibrated.
+ */
+#ifndef _BATTERY_H_
+#define _BATTERY_H_
+
+#include <aversive.h>
+
+#define BATTERY_MV_PER_LSB     30       /**< Divider and 10 bits ADC. To calibrate. */
+#define BATTERY_NOMINAL_MV     24000.   /**< Voltage the PIDs were tuned with. */
+#define BATTERY_LOW_MV         21000.   /**< A warning is logged below. */
+#define BATTERY_MIN_VALID_MV   12000.
+#define BATTERY_MIN_SCALE      0.8
+#define BATTERY_MAX_SCALE      1.3
+#define BATTERY_PWM_MAX        475      /**< See cvra_cs.c. */
+
+#define BATTERY_PERIOD         20000    /**< us */
+#define BATTERY_FILTER         0.02     /**< Weight of a new sample, about 1 s. */
+#define BATTERY_LOG_PERIOD     10000000 /**< us */
+
+struct battery {
+    void *pwm_base;                /**< Motor board. */
+
+    double voltage;                /**< Filtered, in mV. */
+    double min_voltage;            /**< Lowest filtered voltage, in mV. */
+    volatile double scale;         /**< Applied to the PWMs. */
+    uint8_t valid;                 /**< =1 if the measure is plausible. */
+    uint8_t compensate;            /**< =0 to send the PWMs unchanged. */
+    uint8_t low;                   /**< =1 once the low voltage was logged. */
+    int32_t last_log;              /**< us */
+};
+
+/** Inits the filter and schedules battery_manage().
+ * @param [in] pwm_base Base address of the motor board. */
+void battery_init(struct battery *b, void *pwm_base);
+
+/** Enables or disables the compensation. */
+void battery_set_compensation(struct battery *b, int enabled);
+
+/** Samples and filters the voltage, updates the scale. */
+void battery_manage(void *b);
+
+/** Process inputs of the wheel control systems : scale the PWM, then write it.
+ * @param [in] b The struct battery. */
+void battery_set_pwm0(void *b, int32_t value);
+void battery_set_pwm1(void *b, int32_t value);
+void battery_set_pwm2(void *b, int32_t value);
+
+#endif
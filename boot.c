@@ -0,0 +1,116 @@
+/** @file boot.c
+ * @brief Boot time measurement and hot restart.
+ * @sa boot.h
+ */
+
+#include <aversive.h>
+#include <uptime.h>
+#include <stddef.h>
+#include <string.h>
+#include <holonomic/position_manager.h>
+
+#include "fmt.h"
+#include "boot.h"
+#include "cvra_cs.h"
+#include "strat.h"
+
+/** Time at which each phase ended, in us since reset. */
+static int32_t boot_times[BOOT_NB_PHASES];
+
+static const char *boot_phase_names[BOOT_NB_PHASES] = {
+    "start",
+    "log",
+    "fast_math",
+    "scheduler",
+    "cs",
+    "hot_restart",
+    "ready",
+};
+
+/** Not cleared by the C runtime, survives a reset. */
+struct boot_hot_state boot_hot BOOT_NOINIT;
+
+void boot_mark(boot_phase_t phase) {
+    boot_times[phase] = uptime_get();
+}
+
+void boot_print_times(struct robot_context *ctx) {
+    int i;
+
+    for(i=0;i<BOOT_NB_PHASES;i++) {
+        fmt_printf("%-12s %8d us (+%d)\n", boot_phase_names[i], (int)boot_times[i],
+               i > 0 ? (int)(boot_times[i] - boot_times[i-1]) : 0);
+    }
+    fmt_printf("hot restarts: %d\n", boot_hot_available(ctx) ? (int)ctx->hot->restart_count : 0);
+}
+
+/** Checksum of everything before the checksum field. */
+static uint32_t boot_hot_checksum(struct boot_hot_state *hot) {
+    const uint32_t *p = (const uint32_t *)hot;
+    uint32_t sum = 0;
+    unsigned int i;
+
+    for(i=0;i<offsetof(struct boot_hot_state, checksum) / sizeof(uint32_t);i++)
+        sum += p[i];
+
+    return sum;
+}
+
+void boot_hot_save(struct robot_context *ctx) {
+    struct boot_hot_state *hot = ctx->hot;
+    int i;
+
+    if(hot == NULL || !ctx->strat->started)
+        return;
+
+    hot->magic = BOOT_HOT_RESTART_MAGIC;
+    hot->x = holonomic_position_get_x_double(&ctx->robot->pos);
+    hot->y = holonomic_position_get_y_double(&ctx->robot->pos);
+    hot->a = holonomic_position_get_a_rad_double(&ctx->robot->pos);
+    hot->color = ctx->strat->color;
+    hot->state = ctx->strat->state;
+    hot->sub_state = ctx->strat->sub_state;
+    hot->time = ctx->strat->time;
+    hot->gifts_done = 0;
+    for(i=0;i<4;i++) {
+        hot->plan[i] = ctx->strat->plan[i];
+        if(ctx->strat->gifts[i].done)
+            hot->gifts_done |= 1 << i;
+    }
+    hot->match_running = 1;
+    hot->checksum = boot_hot_checksum(hot);
+}
+
+int boot_hot_available(struct robot_context *ctx) {
+    struct boot_hot_state *hot = ctx->hot;
+
+    return hot != NULL
+        && hot->magic == BOOT_HOT_RESTART_MAGIC
+        && hot->checksum == boot_hot_checksum(hot)
+        && hot->match_running;
+}
+
+void boot_hot_restore(struct robot_context *ctx) {
+    struct boot_hot_state *hot = ctx->hot;
+    int i;
+
+    holonomic_position_set(&ctx->robot->pos, hot->x, hot->y, hot->a);
+
+    ctx->strat->color = hot->color;
+    strat_set_objects(ctx);
+    ctx->strat->state = hot->state;
+    ctx->strat->sub_state = hot->sub_state;
+    ctx->strat->time = hot->time;
+    for(i=0;i<4;i++) {
+        ctx->strat->plan[i] = hot->plan[i];
+        ctx->strat->gifts[i].done = (hot->gifts_done >> i) & 1;
+    }
+
+    hot->restart_count++;
+    hot->checksum = boot_hot_checksum(hot);
+}
+
+void boot_hot_clear(struct robot_context *ctx) {
+    if(ctx->hot != NULL)
+        memset(ctx->hot, 0, sizeof(*ctx->hot));
+}
@@ -0,0 +1,87 @@
+/** @file boot.h
+ * @brief Boot time measurement and hot restart.
+ *
+ * Every init phase of main() is timestamped with boot_mark(), so we know how
+ * long a reset takes before the robot can drive again.
+ *
+ * After a brownout in the middle of a match, the robot should not start from
+ * scratch : the pose and the strategy state are saved at every control tick
+ * in a RAM area which is not cleared by the C runtime. At boot, if this area
+ * holds a valid state, it is restored and the match resumes right away
+ * instead of waiting on the command line.
+ *
+ * @note On the robot, the BSP linker script must place the .noinit section
+ * outside of .bss, or the state will be zeroed at every reset.
+ */
+#ifndef _BOOT_H_
+#define _BOOT_H_
+
+#include <aversive.h>
+
+#ifdef COMPILE_ON_ROBOT
+#define BOOT_NOINIT __attribute__((section(".noinit")))
+#else
+#define BOOT_NOINIT
+#endif
+
+/** Magic number marking a valid hot restart state. */
+#define BOOT_HOT_RESTART_MAGIC 0x484f5421
+
+/** Init phases of main(), in order. */
+typedef enum {
+    BOOT_START=0,      /**< Entry in main(). */
+    BOOT_LOG,          /**< Error hooks registered. */
+    BOOT_FAST_MATH,    /**< fast_math tables generated. */
+    BOOT_SCHEDULER,    /**< Scheduler and tick interrupt running. */
+    BOOT_CS,           /**< Control systems running. */
+    BOOT_HOT_RESTART,  /**< Hot restart state checked (and restored). */
+    BOOT_READY,        /**< Command line ready. */
+    BOOT_NB_PHASES
+} boot_phase_t;
+
+/** State preserved across a reset. */
+struct boot_hot_state {
+    uint32_t magic;
+    uint32_t restart_count;  /**< Number of hot restarts during this match. */
+
+    float x, y, a;           /**< Pose, in mm and rad. */
+
+    int32_t color;
+    int32_t state;
+    int32_t sub_state;
+    int32_t time;
+    int32_t plan[4];
+    uint8_t gifts_done;      /**< Bit i set if gift i is done. */
+    uint8_t match_running;
+
+    uint32_t checksum;       /**< Sum of all the previous words. */
+};
+
+struct robot_context;
+
+/** The state of the robot build, in the .noinit section. Simulated robots
+ * can have their own, see robot_context.hot. */
+extern struct boot_hot_state boot_hot;
+
+/** Records the end of an init phase. */
+void boot_mark(boot_phase_t phase);
+
+/** Prints the time spent in each init phase. */
+void boot_print_times(struct robot_context *ctx);
+
+/** Saves the pose and strategy state if a match is running.
+ *
+ * @note Called at every control tick, kept cheap.
+ */
+void boot_hot_save(struct robot_context *ctx);
+
+/** Returns 1 if a valid state of a running match survived the reset. */
+int boot_hot_available(struct robot_context *ctx);
+
+/** Restores the pose and the strategy state saved before the reset. */
+void boot_hot_restore(struct robot_context *ctx);
+
+/** Invalidates the saved state, for example at the end of the match. */
+void boot_hot_clear(struct robot_context *ctx);
+
+#endif
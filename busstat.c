@@ -0,0 +1,135 @@
+/** @file busstat.c
+ * @brief Hardware bus access counters.
+ * @sa busstat.h
+ */
+
+#include <aversive.h>
+#include <string.h>
+#include <cvra_dc.h>
+#include <cvra_servo.h>
+
+#include "fmt.h"
+#include "busstat.h"
+
+#ifdef BUS_STATS_ENABLED
+
+static const char *busstat_names[BUS_NB_DEVICES] = {
+    "motor",
+    "servo",
+    "pio",
+    "beacon",
+    "misc",
+};
+
+/** Counters of a device, index 0 for reads and 1 for writes. */
+struct busstat_counter {
+    uint16_t current[2];   /**< Accesses since the last tick. */
+    uint16_t max[2];       /**< Maximum accesses in one tick. */
+    uint32_t total[2];     /**< Accesses in all the closed ticks. */
+};
+
+static struct busstat_counter busstat_counters[BUS_NB_DEVICES];
+static uint32_t busstat_ticks;
+
+/* The increments are not atomic, an access counted in the foreground can be
+ * lost if the control loop preempts it. This is acceptable for statistics. */
+void busstat_count(bus_device_t dev, int write) {
+    busstat_counters[dev].current[write]++;
+}
+
+void busstat_tick(void) {
+    struct busstat_counter *c;
+    int i, j;
+
+    for(i=0;i<BUS_NB_DEVICES;i++) {
+        c = &busstat_counters[i];
+        for(j=0;j<2;j++) {
+            if(c->current[j] > c->max[j])
+                c->max[j] = c->current[j];
+            c->total[j] += c->current[j];
+            c->current[j] = 0;
+        }
+    }
+    busstat_ticks++;
+}
+
+void busstat_print(void) {
+    struct busstat_counter *c;
+    int i;
+
+    fmt_printf("%u ticks\n", (unsigned int)busstat_ticks);
+    fmt_printf("device    rd avg  rd max  wr avg  wr max\n");
+    for(i=0;i<BUS_NB_DEVICES;i++) {
+        c = &busstat_counters[i];
+        /* Averages in hundredths of access per tick. */
+        fmt_printf("%-8s %4u.%02u %7u %4u.%02u %7u\n", busstat_names[i],
+               (unsigned int)(busstat_ticks ? c->total[0] * 100 / busstat_ticks / 100 : 0),
+               (unsigned int)(busstat_ticks ? c->total[0] * 100 / busstat_ticks % 100 : 0),
+               (unsigned int)c->max[0],
+               (unsigned int)(busstat_ticks ? c->total[1] * 100 / busstat_ticks / 100 : 0),
+               (unsigned int)(busstat_ticks ? c->total[1] * 100 / busstat_ticks % 100 : 0),
+               (unsigned int)c->max[1]);
+    }
+}
+
+void busstat_reset(void) {
+    memset(busstat_counters, 0, sizeof(busstat_counters));
+    busstat_ticks = 0;
+}
+
+void busstat_cvra_dc_set_pwm0(void *base, int32_t value) {
+    busstat_count(BUS_MOTOR, 1);
+    cvra_dc_set_pwm0(base, value);
+}
+
+void busstat_cvra_dc_set_pwm1(void *base, int32_t value) {
+    busstat_count(BUS_MOTOR, 1);
+    cvra_dc_set_pwm1(base, value);
+}
+
+void busstat_cvra_dc_set_pwm2(void *base, int32_t value) {
+    busstat_count(BUS_MOTOR, 1);
+    cvra_dc_set_pwm2(base, value);
+}
+
+int32_t busstat_cvra_dc_get_encoder0(void *base) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_encoder0(base);
+}
+
+int32_t busstat_cvra_dc_get_encoder1(void *base) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_encoder1(base);
+}
+
+int32_t busstat_cvra_dc_get_encoder2(void *base) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_encoder2(base);
+}
+
+int32_t busstat_cvra_dc_get_index0(void *base) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_index0(base);
+}
+
+int32_t busstat_cvra_dc_get_index1(void *base) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_index1(base);
+}
+
+int32_t busstat_cvra_dc_get_index2(void *base) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_index2(base);
+}
+
+int32_t busstat_cvra_dc_get_current(void *base, int channel) {
+    busstat_count(BUS_MOTOR, 0);
+    return cvra_dc_get_current(base, channel);
+}
+
+void busstat_cvra_servo_set(void *base, int channel, uint32_t value) {
+    busstat_count(BUS_SERVO, 1);
+    cvra_servo_set(base, channel, value);
+}
+
+#endif
@@ -0,0 +1,76 @@
+/** @file busstat.h
+ * @brief Hardware bus access counters.
+ *
+ * Every access to the motor controller, the servos, the PIO or the beacon is
+ * an uncached Avalon transfer. When BUS_STATS_ENABLED is defined, the
+ * accesses done through the macros below are counted per device, and the
+ * counts are accumulated at every control tick. The `bus` command then gives
+ * the average and maximum number of reads and writes per tick, which shows
+ * the redundant register traffic.
+ *
+ * Without BUS_STATS_ENABLED the macros expand to the plain accesses.
+ *
+ * @note Accesses done inside the shared modules (for example the beacon
+ * interrupt) do not go through these macros and are not counted.
+ */
+#ifndef _BUSSTAT_H_
+#define _BUSSTAT_H_
+
+#include <aversive.h>
+#include <cvra_dc.h>
+
+/** Devices on the Avalon bus. */
+typedef enum {
+    BUS_MOTOR=0, /**< Hex motor controller. */
+    BUS_SERVO,   /**< Servo controller. */
+    BUS_PIO,     /**< Digital inputs (starter, ...) */
+    BUS_BEACON,  /**< Rotating beacon. */
+    BUS_MISC,    /**< LEDs and tick timer. */
+    BUS_NB_DEVICES
+} bus_device_t;
+
+#ifdef BUS_STATS_ENABLED
+
+/** Selects the counting wrapper of a driver function, for example
+ * BUS_DC(cvra_dc_set_pwm0) is busstat_cvra_dc_set_pwm0. */
+#define BUS_DC(f) busstat_##f
+
+#define BUS_IORD(dev, base, reg) (busstat_count((dev), 0), IORD((base), (reg)))
+#define BUS_IOWR(dev, base, reg, value) do { busstat_count((dev), 1); IOWR((base), (reg), (value)); } while(0)
+
+/** Counts one access, use the macros instead. */
+void busstat_count(bus_device_t dev, int write);
+
+/** Closes the counts of the current tick. Called at the end of the control loop. */
+void busstat_tick(void);
+
+/** Prints the average and maximum accesses per tick for each device. */
+void busstat_print(void);
+
+/** Clears all the counts. */
+void busstat_reset(void);
+
+/* Counting wrappers of the driver functions. */
+void busstat_cvra_dc_set_pwm0(void *base, int32_t value);
+void busstat_cvra_dc_set_pwm1(void *base, int32_t value);
+void busstat_cvra_dc_set_pwm2(void *base, int32_t value);
+int32_t busstat_cvra_dc_get_encoder0(void *base);
+int32_t busstat_cvra_dc_get_encoder1(void *base);
+int32_t busstat_cvra_dc_get_encoder2(void *base);
+int32_t busstat_cvra_dc_get_index0(void *base);
+int32_t busstat_cvra_dc_get_index1(void *base);
+int32_t busstat_cvra_dc_get_index2(void *base);
+int32_t busstat_cvra_dc_get_current(void *base, int channel);
+void busstat_cvra_servo_set(void *base, int channel, uint32_t value);
+
+#else
+
+#define BUS_DC(f) f
+#define BUS_IORD(dev, base, reg) IORD((base), (reg))
+#define BUS_IOWR(dev, base, reg, value) IOWR((base), (reg), (value))
+
+#define busstat_tick() do {} while(0)
+
+#endif
+
+#endif
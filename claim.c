@@ -0,0 +1,153 @@
+/** @file claim.c
+ * @brief Objectives claimed by each robot of the team.
+ * @sa claim.h for the rules.
+ */
+
+#include <aversive.h>
+#include <string.h>
+#include <uptime.h>
+
+#include "cvra_cs.h"
+#include "claim.h"
+
+/* The table is written by the strategy and by team_sync_manage(), which
+ * runs in the timer interrupt, or in sim_step() on the host. */
+#define CLAIM_LOCK()    CVRA_CS_LOCK()
+#define CLAIM_UNLOCK()  CVRA_CS_UNLOCK()
+
+void claim_init(struct claim_table *t, uint8_t id) {
+    memset(t, 0, sizeof(struct claim_table));
+    t->id = id;
+}
+
+/** Frees the lease if it expired. */
+static void claim_expire(struct claim *c, int32_t now) {
+    if((c->state == CLAIM_OURS || c->state == CLAIM_TEAMMATE) && now - c->expiry >= 0)
+        c->state = CLAIM_FREE;
+}
+
+claim_state_t claim_get(struct claim_table *t, int node) {
+    claim_state_t state;
+
+    if(node < 1 || node >= CLAIM_NB_NODES)
+        return CLAIM_FREE;
+
+    CLAIM_LOCK();
+    claim_expire(&t->c[node], uptime_get());
+    state = t->c[node].state;
+    CLAIM_UNLOCK();
+
+    return state;
+}
+
+int claim_try(struct claim_table *t, int node, uint16_t cost) {
+    int32_t now = uptime_get();
+    struct claim *c;
+    int i, ok = 0;
+
+    if(node < 1 || node >= CLAIM_NB_NODES)
+        return 0;
+
+    CLAIM_LOCK();
+    c = &t->c[node];
+    claim_expire(c, now);
+
+    if(c->state == CLAIM_FREE || c->state == CLAIM_OURS) {
+        for(i=1;i<CLAIM_NB_NODES;i++)
+            if(i != node && t->c[i].state == CLAIM_OURS)
+                t->c[i].state = CLAIM_FREE;
+
+        c->state = CLAIM_OURS;
+        c->cost = cost;
+        c->expiry = now + CLAIM_LEASE_MIN + 2000 * (int32_t)cost;
+        ok = 1;
+    }
+    CLAIM_UNLOCK();
+
+    return ok;
+}
+
+void claim_release(struct claim_table *t, int node) {
+    if(node < 1 || node >= CLAIM_NB_NODES)
+        return;
+
+    CLAIM_LOCK();
+    if(t->c[node].state == CLAIM_OURS)
+        t->c[node].state = CLAIM_FREE;
+    CLAIM_UNLOCK();
+}
+
+void claim_done(struct claim_table *t, int node) {
+    if(node < 1 || node >= CLAIM_NB_NODES)
+        return;
+
+    CLAIM_LOCK();
+    t->c[node].state = CLAIM_DONE;
+    CLAIM_UNLOCK();
+}
+
+int claim_lease(struct claim_table *t, uint16_t *cost) {
+    int32_t now = uptime_get();
+    int i, lease = -1;
+
+    CLAIM_LOCK();
+    for(i=1;i<CLAIM_NB_NODES;i++) {
+        claim_expire(&t->c[i], now);
+        if(t->c[i].state == CLAIM_OURS) {
+            lease = i;
+            if(cost)
+                *cost = t->c[i].cost;
+        }
+    }
+    CLAIM_UNLOCK();
+
+    return lease;
+}
+
+uint16_t claim_done_mask(struct claim_table *t) {
+    uint16_t mask = 0;
+    int i;
+
+    for(i=1;i<CLAIM_NB_NODES;i++)
+        if(t->c[i].state == CLAIM_DONE)
+            mask |= 1 << (i - 1);
+
+    return mask;
+}
+
+void claim_update_peer(struct claim_table *t, int lease, uint16_t cost, uint16_t done) {
+    int32_t now = uptime_get();
+    struct claim *c;
+    int i;
+
+    CLAIM_LOCK();
+    for(i=1;i<CLAIM_NB_NODES;i++) {
+        c = &t->c[i];
+
+        if(done & (1 << (i - 1))) {
+            c->state = CLAIM_DONE;
+            continue;
+        }
+
+        if(i != lease) {
+            /* It released the lease, or gave it to us. */
+            if(c->state == CLAIM_TEAMMATE)
+                c->state = CLAIM_FREE;
+            continue;
+        }
+
+        claim_expire(c, now);
+
+        /* Both claimed it : the cheapest one keeps it, robot 0 on a tie. */
+        if(c->state == CLAIM_OURS &&
+           (c->cost < cost || (c->cost == cost && t->id == 0)))
+            continue;
+
+        if(c->state != CLAIM_DONE) {
+            c->state = CLAIM_TEAMMATE;
+            c->cost = cost;
+            c->expiry = now + CLAIM_PEER_TIMEOUT;
+        }
+    }
+    CLAIM_UNLOCK();
+}
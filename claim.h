@@ -0,0 +1,83 @@
+/** @file claim.h
+ * @brief Objectives claimed by each robot of the team.
+ *
+ * Before going to an objective (a gift, a glass), a robot takes a lease on
+ * it and advertises it to its teammate through team_sync. A robot holds at
+ * most one lease at a time, with the estimated travel time to the
+ * objective as its cost.
+ *
+ * Leases expire on their own, so a robot which is stuck, or a teammate we
+ * do not hear anymore, does not keep an objective for the rest of the
+ * match :
+ *  - our lease lasts CLAIM_LEASE_MIN plus twice its cost,
+ *  - a lease of the teammate is forgotten CLAIM_PEER_TIMEOUT after the
+ *    last state in which it was advertised.
+ *
+ * When both robots claim the same objective at the same time (the claims
+ * cross on the link), the one with the smallest cost keeps it, robot 0 on
+ * a tie. The other one sees it when it receives the state of its teammate.
+ */
+#ifndef _CLAIM_H_
+#define _CLAIM_H_
+
+#include <aversive.h>
+
+/** Number of objectives, one per place of the travel cost matrix (see
+ * STRAT_NB_NODES). Objective 0, the start, is never claimed. */
+#define CLAIM_NB_NODES 17
+
+/** Minimum duration of our leases, in us. */
+#define CLAIM_LEASE_MIN 3000000
+
+/** A lease of the teammate expires this long after it was last seen, in us. */
+#define CLAIM_PEER_TIMEOUT 1500000
+
+typedef enum {
+    CLAIM_FREE=0,
+    CLAIM_OURS,        /**< We hold the lease. */
+    CLAIM_TEAMMATE,    /**< The teammate holds the lease. */
+    CLAIM_DONE,        /**< Done by one of us, nothing left to do there. */
+} claim_state_t;
+
+struct claim {
+    uint8_t state;     /**< A claim_state_t. */
+    uint16_t cost;     /**< Travel time of the holder, in ms. */
+    int32_t expiry;    /**< End of the lease, in us. */
+};
+
+struct claim_table {
+    struct claim c[CLAIM_NB_NODES];
+    uint8_t id;        /**< Our index in the team, breaks ties. */
+};
+
+/** Empties the table. */
+void claim_init(struct claim_table *t, uint8_t id);
+
+/** State of an objective, leases which expired are free. */
+claim_state_t claim_get(struct claim_table *t, int node);
+
+/** Takes (or renews) the lease on an objective, releasing the one we held.
+ * @param [in] cost Our travel time to the objective, in ms.
+ * @returns 1 if the lease is ours, 0 if it is done or held by the teammate. */
+int claim_try(struct claim_table *t, int node, uint16_t cost);
+
+/** Gives the lease back. */
+void claim_release(struct claim_table *t, int node);
+
+/** Marks the objective done, by us or by the teammate. */
+void claim_done(struct claim_table *t, int node);
+
+/** The objective we hold a lease on, -1 if none.
+ * @param [out] cost The cost of the lease, can be NULL. */
+int claim_lease(struct claim_table *t, uint16_t *cost);
+
+/** Bit n-1 is set if objective n is done. */
+uint16_t claim_done_mask(struct claim_table *t);
+
+/** Merges a state received from the teammate.
+ * @param [in] lease The objective it holds, -1 if none.
+ * @param [in] cost The cost of its lease.
+ * @param [in] done Objectives it knows are done, see claim_done_mask(). */
+void claim_update_peer(struct claim_table *t, int lease, uint16_t cost, uint16_t done);
+
+#endif
@@ -0,0 +1,112 @@
+/** @file clearance.c
+ * @brief Free distance around the robot, to slow down near obstacles.
+ * @sa clearance.h
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+
+#include "cvra_cs.h"
+#include "strat.h"
+#include "obstacle_map.h"
+#include "path_follower.h"
+#include "clearance.h"
+
+/** The cake, a half disc in the middle of the border opposite to the gifts,
+ * in the frame of the red team. */
+#define CLEARANCE_CAKE_X      1500.
+#define CLEARANCE_CAKE_Y      0.
+#define CLEARANCE_CAKE_RADIUS 500.
+
+/** Distance from (x, y) to the nearest fixed element, in mm. */
+static double clearance_fixed(double x, double y) {
+    double d = x;
+
+    if(TABLE_X_MM - x < d)
+        d = TABLE_X_MM - x;
+    if(y < d)
+        d = y;
+    if(TABLE_Y_MM - y < d)
+        d = TABLE_Y_MM - y;
+
+    double cake = hypot(x - CLEARANCE_CAKE_X, y - CLEARANCE_CAKE_Y) - CLEARANCE_CAKE_RADIUS;
+    if(cake < d)
+        d = cake;
+
+    return d < 0 ? 0 : d;
+}
+
+void clearance_init(struct clearance_map *m, struct robot_context *ctx) {
+    int i, j;
+    double d;
+
+    m->ctx = ctx;
+    m->stop = CLEARANCE_DEFAULT_STOP;
+    m->slow = CLEARANCE_DEFAULT_SLOW;
+
+    for(j=0;j<CLEARANCE_NY;j++) {
+        for(i=0;i<CLEARANCE_NX;i++) {
+            d = clearance_fixed(i * CLEARANCE_CELL, j * CLEARANCE_CELL) / CLEARANCE_UNIT;
+            m->wall[j][i] = d > 255 ? 255 : (uint8_t)(d + 0.5);
+        }
+    }
+}
+
+void clearance_attach(struct clearance_map *m, struct path_follower *pf) {
+    path_follower_set_clearance(pf, clearance_get, m, m->stop, m->slow);
+}
+
+double clearance_wall(struct clearance_map *m, double x, double y) {
+    double fx, fy;
+    int i, j;
+
+    /* Le champ est calcule pour les rouges. */
+    y = COLOR_Y(m->ctx->strat, y);
+
+    fx = x / CLEARANCE_CELL;
+    fy = y / CLEARANCE_CELL;
+
+    /* Outside of the table : touching the border. */
+    if(fx < 0 || fy < 0 || fx > CLEARANCE_NX - 1 || fy > CLEARANCE_NY - 1)
+        return 0;
+
+    i = (int)fx;
+    j = (int)fy;
+    if(i > CLEARANCE_NX - 2)
+        i = CLEARANCE_NX - 2;
+    if(j > CLEARANCE_NY - 2)
+        j = CLEARANCE_NY - 2;
+    fx -= i;
+    fy -= j;
+
+    /* Bilineaire, pour que la vitesse ne saute pas d'une case a l'autre. */
+    return CLEARANCE_UNIT *
+        ((1 - fy) * ((1 - fx) * m->wall[j][i] + fx * m->wall[j][i+1]) +
+         fy * ((1 - fx) * m->wall[j+1][i] + fx * m->wall[j+1][i+1]));
+}
+
+double clearance_robots(struct clearance_map *m, double x, double y) {
+    /* Au-dela de slow la vitesse n'est plus limitee. */
+    return obstacle_map_nearest(&m->ctx->robot->obstacles, x, y, 0., M_PI,
+                                m->slow + CLEARANCE_ROBOT_RADIUS) - CLEARANCE_ROBOT_RADIUS;
+}
+
+double clearance_get(void *param, double x, double y) {
+    struct clearance_map *m = param;
+    double robots = clearance_robots(m, x, y);
+    double wall = clearance_wall(m, x, y) - CLEARANCE_ROBOT_RADIUS;
+    double scale;
+
+    /* The follower maps [stop, slow] to [0, max speed] : give the wall
+     * distance as the clearance which gives the wanted scale. */
+    scale = wall / CLEARANCE_WALL_SLOW;
+    if(scale < 0)
+        scale = 0;
+    if(scale > 1)
+        scale = 1;
+    scale = CLEARANCE_WALL_MIN_SCALE + (1 - CLEARANCE_WALL_MIN_SCALE) * scale;
+    wall = m->stop + scale * (m->slow - m->stop);
+
+    return robots < wall ? robots : wall;
+}
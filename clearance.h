@@ -0,0 +1,76 @@
+/** @file clearance.h
+ * @brief Free distance around the robot, to slow down near obstacles.
+ *
+ * Gives the path follower the clearance function it uses to limit its
+ * speed (see path_follower_set_clearance()), so the robot slows down
+ * progressively instead of either driving full speed or stopping dead :
+ *
+ *  - Near the other robots and obstacles (see obstacle_map.h), the
+ *    clearance is the free distance between them and us : the follower
+ *    stops below CLEARANCE_DEFAULT_STOP and is at full speed above
+ *    CLEARANCE_DEFAULT_SLOW.
+ *  - Near the fixed elements (borders, cake), the robot must still be able
+ *    to touch them : the speed goes down linearly to CLEARANCE_WALL_MIN_SCALE
+ *    of the maximum at contact, and is not limited beyond
+ *    CLEARANCE_WALL_SLOW.
+ *
+ * The distance to the fixed elements is computed once at init on a grid of
+ * CLEARANCE_CELL mm, and interpolated at run time : the control loop only
+ * does a few lookups and the distances to two or three robots.
+ */
+#ifndef _CLEARANCE_H_
+#define _CLEARANCE_H_
+
+#include <aversive.h>
+
+#include "cvra_param_robot.h"
+
+/** Size of a cell of the distance field, in mm. */
+#define CLEARANCE_CELL 50
+
+/** Number of points of the field, the borders included. */
+#define CLEARANCE_NX (TABLE_X_MM / CLEARANCE_CELL + 1)
+#define CLEARANCE_NY (TABLE_Y_MM / CLEARANCE_CELL + 1)
+
+/** Resolution of the stored distances, in mm. */
+#define CLEARANCE_UNIT 10
+
+#define CLEARANCE_DEFAULT_STOP   100.  /**< mm */
+#define CLEARANCE_DEFAULT_SLOW   500.  /**< mm */
+#define CLEARANCE_WALL_SLOW      200.  /**< mm */
+#define CLEARANCE_WALL_MIN_SCALE 0.3
+
+/** Radius of our robot, in mm. */
+#define CLEARANCE_ROBOT_RADIUS    ROBOT_RADIUS_MM
+
+struct robot_context;
+struct path_follower;
+
+struct clearance_map {
+    struct robot_context *ctx;
+    double stop, slow;             /**< Limits given to the path follower. */
+
+    /** Distance from each point to the nearest fixed element, in
+     * CLEARANCE_UNIT, in the frame of the red team. */
+    uint8_t wall[CLEARANCE_NY][CLEARANCE_NX];
+};
+
+/** Computes the distance field. */
+void clearance_init(struct clearance_map *m, struct robot_context *ctx);
+
+/** Makes the path follower use this clearance. */
+void clearance_attach(struct clearance_map *m, struct path_follower *pf);
+
+/** Distance from our robot at (x, y) to the fixed elements, in mm, in the
+ * frame of our color. */
+double clearance_wall(struct clearance_map *m, double x, double y);
+
+/** Free distance between our robot at (x, y) and the nearest obstacle, in
+ * mm, at most the slow limit. */
+double clearance_robots(struct clearance_map *m, double x, double y);
+
+/** The clearance function given to the path follower.
+ * @param [in] m The struct clearance_map. */
+double clearance_get(void *m, double x, double y);
+
+#endif
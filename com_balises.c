@@ -11,125 +11,121 @@
 
 #include <unistd.h>
 #include <fcntl.h>
-#include <stdio.h>
 
+#include "fmt.h"
+#include "trace.h"
+#include "com_balises.h"
 
-void beaconTask(void *dummy);
 
-static int fileDescriptor;
 
-typedef enum {
-	MAGIC1=0,
-	MAGIC2,
-	MAGIC3,
-	POS_X_FOE_1H,
-	POS_X_FOE_1L,
-	POS_Y_FOE_1H,
-	POS_Y_FOE_1L,
-	POS_A_FOE_1H,
-	POS_A_FOE_1L,
-	POS_X_FOE_2H,
-	POS_X_FOE_2L,
-	POS_Y_FOE_2H,
-	POS_Y_FOE_2L
-} transmit_state_t;
 
-static transmit_state_t state;
-
-int pos1X, pos1Y, pos1A, pos2X, pos2Y;
-
-void init_beacons(char *device) {
-	fileDescriptor = open(device, O_RDONLY | O_NONBLOCK | O_NOCTTY );
-	if(fileDescriptor == -1) {
-		printf("Error opening file.");
+void init_beacons(struct beacon_com *b, char *device) {
+	b->fd = open(device, O_RDONLY | O_NONBLOCK | O_NOCTTY );
+	if(b->fd == -1) {
+		fmt_printf("Error opening file.");
 
 	}
 	else
-		scheduler_add_periodical_event(beaconTask, beaconTask, 1000);
+		scheduler_add_periodical_event(beaconTask, b, 1000);
 
-	state = MAGIC1;
+	b->state = MAGIC1;
+	b->frames = 0;
 }
 
 
-void beaconTask(__attribute__((unused)) void *dummy) {
+void beaconTask(void *data) {
+	struct beacon_com *b = data;
 	unsigned char buf;
-	while(read(fileDescriptor, &buf, 1) > 0) {
-		switch(state) {
+	TRACE_BEGIN(TRACE_BEACON);
+	while(read(b->fd, &buf, 1) > 0) {
+		switch(b->state) {
 		case MAGIC1:
 			if(buf == 'A') {
-				state = MAGIC2;
+				b->state = MAGIC2;
 			}
 			break;
 
 		case MAGIC2:
 			if(buf == 'B') {
-				state = MAGIC3;
+				b->state = MAGIC3;
 			} else {
-				state = MAGIC1;
+				b->state = MAGIC1;
 			}
 			break;
 
 		case MAGIC3:
 			if(buf == 'C') {
-				state = POS_X_FOE_1H;
+				b->state = POS_X_FOE_1H;
 			} else {
-				state = MAGIC1;
+				b->state = MAGIC1;
 			}
 			break;
 
 		case POS_X_FOE_1H:
-			pos1X = buf << 8;
-			state++;
+			b->pos1X = buf << 8;
+			b->state++;
 			break;
 
 		case POS_X_FOE_1L:
-			pos1X |= buf;
-			state++;
+			b->pos1X |= buf;
+			b->state++;
 			break;
 
 		case POS_Y_FOE_1H:
-			pos1Y = buf << 8;
-					state++;
+			b->pos1Y = buf << 8;
+					b->state++;
 					break;
 
 		case POS_Y_FOE_1L:
-					pos1Y |= buf;
-					state++;
+					b->pos1Y |= buf;
+					b->state++;
 					break;
 
 		case POS_A_FOE_1H:
-			pos1A = buf << 8;
-					state++;
+			b->pos1A = buf << 8;
+					b->state++;
 					break;
 
 		case POS_A_FOE_1L:
-					pos1A |= buf;
-					state++;
+					b->pos1A |= buf;
+					b->state++;
 					break;
 
 
 		case POS_X_FOE_2H:
-			pos2X = buf << 8;
-					state++;
+			b->pos2X = buf << 8;
+					b->state++;
 					break;
 
 		case POS_X_FOE_2L:
-					pos2X |= buf;
-					state++;
+					b->pos2X |= buf;
+					b->state++;
 					break;
 
 		case POS_Y_FOE_2H:
-			pos2X = buf << 8;
-					state++;
+			b->pos2Y = buf << 8;
+					b->state++;
 					break;
 
 		case POS_Y_FOE_2L:
-					pos2X |= buf;
-					state = MAGIC1;
-					printf("opponnent %d %d\r", pos1X, pos1Y);
+					b->pos2Y |= buf;
+					b->state = MAGIC1;
+					b->frames++;
+					fmt_printf("opponnent %d %d\r", b->pos1X, b->pos1Y);
 					break;
 
 		}
-		putchar(buf);
+		fmt_putchar(buf);
 	}
+	TRACE_END(TRACE_BEACON);
+}
+
+void getPosRobot1(struct beacon_com *b, int *x, int *y) {
+	*x = b->pos1X;
+	*y = b->pos1Y;
+}
+
+void getPosRobot2(struct beacon_com *b, int *x, int *y) {
+	*x = b->pos2X;
+	*y = b->pos2Y;
 }
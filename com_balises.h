@@ -8,10 +8,42 @@
 #ifndef COMM_BALISES_H_
 #define COMM_BALISES_H_
 
-void init_beacons(void);
+#include <stdint.h>
 
-void getPosRobot1(int *x, int *y);
-void getPosRobot2(int *x, int *y);
+typedef enum {
+	MAGIC1=0,
+	MAGIC2,
+	MAGIC3,
+	POS_X_FOE_1H,
+	POS_X_FOE_1L,
+	POS_Y_FOE_1H,
+	POS_Y_FOE_1L,
+	POS_A_FOE_1H,
+	POS_A_FOE_1L,
+	POS_X_FOE_2H,
+	POS_X_FOE_2L,
+	POS_Y_FOE_2H,
+	POS_Y_FOE_2L
+} transmit_state_t;
+
+/** State of the link with the beacon board. One instance per robot, so
+ * several simulated robots can each read their own link. */
+struct beacon_com {
+	int fd;                        /**< Serial port of the beacon board. */
+	transmit_state_t state;        /**< Position in the frame. */
+	int pos1X, pos1Y, pos1A;       /**< Last position of the first opponent. */
+	int pos2X, pos2Y;              /**< Last position of the second opponent. */
+	volatile uint32_t frames;      /**< Complete frames received, see selftest.h. */
+};
+
+/** Opens the link and schedules beaconTask(). */
+void init_beacons(struct beacon_com *b, char *device);
+
+/** Decodes the bytes received from the beacon board. */
+void beaconTask(void *b);
+
+void getPosRobot1(struct beacon_com *b, int *x, int *y);
+void getPosRobot2(struct beacon_com *b, int *x, int *y);
 
 
 #endif /* COMM_BALISES_H_ */
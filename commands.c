@@ -1,16 +1,23 @@
 #include <commandline.h>
 #include <string.h>
-#include <stdio.h>
 #include <cvra_servo.h>
+#include "fmt.h"
 #include "adresses.h"
 #include "cvra_cs.h"
+#include "hardware.h"
 #include "strat.h"
+#include "boot.h"
+#include "memcheck.h"
+#include "trace.h"
+#include "busstat.h"
+#include "log.h"
+#include "selftest.h"
 
 /** Prints all args, then exits. */
 void test_func(int argc, char **argv) {
     int i;
     for(i=0;i<argc;i++)
-        printf("argv[%d] = \"%s\"\n", i, argv[i]);
+        fmt_printf("argv[%d] = \"%s\"\n", i, argv[i]);
 }
 
 /** resets the robot. */
@@ -26,17 +33,47 @@ void cmd_move(int argc, char **argv) {
         while(!holonomic_robot_in_xy_window(&robot.traj, 30));
         }
     else {
-         printf("Usage: move x_mm y_mm\n");
+         fmt_printf("Usage: move x_mm y_mm\n");
      }
 }
 
+/** Follows a polyline without stopping at the waypoints. */
+void cmd_path(int argc, char **argv) {
+    point_t points[PATH_MAX_POINTS];
+    int i, n;
+
+    if(argc < 3 || (argc % 2) == 0) {
+        fmt_printf("Usage: path x1_mm y1_mm [x2_mm y2_mm ...]\n");
+        return;
+    }
+
+    n = (argc - 1) / 2;
+    for(i=0;i<n && i<PATH_MAX_POINTS;i++) {
+        points[i].x = atoi(argv[2*i+1]);
+        points[i].y = atoi(argv[2*i+2]);
+    }
+
+    if(path_follower_start(&robot.follower, points, n) < 0)
+        fmt_printf("Path too long, max %d points.\n", PATH_MAX_POINTS - 1);
+}
+
+/** Goes to a full pose, turning while translating. */
+void cmd_goto_xya(int argc, char **argv) {
+    if (argc == 4) {
+        path_follower_goto_xya(&robot.follower, atoi(argv[1]), atoi(argv[2]), TO_RAD(atoi(argv[3])));
+    }
+    else {
+         fmt_printf("Usage: goto x_mm y_mm angle[deg]\n");
+    }
+}
+
 void cmd_turn(int argc, char **argv) {
     if (argc == 2) {
         holonomic_trajectory_turning_cap(&robot.traj, atof(argv[1]));
         //while(!holonomic_robot_in_xy_window(&robot.traj, 30));
         }
     else {
-         printf("Usage: turn angle [rad] \n");
+         fmt_printf("Usage: turn angle [rad] \n");
      }
 }
 
@@ -44,12 +81,12 @@ void cmd_turn(int argc, char **argv) {
 /** Writes to a specific PWM. */
 void cmd_pwm(int argc, char **argv) {
     if(argc == 3) {
-        printf("Putting channel %d = %d\n", atoi(argv[1]), atoi(argv[2]));
+        fmt_printf("Putting channel %d = %d\n", atoi(argv[1]), atoi(argv[2]));
 #ifdef COMPILE_ON_ROBOT
         cvra_dc_set_pwm((void*)HEXMOTORCONTROLLER_BASE, atoi(argv[1]), atoi(argv[2]));
 #endif
     }else{
-        printf("Usage: pwm channel value\n");
+        fmt_printf("Usage: pwm channel value\n");
     }
 }
 
@@ -61,14 +98,14 @@ void cmd_encoders(int argc, char **argv) {
         if(argc > 1){
             cvra_dc_set_encoder((void*)HEXMOTORCONTROLLER_BASE, i, 0);
         }
-        printf("%d;", (int)cvra_dc_get_encoder((void*)HEXMOTORCONTROLLER_BASE, i));
+        fmt_printf("%d;", (int)cvra_dc_get_encoder((void*)HEXMOTORCONTROLLER_BASE, i));
     }
 #else
     (void)argc;
     (void)argv;
-    printf("Not on robot, bitch.\n");
+    fmt_printf("Not on robot, bitch.\n");
 #endif
-    printf("\n");
+    fmt_printf("\n");
 }
 
 /** Gets the encoder index values. */
@@ -76,38 +113,38 @@ void cmd_index(int argc, char **argv) {
 #ifdef COMPILE_ON_ROBOT
     int i;
     for(i=0;i<3;i++){
-        printf("%d;", (int)cvra_dc_get_index((void*)HEXMOTORCONTROLLER_BASE, i));
+        fmt_printf("%d;", (int)cvra_dc_get_index((void*)HEXMOTORCONTROLLER_BASE, i));
     }
 #else
     (void)argc;
     (void)argv;
-    printf("Not on robot, bitch.\n");
+    fmt_printf("Not on robot, bitch.\n");
 #endif
-    printf("\n");
+    fmt_printf("\n");
 }
 
 /** Setups PID. */
 void cmd_pid(int argc, char **argv) {
     if(argc < 2) {
         /* Show current gains. */
-        printf("Wheel 0 : \tKp=%d\tGi=%d\tGd=%d\n",
+        fmt_printf("Wheel 0 : \tKp=%d\tGi=%d\tGd=%d\n",
                 pid_get_gain_P(&robot.wheel0_pid), 
                 pid_get_gain_I(&robot.wheel0_pid),
                 pid_get_gain_D(&robot.wheel0_pid));
 
-        printf("Wheel 1 : \tKp=%d\tGi=%d\tGd=%d\n",
+        fmt_printf("Wheel 1 : \tKp=%d\tGi=%d\tGd=%d\n",
                 pid_get_gain_P(&robot.wheel1_pid), 
                 pid_get_gain_I(&robot.wheel1_pid),
                 pid_get_gain_D(&robot.wheel1_pid));
 
-        printf("Wheel 2 : \tKp=%d\tGi=%d\tGd=%d\n",
+        fmt_printf("Wheel 2 : \tKp=%d\tGi=%d\tGd=%d\n",
                 pid_get_gain_P(&robot.wheel2_pid), 
                 pid_get_gain_I(&robot.wheel2_pid),
                 pid_get_gain_D(&robot.wheel2_pid));
 
     }
     else if(argc < 5) {
-            printf("usage: %s pid_name P I D\n", argv[0]);
+            fmt_printf("usage: %s pid_name P I D\n", argv[0]);
     } 
     else {
         struct pid_filter *pid;
@@ -116,7 +153,7 @@ void cmd_pid(int argc, char **argv) {
         else if(!strcmp(argv[1], "w1")) pid =  &robot.wheel1_pid;
         else if(!strcmp(argv[1], "w2")) pid =  &robot.wheel2_pid;
         else {
-            printf("Unknown PID name : %s\n", argv[1]);
+            fmt_printf("Unknown PID name : %s\n", argv[1]);
             return;
         }
 
@@ -132,7 +169,7 @@ void cmd_pid(int argc, char **argv) {
 /** Set or get the position */
 void cmd_position(int argc, char **argv){
     if(argc == 1){
-        printf("x: %lf; y: %lf; a: %lf\n", holonomic_position_get_x_double(&robot.pos), 
+        fmt_printf("x: %.1f; y: %.1f; a: %.4f\n", holonomic_position_get_x_double(&robot.pos), 
                                           holonomic_position_get_y_double(&robot.pos),
                                           holonomic_position_get_a_rad_double(&robot.pos));
     }else{
@@ -145,29 +182,151 @@ void cmd_position(int argc, char **argv){
 /** Set the macro-variable (speed. direction, omega) via trajectory */
 void cmd_set_macro_var(int argc, char **argv) {
     if(argc < 3)
-       printf("Usage: macro_var SPEED DIRECTION ROT_SPEED\n");
+       fmt_printf("Usage: macro_var SPEED DIRECTION ROT_SPEED\n");
    else
       holonomic_trajectory_set_var(&robot.traj, (int32_t)atoi(argv[1]), (int32_t)atoi(argv[2]), (int32_t)atoi(argv[3]));
 }
 
+/** Prints the time spent in each boot phase. */
+void cmd_boot(void) {
+    boot_print_times(&default_context);
+}
+
+/** Prints the stack watermarks and the RAM used by each module. */
+void cmd_mem(void) {
+    memcheck_print_report();
+}
+
+#ifdef TRACE_ENABLED
+/** Dumps (or clears) the trace buffer, see tools/trace2chrome.py. */
+void cmd_trace(int argc, char **argv) {
+    if(argc > 1 && !strcmp(argv[1], "clear"))
+        trace_clear();
+    else
+        trace_dump();
+}
+#endif
+
+#ifdef BUS_STATS_ENABLED
+/** Prints (or resets) the bus accesses per control tick. */
+void cmd_bus(int argc, char **argv) {
+    if(argc > 1 && !strcmp(argv[1], "reset"))
+        busstat_reset();
+    else
+        busstat_print();
+}
+#endif
+
+/** Prints or sets the log level of the modules. */
+void cmd_log(int argc, char **argv) {
+    int i;
+
+    if(argc == 3) {
+        for(i=0;i<LOG_NB_MODULES;i++) {
+            if(!strcmp(argv[1], "all") || !strcmp(argv[1], log_module_name(i)))
+                log_set_level(i, atoi(argv[2]));
+        }
+        return;
+    }
+    if(argc != 1) {
+        fmt_printf("Usage: log [module|all level]\n");
+        return;
+    }
+    for(i=0;i<LOG_NB_MODULES;i++)
+        fmt_printf("%-10s %d\n", log_module_name(i), log_get_level(i));
+}
+
+/** Prints the link with the teammate, or sets its byte budget. */
+void cmd_team(int argc, char **argv) {
+    struct team_sync *t = &robot.team;
+    const struct team_state *p;
+
+    if(argc == 2) {
+        team_sync_set_budget(t, atoi(argv[1]));
+        return;
+    }
+
+    fmt_printf("budget %d B/s, sent %d B in %d frames, received %d frames (%d bad)\n",
+               (int)t->budget, (int)t->bytes_sent, (int)t->frames_sent,
+               (int)t->frames_received, (int)t->frames_bad);
+
+    p = team_sync_peer(t);
+    if(p == NULL) {
+        fmt_printf("teammate lost\n");
+        return;
+    }
+    fmt_printf("teammate at %d %d %d, lease %d (%d ms), done 0x%x\n",
+               p->f[TEAM_X], p->f[TEAM_Y], p->f[TEAM_A],
+               p->f[TEAM_LEASE], (uint16_t)p->f[TEAM_COST], (uint16_t)p->f[TEAM_DONE]);
+}
+
+/** Enables or disables the avoidance of the other robots, or prints its state. */
+void cmd_orca(int argc, char **argv) {
+    int i;
+
+    if(argc == 2) {
+        orca_enable(&robot.orca, atoi(argv[1]));
+        return;
+    }
+
+    fmt_printf("%s, active %d ticks\n", robot.orca.enabled ? "enabled" : "disabled",
+               (int)robot.orca.active_ticks);
+    for(i=0;i<ORCA_MAX_OBSTACLES;i++) {
+        struct orca_obstacle *ob = &robot.orca.obstacles[i];
+        if(ob->valid)
+            fmt_printf("%d : %d %d, %d %d mm/s\n", i, (int)ob->x, (int)ob->y,
+                       (int)ob->vx, (int)ob->vy);
+    }
+}
+
+/** Enables or disables the pauses in front of the other robots, or prints
+ * their state. */
+void cmd_avoid(int argc, char **argv) {
+    struct avoidance *a = &robot.avoid;
+
+    if(argc == 2) {
+        avoidance_enable(a, atoi(argv[1]));
+        return;
+    }
+
+    fmt_printf("%s, %s, nearest %d mm\n", a->enabled ? "enabled" : "disabled",
+               avoidance_paused(a) ? "paused" : "clear",
+               (int)a->distance);
+    fmt_printf("%d pauses, %d given up\n", a->pauses, a->give_ups);
+}
+
+/** Prints the obstacles around the robot. */
+void cmd_obstacles(void) {
+    struct obstacle_map *m = &robot.obstacles;
+    int i;
+
+    fmt_printf("%d obstacles, %d fused hits, %d border hits\n", m->count, (int)m->fusions,
+               (int)m->border_hits);
+    for(i=0;i<OBSTACLE_MAP_SIZE;i++) {
+        struct obstacle *o = &m->o[i];
+        if(o->valid)
+            fmt_printf("%d : %d %d, radius %d\n", i, (int)o->x, (int)o->y, (int)o->radius);
+    }
+}
+
 /** Lists all available commands. */
 void cmd_help(void) {
     int i;
     extern command_t commands_list[];
     for(i=0;commands_list[i].f!= NULL;i++) {
-        printf("%s\t", commands_list[i].name);
+        fmt_printf("%s\t", commands_list[i].name);
         if(i > 0 && i%4 == 0)
-            printf("\n");
+            fmt_printf("\n");
     }
-    printf("\n");
+    fmt_printf("\n");
 }
 
 void cmd_speed(int argc, char **argv) {
     if(argc < 2){
-        printf("Translation Speed: %f\nDirection:         %f\nRotation Speed:    %f\n",
+        fmt_printf("Translation Speed: %.1f\nDirection:         %.3f\nRotation Speed:    %.3f\n",
                 robot.rs.speed, robot.rs.direction, robot.rs.rotation_speed);
     }else if(argc < 3){
-        printf("Usage: speed SPEED DIRECTION (DEG) ROT_SPEED\n");
+        fmt_printf("Usage: speed SPEED DIRECTION (DEG) ROT_SPEED\n");
     }else{
         rsh_set_speed(&robot.rs, (int32_t)atoi(argv[1]));
         rsh_set_direction_int(&robot.rs, (int32_t)atoi(argv[2]));
@@ -177,62 +336,152 @@ void cmd_speed(int argc, char **argv) {
     }
 }
 
+/** Enables or disables binary teleoperation. */
+void cmd_teleop(int argc, char **argv) {
+    if(argc < 2) {
+        fmt_printf("Teleop %s, timeout %d ms, %s\n",
+                robot.teleop.enabled ? "enabled" : "disabled",
+                (int)(robot.teleop.timeout / 1000),
+                robot.teleop.watchdog_fired ? "watchdog fired" : "link ok");
+        fmt_printf("Frames: %u ok, %u bad\n", (unsigned int)robot.teleop.frames_ok,
+                (unsigned int)robot.teleop.frames_bad);
+    }else if(!strcmp(argv[1], "on")){
+        teleop_enable(&robot.teleop, argc > 2 ? atoi(argv[2]) : TELEOP_DEFAULT_TIMEOUT_MS);
+    }else if(!strcmp(argv[1], "off")){
+        teleop_disable(&robot.teleop);
+    }else{
+        fmt_printf("Usage: teleop [on [timeout_ms]|off]\n");
+    }
+}
+
 void cmd_circle(int argc, char **argv) {
     if(argc < 3){
-        printf("Usage: circle center_x[mm] center_y[mm] section[rad]\n");
+        fmt_printf("Usage: circle center_x[mm] center_y[mm] section[rad]\n");
     }else{
         holonomic_trajectory_moving_circle(&robot.traj,(int32_t)atoi(argv[1]) ,(int32_t)atoi(argv[2]), (double)atof(argv[3]));
         }
 }
 
+/** Curve followed by the spline and clothoid commands, must outlive the command. */
+static struct curve cmd_curve;
+
+/** Stops the follower, which may still be walking cmd_curve, before it is rewritten. */
+static void cmd_curve_stop(void) {
+    CVRA_CS_LOCK();
+    path_follower_stop(&robot.follower);
+    CVRA_CS_UNLOCK();
+}
+
+static void cmd_curve_start(void) {
+    CVRA_CS_LOCK();
+    path_follower_start_curves(&robot.follower, &cmd_curve, 1);
+    CVRA_CS_UNLOCK();
+}
+
+/** Drives a quintic spline from the current position to a point and direction. */
+void cmd_spline(int argc, char **argv) {
+    point_t p0, p1;
+    vect_t t0, t1, zero = {0, 0};
+    double chord, a;
+
+    if(argc < 4){
+        fmt_printf("Usage: spline x_mm y_mm end_direction[deg]\n");
+        return;
+    }
+
+    cmd_curve_stop();
+    p0.x = holonomic_position_get_x_double(&robot.pos);
+    p0.y = holonomic_position_get_y_double(&robot.pos);
+    p1.x = atoi(argv[1]);
+    p1.y = atoi(argv[2]);
+
+    /* Start along the chord, end in the requested direction. */
+    chord = hypot(p1.x - p0.x, p1.y - p0.y);
+    t0.x = p1.x - p0.x;
+    t0.y = p1.y - p0.y;
+    a = TO_RAD(atoi(argv[3]));
+    t1.x = chord * cos(a);
+    t1.y = chord * sin(a);
+
+    curve_quintic(&cmd_curve, p0, t0, zero, p1, t1, zero);
+    cmd_curve_start();
+}
+
+/** Drives a clothoid starting at the current position. */
+void cmd_clothoid(int argc, char **argv) {
+    point_t p0;
+
+    if(argc < 5){
+        fmt_printf("Usage: clothoid direction[deg] curvature[1/m] sharpness[1/m^2] length_mm\n");
+        return;
+    }
+
+    cmd_curve_stop();
+    p0.x = holonomic_position_get_x_double(&robot.pos);
+    p0.y = holonomic_position_get_y_double(&robot.pos);
+
+    curve_clothoid(&cmd_curve, p0, TO_RAD(atoi(argv[1])), atof(argv[2]) / 1000.,
+                   atof(argv[3]) / 1e6, atoi(argv[4]));
+    cmd_curve_start();
+}
+
 void cmd_get_speed(void){
-    printf("Translation Speed: %f\nDirection: %d\nRotations Speed: %lf\n",
+    fmt_printf("Translation Speed: %.1f\nDirection: %d\nRotations Speed: %.3f\n",
             holonomic_position_get_instant_translation_speed(&robot.pos),
             (int)holonomic_position_get_theta_v_int(&robot.pos),
             holonomic_position_get_instant_rotation_speed(&robot.pos));
 }
 
+/** Prints (or resets) the execution time of the control loop. */
+void cmd_cs_stats(int argc, char **argv) {
+    (void)argv;
+    if(argc > 1) {
+        robot.cs_manage_time_max = 0;
+        robot.cs_manage_time_total = 0;
+        robot.cs_manage_count = 0;
+        return;
+    }
+
+    fmt_printf("cvra_cs_manage: %u ticks, avg %u us, max %d us\n",
+            (unsigned int)robot.cs_manage_count,
+            robot.cs_manage_count ? (unsigned int)(robot.cs_manage_time_total / robot.cs_manage_count) : 0,
+            (int)robot.cs_manage_time_max);
+    fmt_printf("sizeof(robot) = %u bytes\n", (unsigned int)sizeof(robot));
+}
+
 void cmd_delta_enc(void){
-    printf("%d; %d; %d;\n", (int)robot.pos.delta_enc[0], (int)robot.pos.delta_enc[1], (int)robot.pos.delta_enc[2]);
+    fmt_printf("%d; %d; %d;\n", (int)robot.pos.delta_enc[0], (int)robot.pos.delta_enc[1], (int)robot.pos.delta_enc[2]);
 }
 
 void cmd_cs_enable(int argc, char **argv) {
     (void)argv;
-    if(argc > 1){
-        cs_disable(&robot.wheel0_cs);
-        cs_disable(&robot.wheel1_cs);
-        cs_disable(&robot.wheel2_cs);
-    }else{
-        cs_enable(&robot.wheel0_cs);
-        cs_enable(&robot.wheel1_cs);
-        cs_enable(&robot.wheel2_cs);
-    }
+    cvra_cs_enable(&default_context, argc < 2);
 }
 
 void cmd_exit(void) {
     exit(0);
 }
 void cmd_start(int argc, char** argv) {
-    //printf("Press a key to start the robot.\n");
+    //fmt_printf("Press a key to start the robot.\n");
     //getchar();
 
     if (argc != 1)
     {
-        printf("Usage : start color \n Color ={blue, red}\n");
+        fmt_printf("Usage : start color \n Color ={blue, red}\n");
     }
     if(!strcmp(argv[1], "red"))
-        strat_begin(RED);
+        strat_begin(&default_context, RED);
     else if(!strcmp(argv[1], "blue"))
-        strat_begin(BLUE);
+        strat_begin(&default_context, BLUE);
     else {
-        printf("Color is blue or red\n");
+        fmt_printf("Color is blue or red\n");
         return;}
 
-    printf("Match done. Hope you enjoyed it !\n");
+    fmt_printf("Match done. Hope you enjoyed it !\n");
 }
 
 void cmd_do_gift(int argc, char** argv){
-    strat_do_gift(atoi(argv[1]));
+    strat_do_gift(&default_context, atoi(argv[1]));
 }
 
 /** Wheel 0 -> ADC 4
@@ -242,16 +491,67 @@ void cmd_do_gift(int argc, char** argv){
 void cmd_print_currents() {
     int i=0;
     for(i=0;i<6;i++)
-        printf("%d : %d\n", i, cvra_dc_get_current(HEXMOTORCONTROLLER_BASE, i));
+        fmt_printf("%d : %d\n", i, cvra_dc_get_current(HEXMOTORCONTROLLER_BASE, i));
 
 }
 
 void cmd_calibrate(void)
 {
      holonomic_position_set_x_s16(&robot.pos, 88.5);
-    holonomic_position_set_y_s16(&robot.pos,COLOR_Y(2000 - 213));
-    holonomic_position_set_a_s16(&robot.pos, COLOR_A(90));
-    strat_do_calibration();
+    holonomic_position_set_y_s16(&robot.pos,COLOR_Y(&strat, 2000 - 213));
+    holonomic_position_set_a_s16(&robot.pos, COLOR_A(&strat, 90));
+    strat_do_calibration(&default_context);
+}
+
+/** Prints the distance sensors, to calibrate the docking. */
+void cmd_dock(void) {
+    double left, right;
+    int l, r;
+
+    cvra_get_distance_sensors(&l, &r);
+    fmt_printf("raw %d %d\n", l, r);
+    if(dock_read(&left, &right) == 0)
+        fmt_printf("%d mm, %d mm\n", (int)left, (int)right);
+    else
+        fmt_printf("out of range\n");
+}
+
+/** Prints the battery voltage, or enables the compensation of the PWMs. */
+void cmd_battery(int argc, char **argv) {
+    struct battery *b = &robot.battery;
+
+    if(argc == 2) {
+        battery_set_compensation(b, atoi(argv[1]));
+        return;
+    }
+
+    fmt_printf("raw %d\n", cvra_get_battery_voltage());
+    if(!b->valid) {
+        fmt_printf("no measure\n");
+        return;
+    }
+    fmt_printf("%d mV (min %d mV), pwm x%d/1000, compensation %s\n",
+               (int)b->voltage, (int)b->min_voltage, (int)(b->scale * 1000),
+               b->compensate ? "on" : "off");
+}
+
+/** Checks the motors, encoders, servos and beacon before a match. */
+void cmd_selftest(void) {
+    struct selftest_result res;
+
+    selftest_run(&default_context, &res);
+    selftest_print(&res);
+}
+
+/** Finds the start position from the walls of the corner. */
+void cmd_autopos(int argc, char **argv) {
+    if(argc != 2 || (strcmp(argv[1], "red") && strcmp(argv[1], "blue"))) {
+        fmt_printf("Usage : autopos red|blue\n");
+        return;
+    }
+
+    strat.color = strcmp(argv[1], "red") ? BLUE : RED;
+    strat_autopos(&default_context, STRAT_START_X, STRAT_START_Y, 90, STRAT_ROBOT_THICKNESS);
 }
 
 void cmd_servo(int argc, char** argv){
@@ -259,33 +559,25 @@ void cmd_servo(int argc, char** argv){
 }
 
 void cmd_get_io(int argc, char** argv){
-    printf("%d\n", (uint32_t)IORD(PIO_BASE, 0));
+    fmt_printf("%d\n", (uint32_t)IORD(PIO_BASE, 0));
 }
 
-//void cmd_toggle_avoiding(void)
-//{
-    //if (robot.robot_in_sight)
-        //robot.robot_in_sight = 0;
-    //else
-        //robot.robot_in_sight = 1;
-//}
-
 #ifdef COMPILE_ON_ROBOT
 void cmd_beacon(void) {
-    printf("==Beacon==\n");
-    printf("period = %u\n", (unsigned int)robot.beacon.period);
-    printf("firstedge = %u\n", (unsigned int)robot.beacon.firstedge);
-    printf("lastindex = %u\n", (unsigned int)robot.beacon.lastindex);
-    printf("nbedge = %d\n", (int)robot.beacon.nb_edges);
+    fmt_printf("==Beacon==\n");
+    fmt_printf("period = %u\n", (unsigned int)robot.beacon.period);
+    fmt_printf("firstedge = %u\n", (unsigned int)robot.beacon.firstedge);
+    fmt_printf("lastindex = %u\n", (unsigned int)robot.beacon.lastindex);
+    fmt_printf("nbedge = %d\n", (int)robot.beacon.nb_edges);
 
 /*    for(;;)
-        printf("angle : %d\n",(int)(robot.beacon.firstedge - robot.beacon.lastindex)/10000);  */
+        fmt_printf("angle : %d\n",(int)(robot.beacon.firstedge - robot.beacon.lastindex)/10000);  */
 
 }
 #endif
 
 void cmd_test_odometry(void){
-    strat_start_position();
+    strat_start_position(&default_context);
     strat_long_arm_down();
     strat_short_arm_down();
 
@@ -293,22 +585,22 @@ void cmd_test_odometry(void){
 
     holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 300, 1700);
     while(!holonomic_end_of_traj(&robot.traj));
-    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(TO_RAD(0)));
+    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(&strat, TO_RAD(0)));
     while(!holonomic_end_of_traj(&robot.traj));
 
     while((IORD(PIO_BASE, 0) & 0x1000) == 0);
 
     holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 400, 1200);
     while(!holonomic_end_of_traj(&robot.traj));
-    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(TO_RAD(0)));
+    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(&strat, TO_RAD(0)));
     while(!holonomic_end_of_traj(&robot.traj));
     holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 2600, 1200);
     while(!holonomic_end_of_traj(&robot.traj));
-    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(TO_RAD(180)));
+    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(&strat, TO_RAD(180)));
     while(!holonomic_end_of_traj(&robot.traj));
     holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 400, 1200);
     while(!holonomic_end_of_traj(&robot.traj));
-    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(TO_RAD(0)));
+    holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(&strat, TO_RAD(0)));
     while(!holonomic_end_of_traj(&robot.traj));
 }
 
@@ -318,7 +610,7 @@ void cmd_index_setup(void){
     for(i = 0; i < 400; i++){
         int32_t time = uptime_get();
         while(time + 10000 > uptime_get());
-        printf("%10d   %10d   %10d\n", uptime_get(),
+        fmt_printf("%10d   %10d   %10d\n", uptime_get(),
                                 cvra_dc_get_encoder0(HEXMOTORCONTROLLER_BASE),
                                 cvra_dc_get_index0(HEXMOTORCONTROLLER_BASE));
     }
@@ -329,6 +621,19 @@ void cmd_index_setup(void){
 command_t commands_list[] = {
     COMMAND("test_argv",test_func),
     COMMAND("reset", cmd_reset),
+    COMMAND("boot", cmd_boot),
+    COMMAND("mem", cmd_mem),
+#ifdef TRACE_ENABLED
+    COMMAND("trace", cmd_trace),
+#endif
+    COMMAND("log", cmd_log),
+    COMMAND("team", cmd_team),
+    COMMAND("orca", cmd_orca),
+    COMMAND("avoid", cmd_avoid),
+    COMMAND("obstacles", cmd_obstacles),
+#ifdef BUS_STATS_ENABLED
+    COMMAND("bus", cmd_bus),
+#endif
     COMMAND("start",cmd_start),
     COMMAND("pid", cmd_pid), 
     COMMAND("pwm", cmd_pwm),
@@ -338,12 +643,18 @@ command_t commands_list[] = {
     COMMAND("help", cmd_help),
     COMMAND("speed", cmd_speed),
     COMMAND("cs_enable", cmd_cs_enable),
+    COMMAND("teleop", cmd_teleop),
     COMMAND("get_speed", cmd_get_speed),
     COMMAND("delta_enc", cmd_delta_enc),
+    COMMAND("cs_stats", cmd_cs_stats),
     COMMAND("move", cmd_move),
+    COMMAND("path", cmd_path),
+    COMMAND("goto", cmd_goto_xya),
     COMMAND("macro_var", cmd_set_macro_var),
     COMMAND("exit", cmd_exit),
     COMMAND("circle", cmd_circle),
+    COMMAND("spline", cmd_spline),
+    COMMAND("clothoid", cmd_clothoid),
     COMMAND("start", cmd_start),
     COMMAND("do_gift", cmd_do_gift),
     COMMAND("turn", cmd_turn),
@@ -353,10 +664,13 @@ command_t commands_list[] = {
     COMMAND("beacon", cmd_beacon),
 #endif
     COMMAND("calibrate",cmd_calibrate),
+    COMMAND("autopos", cmd_autopos),
+    COMMAND("dock", cmd_dock),
+    COMMAND("battery", cmd_battery),
+    COMMAND("selftest", cmd_selftest),
     COMMAND("current",cmd_print_currents),
     COMMAND("odo_test", cmd_test_odometry),
     COMMAND("index_setup", cmd_index_setup),
-    //COMMAND("toggle_avoiding",cmd_toggle_avoiding),r
     COMMAND("none",NULL), /* must be last. */
 };
 
@@ -0,0 +1,239 @@
+/** @file curve.c
+ * @brief Spline and clothoid trajectory segments.
+ * @sa curve.h
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+
+#include "curve.h"
+
+/** Number of table entries searched on each side of the hint when projecting. */
+#define CURVE_PROJECT_WINDOW 2
+
+/** Evaluates a polynomial of degree 5 and its first two derivatives. */
+static void poly_eval(const double *c, double u, double *p, double *dp, double *ddp) {
+    *p = ((((c[5] * u + c[4]) * u + c[3]) * u + c[2]) * u + c[1]) * u + c[0];
+    *dp = (((5 * c[5] * u + 4 * c[4]) * u + 3 * c[3]) * u + 2 * c[2]) * u + c[1];
+    *ddp = ((20 * c[5] * u + 12 * c[4]) * u + 6 * c[3]) * u + 2 * c[2];
+}
+
+/** Fills the arc length table of a spline once its coefficients are set. */
+static void curve_build_spline_table(struct curve *c) {
+    const int n = (CURVE_TABLE_SIZE - 1) * CURVE_INTEGRATION_STEPS;
+    double s = 0., prev_s, speed, prev_speed, target;
+    double x, dx, ddx, y, dy, ddy, u;
+    int i, k;
+
+    /* First pass : total length, by trapezoidal integration of |P'(u)|. */
+    poly_eval(c->cx, 0., &x, &dx, &ddx);
+    poly_eval(c->cy, 0., &y, &dy, &ddy);
+    prev_speed = hypot(dx, dy);
+    for(i=1;i<=n;i++) {
+        poly_eval(c->cx, (double)i / n, &x, &dx, &ddx);
+        poly_eval(c->cy, (double)i / n, &y, &dy, &ddy);
+        speed = hypot(dx, dy);
+        s += (speed + prev_speed) / (2. * n);
+        prev_speed = speed;
+    }
+
+    c->length = s;
+    c->step = s / (CURVE_TABLE_SIZE - 1);
+
+    /* Second pass : invert s(u) at equally spaced arc lengths. */
+    c->u[0] = 0.;
+    k = 1;
+    s = 0.;
+    poly_eval(c->cx, 0., &x, &dx, &ddx);
+    poly_eval(c->cy, 0., &y, &dy, &ddy);
+    prev_speed = hypot(dx, dy);
+    for(i=1;i<=n && k<CURVE_TABLE_SIZE-1;i++) {
+        poly_eval(c->cx, (double)i / n, &x, &dx, &ddx);
+        poly_eval(c->cy, (double)i / n, &y, &dy, &ddy);
+        speed = hypot(dx, dy);
+        prev_s = s;
+        s += (speed + prev_speed) / (2. * n);
+        prev_speed = speed;
+
+        target = k * c->step;
+        while(k < CURVE_TABLE_SIZE - 1 && s >= target) {
+            c->u[k] = ((i - 1) + (target - prev_s) / (s - prev_s)) / n;
+            k++;
+            target = k * c->step;
+        }
+    }
+    c->u[CURVE_TABLE_SIZE-1] = 1.;
+
+    for(k=0;k<CURVE_TABLE_SIZE;k++) {
+        u = c->u[k];
+        poly_eval(c->cx, u, &x, &dx, &ddx);
+        poly_eval(c->cy, u, &y, &dy, &ddy);
+        c->x[k] = x;
+        c->y[k] = y;
+        speed = hypot(dx, dy);
+        c->k[k] = speed > 1e-6 ? (dx * ddy - dy * ddx) / (speed * speed * speed) : 0.;
+    }
+}
+
+void curve_cubic(struct curve *c, point_t p0, vect_t t0, point_t p1, vect_t t1) {
+    memset(c, 0, sizeof(struct curve));
+    c->type = CURVE_CUBIC;
+
+    /* Hermite basis expanded in the monomial basis. */
+    c->cx[0] = p0.x;
+    c->cx[1] = t0.x;
+    c->cx[2] = -3 * p0.x - 2 * t0.x + 3 * p1.x - t1.x;
+    c->cx[3] = 2 * p0.x + t0.x - 2 * p1.x + t1.x;
+
+    c->cy[0] = p0.y;
+    c->cy[1] = t0.y;
+    c->cy[2] = -3 * p0.y - 2 * t0.y + 3 * p1.y - t1.y;
+    c->cy[3] = 2 * p0.y + t0.y - 2 * p1.y + t1.y;
+
+    curve_build_spline_table(c);
+}
+
+void curve_quintic(struct curve *c, point_t p0, vect_t t0, vect_t a0,
+                   point_t p1, vect_t t1, vect_t a1) {
+    memset(c, 0, sizeof(struct curve));
+    c->type = CURVE_QUINTIC;
+
+    c->cx[0] = p0.x;
+    c->cx[1] = t0.x;
+    c->cx[2] = a0.x / 2;
+    c->cx[3] = -10 * p0.x - 6 * t0.x - 1.5 * a0.x + 0.5 * a1.x - 4 * t1.x + 10 * p1.x;
+    c->cx[4] = 15 * p0.x + 8 * t0.x + 1.5 * a0.x - a1.x + 7 * t1.x - 15 * p1.x;
+    c->cx[5] = -6 * p0.x - 3 * t0.x - 0.5 * a0.x + 0.5 * a1.x - 3 * t1.x + 6 * p1.x;
+
+    c->cy[0] = p0.y;
+    c->cy[1] = t0.y;
+    c->cy[2] = a0.y / 2;
+    c->cy[3] = -10 * p0.y - 6 * t0.y - 1.5 * a0.y + 0.5 * a1.y - 4 * t1.y + 10 * p1.y;
+    c->cy[4] = 15 * p0.y + 8 * t0.y + 1.5 * a0.y - a1.y + 7 * t1.y - 15 * p1.y;
+    c->cy[5] = -6 * p0.y - 3 * t0.y - 0.5 * a0.y + 0.5 * a1.y - 3 * t1.y + 6 * p1.y;
+
+    curve_build_spline_table(c);
+}
+
+/** Heading of a clothoid at arc length s. */
+static double clothoid_heading(const struct curve *c, double s) {
+    return c->heading + c->curvature * s + c->sharpness * s * s / 2.;
+}
+
+void curve_clothoid(struct curve *c, point_t p0, double heading,
+                    double curvature, double sharpness, double length) {
+    double x = p0.x, y = p0.y, s = 0., h, a;
+    int i, k;
+
+    memset(c, 0, sizeof(struct curve));
+    c->type = CURVE_CLOTHOID;
+    c->heading = heading;
+    c->curvature = curvature;
+    c->sharpness = sharpness;
+    c->length = length;
+    c->step = length / (CURVE_TABLE_SIZE - 1);
+
+    /* Fresnel integrals, midpoint rule. */
+    h = c->step / CURVE_INTEGRATION_STEPS;
+    c->x[0] = x;
+    c->y[0] = y;
+    c->k[0] = curvature;
+    for(k=1;k<CURVE_TABLE_SIZE;k++) {
+        for(i=0;i<CURVE_INTEGRATION_STEPS;i++) {
+            a = clothoid_heading(c, s + h / 2.);
+            x += h * cos(a);
+            y += h * sin(a);
+            s += h;
+        }
+        c->x[k] = x;
+        c->y[k] = y;
+        c->k[k] = curvature + sharpness * k * c->step;
+    }
+}
+
+double curve_length(const struct curve *c) {
+    return c->length;
+}
+
+/** Finds the table interval containing s.
+ *
+ * @param [out] f Position inside the interval, between 0 and 1.
+ * @returns The index of the start of the interval.
+ */
+static int curve_lookup(const struct curve *c, double s, double *f) {
+    int k;
+
+    if(s <= 0. || c->step <= 0.) {
+        *f = 0.;
+        return 0;
+    }
+
+    if(s >= c->length) {
+        *f = 1.;
+        return CURVE_TABLE_SIZE - 2;
+    }
+
+    k = (int)(s / c->step);
+    if(k > CURVE_TABLE_SIZE - 2)
+        k = CURVE_TABLE_SIZE - 2;
+    *f = s / c->step - k;
+    return k;
+}
+
+void curve_eval(const struct curve *c, double s, point_t *p, double *heading) {
+    double f, u, dx, dy, ddx, ddy;
+    int k = curve_lookup(c, s, &f);
+
+    if(c->type == CURVE_CLOTHOID) {
+        p->x = c->x[k] + f * (c->x[k+1] - c->x[k]);
+        p->y = c->y[k] + f * (c->y[k+1] - c->y[k]);
+        if(heading != NULL)
+            *heading = clothoid_heading(c, (k + f) * c->step);
+        return;
+    }
+
+    u = c->u[k] + f * (c->u[k+1] - c->u[k]);
+    poly_eval(c->cx, u, &p->x, &dx, &ddx);
+    poly_eval(c->cy, u, &p->y, &dy, &ddy);
+    if(heading != NULL)
+        *heading = atan2(dy, dx);
+}
+
+double curve_curvature(const struct curve *c, double s) {
+    double f;
+    int k = curve_lookup(c, s, &f);
+
+    return c->k[k] + f * (c->k[k+1] - c->k[k]);
+}
+
+double curve_project(const struct curve *c, double s_hint, double x, double y) {
+    double f, best_s = s_hint, best_d = -1., d, s;
+    double ax, ay, bx, by, t, len2;
+    int k = curve_lookup(c, s_hint, &f);
+    int i, start, end;
+
+    start = k - CURVE_PROJECT_WINDOW;
+    end = k + CURVE_PROJECT_WINDOW;
+    if(start < 0) start = 0;
+    if(end > CURVE_TABLE_SIZE - 2) end = CURVE_TABLE_SIZE - 2;
+
+    /* Project on the chords of the table around the hint. */
+    for(i=start;i<=end;i++) {
+        ax = c->x[i]; ay = c->y[i];
+        bx = c->x[i+1]; by = c->y[i+1];
+        len2 = (bx - ax) * (bx - ax) + (by - ay) * (by - ay);
+        t = len2 > 1e-9 ? ((x - ax) * (bx - ax) + (y - ay) * (by - ay)) / len2 : 0.;
+        if(t < 0.) t = 0.;
+        if(t > 1.) t = 1.;
+
+        d = hypot(ax + t * (bx - ax) - x, ay + t * (by - ay) - y);
+        s = (i + t) * c->step;
+        if(best_d < 0. || d < best_d) {
+            best_d = d;
+            best_s = s;
+        }
+    }
+
+    return best_s;
+}
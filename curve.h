@@ -0,0 +1,100 @@
+/** @file curve.h
+ * @brief Spline and clothoid trajectory segments.
+ *
+ * A curve is parameterised by its arc length s, from 0 to curve_length().
+ * The arc length parameterisation has no closed form for splines and
+ * clothoids, so it is precomputed in a small table when the curve is built.
+ * Evaluating a point at control rate is then only a table lookup and a linear
+ * interpolation, without any root-finding or integration.
+ *
+ * - For polynomial curves (cubic and quintic Hermite splines), the table
+ *   holds the polynomial parameter u at equally spaced arc lengths. The point
+ *   itself is evaluated on the polynomial, so it stays exactly on the curve.
+ * - For clothoids (linearly varying curvature), the table holds the points
+ *   themselves, and the heading is computed analytically.
+ */
+#ifndef _CURVE_H_
+#define _CURVE_H_
+
+#include <aversive.h>
+#include <vect_base.h>
+
+/** Number of entries in the arc length table (intervals + 1). */
+#define CURVE_TABLE_SIZE 17
+
+/** Number of integration steps per table interval when building a curve. */
+#define CURVE_INTEGRATION_STEPS 8
+
+typedef enum {CURVE_CUBIC, CURVE_QUINTIC, CURVE_CLOTHOID} curve_type_t;
+
+/** A curved trajectory segment. */
+struct curve {
+    curve_type_t type;
+
+    /** Polynomial coefficients, x(u) = cx[0] + cx[1] u + ... (splines only). */
+    double cx[6];
+    double cy[6];
+
+    /** Clothoid parameters, heading(s) = heading + curvature s + sharpness s^2 / 2. */
+    double heading;
+    double curvature;
+    double sharpness;
+
+    double length;                     /**< Total arc length, in mm. */
+    double step;                       /**< Arc length between two table entries. */
+
+    float u[CURVE_TABLE_SIZE];         /**< Spline parameter at each entry. */
+    float x[CURVE_TABLE_SIZE];         /**< Position at each entry. */
+    float y[CURVE_TABLE_SIZE];
+    float k[CURVE_TABLE_SIZE];         /**< Curvature at each entry, in 1/mm. */
+};
+
+/** Builds a cubic Hermite spline.
+ *
+ * @param [in] p0, p1 Start and end points.
+ * @param [in] t0, t1 Start and end tangents. Their norm sets how far the
+ * curve goes in the given direction, the chord length is a good default.
+ */
+void curve_cubic(struct curve *c, point_t p0, vect_t t0, point_t p1, vect_t t1);
+
+/** Builds a quintic Hermite spline, continuous in curvature.
+ *
+ * @param [in] a0, a1 Start and end second derivatives, zero for a curve
+ * starting and ending straight.
+ * @sa curve_cubic
+ */
+void curve_quintic(struct curve *c, point_t p0, vect_t t0, vect_t a0,
+                   point_t p1, vect_t t1, vect_t a1);
+
+/** Builds a clothoid.
+ *
+ * @param [in] p0 Start point.
+ * @param [in] heading Start heading, in rad.
+ * @param [in] curvature Start curvature, in 1/mm.
+ * @param [in] sharpness Curvature variation, in 1/mm^2.
+ * @param [in] length Arc length, in mm.
+ */
+void curve_clothoid(struct curve *c, point_t p0, double heading,
+                    double curvature, double sharpness, double length);
+
+/** Returns the arc length of the curve, in mm. */
+double curve_length(const struct curve *c);
+
+/** Evaluates the curve at arc length s (clamped to the curve).
+ *
+ * @param [out] p The point at s.
+ * @param [out] heading The tangent direction at s, in rad. Can be NULL.
+ */
+void curve_eval(const struct curve *c, double s, point_t *p, double *heading);
+
+/** Returns the curvature at arc length s, in 1/mm. */
+double curve_curvature(const struct curve *c, double s);
+
+/** Finds the arc length of the point closest to (x, y).
+ *
+ * Only the table entries around s_hint are searched, so the previous result
+ * should be given as a hint.
+ */
+double curve_project(const struct curve *c, double s_hint, double x, double y);
+
+#endif
@@ -25,28 +25,56 @@
 #include <pid.h>
 #include <quadramp.h>
 #include <scheduler.h>
+#include <uptime.h>
 
 #ifdef COMPILE_ON_ROBOT
 #include <cvra_beacon.h>
+#else
+#include <pthread.h>
 #endif
 
 #include <aversive/error.h>
+#include "fmt.h"
 #include "error_numbers.h"
 #include "adresses.h"
 
 #include <string.h>
-#include <stdio.h>
 
 #include "cvra_cs.h"
 #include "hardware.h"
 #include "cvra_param_robot.h"
+#include "boot.h"
+#include "trace.h"
+#include "busstat.h"
 
 
-struct _rob robot;
+#ifndef COMPILE_ON_ROBOT
+/* Recursif : le tick prend aussi les verrous des modules qu'il appelle. */
+static pthread_mutex_t cvra_cs_mutex;
+static pthread_once_t cvra_cs_mutex_once = PTHREAD_ONCE_INIT;
+
+static void cvra_cs_mutex_init(void) {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&cvra_cs_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void cvra_cs_lock(void) {
+    pthread_once(&cvra_cs_mutex_once, cvra_cs_mutex_init);
+    pthread_mutex_lock(&cvra_cs_mutex);
+}
+
+void cvra_cs_unlock(void) {
+    pthread_mutex_unlock(&cvra_cs_mutex);
+}
+#endif
 
 /** Limite PWM = + ou - 475 */
 
-void cvra_cs_init(void) {
+void cvra_cs_init(struct robot_context *ctx) {
     /****************************************************************************/
     /*                                Motor                                     */
     /****************************************************************************/
@@ -65,78 +93,81 @@ void cvra_cs_init(void) {
     /*                             Robot system                                 */
     /****************************************************************************/
     
-    rsh_init(&robot.rs);
-    rsh_set_position_manager(&robot.rs, &robot.pos);
+    rsh_init(&ctx->robot->rs);
+    rsh_set_position_manager(&ctx->robot->rs, &ctx->robot->pos);
 
 
     /****************************************************************************/
     /*                         Regulation Wheel-by-Wheel                        */
     /****************************************************************************/
 
-    pid_init(&robot.wheel0_pid);
-    pid_init(&robot.wheel1_pid);
-    pid_init(&robot.wheel2_pid);
+    pid_init(&ctx->robot->wheel0_pid);
+    pid_init(&ctx->robot->wheel1_pid);
+    pid_init(&ctx->robot->wheel2_pid);
     
     // CALIBRATION : Mettre les gains < 0 si le moteur compense dans le mauvais sens
-    pid_set_gains(&robot.wheel0_pid, ROBOT_PID_WHEEL0_P, ROBOT_PID_WHEEL0_I,ROBOT_PID_WHEEL0_D);
-    pid_set_gains(&robot.wheel1_pid, ROBOT_PID_WHEEL1_P, ROBOT_PID_WHEEL1_I,ROBOT_PID_WHEEL1_D);
-    pid_set_gains(&robot.wheel2_pid, ROBOT_PID_WHEEL2_P, ROBOT_PID_WHEEL2_I,ROBOT_PID_WHEEL2_D);
+    pid_set_gains(&ctx->robot->wheel0_pid, ROBOT_PID_WHEEL0_P, ROBOT_PID_WHEEL0_I,ROBOT_PID_WHEEL0_D);
+    pid_set_gains(&ctx->robot->wheel1_pid, ROBOT_PID_WHEEL1_P, ROBOT_PID_WHEEL1_I,ROBOT_PID_WHEEL1_D);
+    pid_set_gains(&ctx->robot->wheel2_pid, ROBOT_PID_WHEEL2_P, ROBOT_PID_WHEEL2_I,ROBOT_PID_WHEEL2_D);
     
-    //pid_set_maximums(&robot.angle_pid, 0, 5000, 30000);
+    //pid_set_maximums(&ctx->robot->angle_pid, 0, 5000, 30000);
     
-    pid_set_out_shift(&robot.wheel0_pid, 10);
-    pid_set_out_shift(&robot.wheel1_pid, 10);
-    pid_set_out_shift(&robot.wheel2_pid, 10);
+    pid_set_out_shift(&ctx->robot->wheel0_pid, 10);
+    pid_set_out_shift(&ctx->robot->wheel1_pid, 10);
+    pid_set_out_shift(&ctx->robot->wheel2_pid, 10);
     
-    cs_init(&robot.wheel0_cs); 
-    cs_init(&robot.wheel1_cs); 
-    cs_init(&robot.wheel2_cs);
+    cs_init(&ctx->robot->wheel0_cs); 
+    cs_init(&ctx->robot->wheel1_cs); 
+    cs_init(&ctx->robot->wheel2_cs);
     
-    cs_set_correct_filter(&robot.wheel0_cs, pid_do_filter, &robot.wheel0_pid);
-    cs_set_correct_filter(&robot.wheel1_cs, pid_do_filter, &robot.wheel1_pid);
-    cs_set_correct_filter(&robot.wheel2_cs, pid_do_filter, &robot.wheel2_pid);
+    cs_set_correct_filter(&ctx->robot->wheel0_cs, pid_do_filter, &ctx->robot->wheel0_pid);
+    cs_set_correct_filter(&ctx->robot->wheel1_cs, pid_do_filter, &ctx->robot->wheel1_pid);
+    cs_set_correct_filter(&ctx->robot->wheel2_cs, pid_do_filter, &ctx->robot->wheel2_pid);
 
-    ramp_init(&robot.wheel0_ramp);
-    ramp_init(&robot.wheel1_ramp);
-    ramp_init(&robot.wheel2_ramp);
+    ramp_init(&ctx->robot->wheel0_ramp);
+    ramp_init(&ctx->robot->wheel1_ramp);
+    ramp_init(&ctx->robot->wheel2_ramp);
 
-    ramp_set_vars(&robot.wheel0_ramp, 1000, 1000);
-    ramp_set_vars(&robot.wheel1_ramp, 1000, 1000);
-    ramp_set_vars(&robot.wheel2_ramp, 1000, 1000);
+    ramp_set_vars(&ctx->robot->wheel0_ramp, 1000, 1000);
+    ramp_set_vars(&ctx->robot->wheel1_ramp, 1000, 1000);
+    ramp_set_vars(&ctx->robot->wheel2_ramp, 1000, 1000);
 
-    cs_set_consign_filter(&robot.wheel0_cs, ramp_do_filter, &robot.wheel0_ramp);
-    cs_set_consign_filter(&robot.wheel1_cs, ramp_do_filter, &robot.wheel1_ramp);
-    cs_set_consign_filter(&robot.wheel2_cs, ramp_do_filter, &robot.wheel2_ramp);
+    cs_set_consign_filter(&ctx->robot->wheel0_cs, ramp_do_filter, &ctx->robot->wheel0_ramp);
+    cs_set_consign_filter(&ctx->robot->wheel1_cs, ramp_do_filter, &ctx->robot->wheel1_ramp);
+    cs_set_consign_filter(&ctx->robot->wheel2_cs, ramp_do_filter, &ctx->robot->wheel2_ramp);
 
     
 
+    battery_init(&ctx->robot->battery, (void*)HEXMOTORCONTROLLER_BASE);
+
 #ifdef COMPILE_ON_ROBOT
 
-    cs_set_process_in(&robot.wheel0_cs, cvra_dc_set_pwm0, (void*)HEXMOTORCONTROLLER_BASE);
-    cs_set_process_in(&robot.wheel1_cs, cvra_dc_set_pwm1, (void*)HEXMOTORCONTROLLER_BASE);
-    cs_set_process_in(&robot.wheel2_cs, cvra_dc_set_pwm2, (void*)HEXMOTORCONTROLLER_BASE);
+    /* Les PWM passent par la compensation de la tension batterie. */
+    cs_set_process_in(&ctx->robot->wheel0_cs, battery_set_pwm0, &ctx->robot->battery);
+    cs_set_process_in(&ctx->robot->wheel1_cs, battery_set_pwm1, &ctx->robot->battery);
+    cs_set_process_in(&ctx->robot->wheel2_cs, battery_set_pwm2, &ctx->robot->battery);
     
-    cs_set_process_out(&robot.wheel0_cs, cvra_dc_get_encoder0, (void*)HEXMOTORCONTROLLER_BASE);
-    cs_set_process_out(&robot.wheel1_cs, cvra_dc_get_encoder1, (void*)HEXMOTORCONTROLLER_BASE);
-    cs_set_process_out(&robot.wheel2_cs, cvra_dc_get_encoder2, (void*)HEXMOTORCONTROLLER_BASE);
+    cs_set_process_out(&ctx->robot->wheel0_cs, BUS_DC(cvra_dc_get_encoder0), (void*)HEXMOTORCONTROLLER_BASE);
+    cs_set_process_out(&ctx->robot->wheel1_cs, BUS_DC(cvra_dc_get_encoder1), (void*)HEXMOTORCONTROLLER_BASE);
+    cs_set_process_out(&ctx->robot->wheel2_cs, BUS_DC(cvra_dc_get_encoder2), (void*)HEXMOTORCONTROLLER_BASE);
 #endif
 
     
-    cs_set_consign(&robot.wheel0_cs, 0);
-    cs_set_consign(&robot.wheel1_cs, 0);
-    cs_set_consign(&robot.wheel2_cs, 0);
+    cs_set_consign(&ctx->robot->wheel0_cs, 0);
+    cs_set_consign(&ctx->robot->wheel1_cs, 0);
+    cs_set_consign(&ctx->robot->wheel2_cs, 0);
     
     
     
-    rsh_set_cs(&robot.rs, 0 , &robot.wheel0_cs);
-    rsh_set_cs(&robot.rs, 1 , &robot.wheel1_cs);
-    rsh_set_cs(&robot.rs, 2 , &robot.wheel2_cs);
+    rsh_set_cs(&ctx->robot->rs, 0 , &ctx->robot->wheel0_cs);
+    rsh_set_cs(&ctx->robot->rs, 1 , &ctx->robot->wheel1_cs);
+    rsh_set_cs(&ctx->robot->rs, 2 , &ctx->robot->wheel2_cs);
     
     ///****************************************************************************/
     ///*                          Position manager                                */
     ///****************************************************************************/
 
-    holonomic_position_init(&robot.pos);
+    holonomic_position_init(&ctx->robot->pos);
 
     double beta[] = {ROBOT_BETA_WHEEL0_RAD,
                     ROBOT_BETA_WHEEL1_RAD,
@@ -167,7 +198,7 @@ void cvra_cs_init(void) {
 
 
     holonomic_position_set_physical_params(
-            &robot.pos,
+            &ctx->robot->pos,
             beta,
             wheel_radius,
             wheel_distance,
@@ -176,25 +207,25 @@ void cvra_cs_init(void) {
             ROBOT_ENCODER_RESOLUTION,
             index_offset);
 
-    holonomic_position_set_update_frequency(&robot.pos, (float)ASSERV_FREQUENCY);
+    holonomic_position_set_update_frequency(&ctx->robot->pos, (float)ASSERV_FREQUENCY);
 
-    int32_t (*motor_encoder[])(void *) = {cvra_dc_get_encoder0,
-                                          cvra_dc_get_encoder1,
-                                          cvra_dc_get_encoder2};
+    int32_t (*motor_encoder[])(void *) = {BUS_DC(cvra_dc_get_encoder0),
+                                          BUS_DC(cvra_dc_get_encoder1),
+                                          BUS_DC(cvra_dc_get_encoder2)};
 
     void* motor_encoder_param[] = { (void*)HEXMOTORCONTROLLER_BASE,
                                     (void*)HEXMOTORCONTROLLER_BASE,
                                     (void*)HEXMOTORCONTROLLER_BASE};
 
-    int32_t (*encoder_index[])(void *) = {cvra_dc_get_index0,
-                                          cvra_dc_get_index1,
-                                          cvra_dc_get_index2};
+    int32_t (*encoder_index[])(void *) = {BUS_DC(cvra_dc_get_index0),
+                                          BUS_DC(cvra_dc_get_index1),
+                                          BUS_DC(cvra_dc_get_index2)};
 
     void* encoder_index_param[] = { (void*)HEXMOTORCONTROLLER_BASE,
                                     (void*)HEXMOTORCONTROLLER_BASE,
                                     (void*)HEXMOTORCONTROLLER_BASE};
 
-    holonomic_position_set_mot_encoder(&robot.pos, motor_encoder, motor_encoder_param,
+    holonomic_position_set_mot_encoder(&ctx->robot->pos, motor_encoder, motor_encoder_param,
                                        encoder_index, encoder_index_param);
 
 
@@ -203,67 +234,142 @@ void cvra_cs_init(void) {
     /****************************************************************************/
     
     /******************************** ANGLE *************************************/
-    quadramp_init(&robot.angle_qr);
-    quadramp_set_2nd_order_vars(&robot.angle_qr,10000,10000);
-    quadramp_set_1st_order_vars(&robot.angle_qr,10000,10000);
+    quadramp_init(&ctx->robot->angle_qr);
+    quadramp_set_2nd_order_vars(&ctx->robot->angle_qr,10000,10000);
+    quadramp_set_1st_order_vars(&ctx->robot->angle_qr,10000,10000);
     
     
     ///******************************** OMEGA ************************************/
-    ramp_init(&robot.omega_r);
-    ramp_set_vars(&robot.omega_r, 400,400);
+    ramp_init(&ctx->robot->omega_r);
+    ramp_set_vars(&ctx->robot->omega_r, 400,400);
     
     
     ///******************************** SPEED *************************************/
-    ramp_init(&robot.speed_r);
-    ramp_set_vars(&robot.speed_r,100,100);
+    ramp_init(&ctx->robot->speed_r);
+    ramp_set_vars(&ctx->robot->speed_r,100,100);
     
 
     ///****************************************************************************/
     ///*                           Trajectory Manager (Trivial)                   */
     ///****************************************************************************/
-    holonomic_trajectory_init(&robot.traj, ASSERV_FREQUENCY/10);
-    holonomic_trajectory_set_ramps(&robot.traj, &robot.speed_r, &robot.angle_qr, &robot.omega_r);
+    holonomic_trajectory_init(&ctx->robot->traj, ASSERV_FREQUENCY/10);
+    holonomic_trajectory_set_ramps(&ctx->robot->traj, &ctx->robot->speed_r, &ctx->robot->angle_qr, &ctx->robot->omega_r);
     
-    holonomic_trajectory_set_robot_params(&robot.traj, &robot.rs, &robot.pos);
-    holonomic_trajectory_set_windows(&robot.traj, 10, 0.020);
+    holonomic_trajectory_set_robot_params(&ctx->robot->traj, &ctx->robot->rs, &ctx->robot->pos);
+    holonomic_trajectory_set_windows(&ctx->robot->traj, 10, 0.020);
     
-    robot.avoiding = 0;
-    //cvra_beacon_init(&robot.beacon, AVOIDING_BASE, AVOIDING_IRQ);
+    teleop_init(&ctx->robot->teleop, &ctx->robot->rs, &ctx->robot->traj);
+    rpc_init(&ctx->robot->rpc, ctx);
+    team_sync_init(&ctx->robot->team, ctx);
+    path_follower_init(&ctx->robot->follower, &ctx->robot->rs, &ctx->robot->pos, &ctx->robot->traj, ASSERV_FREQUENCY);
+    orca_init(&ctx->robot->orca, ctx, ASSERV_FREQUENCY);
+    clearance_init(&ctx->robot->clearance, ctx);
+    clearance_attach(&ctx->robot->clearance, &ctx->robot->follower);
+
+    obstacle_map_init(&ctx->robot->obstacles, ctx);
+    avoidance_init(&ctx->robot->avoid, ctx);
+    dock_init(&ctx->robot->dock, ctx);
+    //cvra_beacon_init(&ctx->robot->beacon, AVOIDING_BASE, AVOIDING_IRQ);
     
     /* ajoute la regulation au multitache. ASSERV_FREQUENCY est dans cvra_cs.h */
-    scheduler_add_periodical_event_priority(cvra_cs_manage, NULL, (1000000
+    scheduler_add_periodical_event_priority(cvra_cs_manage, ctx, (1000000
             / ASSERV_FREQUENCY) / SCHEDULER_UNIT, 130);
 }
 
 
-void cvra_cs_manage(__attribute__((unused)) void * dummy) {
+void cvra_cs_manage(void *data) {
+    struct robot_context *ctx = data;
+    int32_t time = uptime_get();
+
+    TRACE_BEGIN(TRACE_CS_MANAGE);
     
     //NOTICE(ERROR_CS, __FUNCTION__);
     //DEBUG(E_ROBOT_SYSTEM, "LOL");
+
+    /* Applique la consigne de teleoperation recue depuis le dernier tick. */
+    teleop_manage(&ctx->robot->teleop);
+
+    /* Obstacles vus par les balises et les capteurs de proximite. */
+    obstacle_map_update(&ctx->robot->obstacles);
+
+    /* Suivi de chemin continu, calcule a la frequence de la regulation. */
+    TRACE_BEGIN(TRACE_PATH_FOLLOWER);
+    path_follower_manage(&ctx->robot->follower);
+    TRACE_END(TRACE_PATH_FOLLOWER);
+    TRACE_COUNTER(TRACE_SPEED, ctx->robot->rs.speed);
+
+    /* Met en pause le mouvement si un robot est devant, le reprend quand la
+     * voie est libre. */
+    avoidance_manage(&ctx->robot->avoid);
+
+    /* Approche finale d'un bord sur les capteurs de distance. */
+    dock_manage(&ctx->robot->dock);
+
+    /* Demarre le match des que la tirette est tiree, sans attendre la boucle
+     * principale. */
+    strat_check_starter(ctx);
+
+    /* Sauve la position et l'etat de la strat pour un redemarrage a chaud. */
+    boot_hot_save(ctx);
+
+    /* Contourne les autres robots : corrige la vitesse demandee juste avant
+     * de la donner aux roues. */
+    TRACE_BEGIN(TRACE_ORCA);
+    orca_manage(&ctx->robot->orca);
+    TRACE_END(TRACE_ORCA);
+
     /* Gestion de la position. */
     
-    rsh_update(&robot.rs);
-    holonomic_position_manage(&robot.pos);
-    
-#ifdef COMPILE_ON_ROBOT
-    ///** Check the flag d'avoiding, appeler strat_avoiding*/
-    if (robot.beacon.nb_edges && !robot.avoiding)
-    {
-        printf("ROBOT DETECTED\n");
-        robot.avoiding = 1;
-        strat_avoiding();
-        
+    rsh_update(&ctx->robot->rs);
+    holonomic_position_manage(&ctx->robot->pos);
+
+    cs_manage(&ctx->robot->wheel0_cs);
+    cs_manage(&ctx->robot->wheel1_cs);
+    cs_manage(&ctx->robot->wheel2_cs);
+
+    TRACE_END(TRACE_CS_MANAGE);
+
+    /* Compte des acces au bus de ce tick. */
+    busstat_tick();
+
+    /* Mesure du temps de calcul, pour comparer les changements de layout. */
+    time = uptime_get() - time;
+    if(time > ctx->robot->cs_manage_time_max)
+        ctx->robot->cs_manage_time_max = time;
+    ctx->robot->cs_manage_time_total += time;
+    ctx->robot->cs_manage_count++;
+}
+
+void cvra_cs_enable(struct robot_context *ctx, int enabled) {
+    struct _rob *r = ctx->robot;
+    CVRA_CS_LOCK();
+
+    if(!enabled) {
+        cs_disable(&r->wheel0_cs);
+        cs_disable(&r->wheel1_cs);
+        cs_disable(&r->wheel2_cs);
+        BUS_DC(cvra_dc_set_pwm0)(HEXMOTORCONTROLLER_BASE, 0);
+        BUS_DC(cvra_dc_set_pwm1)(HEXMOTORCONTROLLER_BASE, 0);
+        BUS_DC(cvra_dc_set_pwm2)(HEXMOTORCONTROLLER_BASE, 0);
+        CVRA_CS_UNLOCK();
+        return;
     }
-    //else if ((robot.beacon.nb_edges == 0) && robot.avoiding)
-    //{
-        //printf("OUT OF SIGHT\n");
-        ////robot.avoiding = 0;
-        ////strat_restart_after_avoiding();
-    //}
-#endif
-        
 
-    cs_manage(&robot.wheel0_cs);
-    cs_manage(&robot.wheel1_cs);
-    cs_manage(&robot.wheel2_cs);
+    /* Sans ca l'integrale et la derniere erreur d'avant la coupure donnent
+     * un coup aux roues. */
+    rsh_set_speed(&r->rs, 0);
+    rsh_set_rotation_speed(&r->rs, 0);
+    r->follower.speed = 0;
+
+    pid_reset(&r->wheel0_pid);
+    pid_reset(&r->wheel1_pid);
+    pid_reset(&r->wheel2_pid);
+    cs_set_consign(&r->wheel0_cs, 0);
+    cs_set_consign(&r->wheel1_cs, 0);
+    cs_set_consign(&r->wheel2_cs, 0);
+
+    cs_enable(&r->wheel0_cs);
+    cs_enable(&r->wheel1_cs);
+    cs_enable(&r->wheel2_cs);
+    CVRA_CS_UNLOCK();
 }
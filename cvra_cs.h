@@ -23,48 +23,96 @@
 
 #ifdef COMPILE_ON_ROBOT
 #include <cvra_beacon.h>
+#include <sys/alt_irq.h>
 #endif
 
 #include <obstacle_avoidance.h>
 
 #include "strat.h"
+#include "teleop.h"
+#include "path_follower.h"
+#include "orca.h"
+#include "avoidance.h"
+#include "obstacle_map.h"
+#include "dock.h"
+#include "battery.h"
+#include "clearance.h"
+#include "rpc.h"
+#include "team_sync.h"
+#include "com_balises.h"
+#include "boot.h"
+#include "robot_link.h"
 #include "cvra_param_robot.h"
 
 /** Frequency of the regulation loop (in Hz) */
 #define ASSERV_FREQUENCY 100.0
 
+/** Size of a line of the Nios data cache, in bytes. */
+#define ROBOT_CACHE_LINE 32
+
 /**
  @brief contains all global vars.
  
  This structure contains all vars that should be global. This is a clean way to
  group all vars in one place. It also serve as a namespace.
+
+ The fields are in three groups, each starting on a cache line :
+  - the regulation : robot system, position and the wheel control systems,
+    in the order cvra_cs_manage() uses them, and its execution time. Small,
+    read and written at every tick ;
+  - the modules cvra_cs_manage() runs before the regulation, in the order it
+    calls them. Also touched at every tick, but large (the follower keeps its
+    whole path), so they come after the regulation instead of between its
+    fields ;
+  - the configuration and the slow tasks, so they do not evict the two
+    groups above from the data cache.
+
+ @note The gain was not measured : the layout was changed without access to
+ the robot, and the Nios II has no cache-miss counter. To compare, run
+ cs_stats reset, a match, then cs_stats, once with this layout and once with
+ the fields in their previous order, and write the mean and max here.
  */
 struct _rob {
-    uint8_t verbosity_level;                ///< @deprecated Contient le niveau de debug du robot.
-    
-    struct robot_system_holonomic rs;       ///< Holonomic robot system
+    /* ---- Regulation : every tick, in the order of cvra_cs_manage(). ---- */
+
+    struct robot_system_holonomic rs __attribute__((aligned(ROBOT_CACHE_LINE))); ///< Holonomic robot system
     struct holonomic_robot_position pos;      ///< Position manager
-    
-    /** Control system associé à chaque roue (juste les PID) */
+
+    /** Regulation of each wheel, grouped by wheel : cs_manage() goes through
+     * the cs, its ramp and its PID one after the other.
+     * (Control system associated to each wheel, PID and ramp.) */
     struct cs wheel0_cs;
-    struct cs wheel1_cs;
-    struct cs wheel2_cs;
-    
-    /** PID associés à chque roues */
+    struct ramp_filter wheel0_ramp;
     struct pid_filter wheel0_pid;
+    struct cs wheel1_cs;
+    struct ramp_filter wheel1_ramp;
     struct pid_filter wheel1_pid;
+    struct cs wheel2_cs;
+    struct ramp_filter wheel2_ramp;
     struct pid_filter wheel2_pid;
-    
+
+    /** Execution time of cvra_cs_manage(), in us. */
+    int32_t cs_manage_time_max;
+    uint32_t cs_manage_time_total;
+    uint32_t cs_manage_count;
+
+    /* ---- Modules : every tick too, in the order cvra_cs_manage() calls them. ---- */
+
+    struct teleop teleop __attribute__((aligned(ROBOT_CACHE_LINE))); ///< Binary velocity teleoperation.
+    struct obstacle_map obstacles;            ///< Beacon tracks and proximity sensors, fused.
+    struct path_follower follower;            ///< Continuous polyline follower.
+    struct avoidance avoid;                   ///< Pauses the move when a robot is in the way.
+    struct dock dock;                         ///< Final approach of a border on the distance sensors.
+    struct orca orca;                         ///< Velocity obstacles around the other robots.
+
 #ifdef COMPILE_ON_ROBOT
     volatile cvra_beacon_t beacon;
 #endif
 
-    struct ramp_filter wheel0_ramp;
-    struct ramp_filter wheel1_ramp;
-    struct ramp_filter wheel2_ramp;
-    
+    /* ---- Cold : configuration and slow tasks, kept out of the lines above. ---- */
+
     /** Filtres */
-    struct quadramp_filter angle_qr;
+    struct quadramp_filter angle_qr __attribute__((aligned(ROBOT_CACHE_LINE)));
     struct ramp_filter omega_r;
     struct ramp_filter speed_r; /* antoine: dafuq ? */
     
@@ -74,9 +122,14 @@ struct _rob {
     struct cs speed_cs;
     
     struct h_trajectory traj;                 ///< Trivial trajectory manager.
-    
-    int avoiding;
-    
+
+    struct rpc rpc;                         ///< Binary requests from the PC tools.
+    struct team_sync team;                  ///< World model shared with the teammate.
+    struct clearance_map clearance;         ///< Slows the path follower near obstacles.
+
+    cvra_adc_t analog_in;                   ///< Analog inputs, see hardware.h for the channels.
+    struct battery battery;                 ///< Battery voltage and compensation of the PWMs.
+
     /** waiting for this to be implemented */
     int robot_in_sight;
     // Sans balises on n'en a pas besoin
@@ -86,7 +139,6 @@ struct _rob {
     uint8_t is_aligning:1;                  ///< =1 if the robot is aligning on border
     
     uint8_t error_dump_enabled:1;           ///< =1 if infos should be dumped
-    uint8_t avoiding_enabled:1;
     uint8_t askLog;
 };
 
@@ -99,6 +151,43 @@ struct _rob {
  */
 extern struct _rob robot;
 
+struct selftest_io;
+
+/**
+ @brief Everything one robot instance works on.
+
+ The control loop, the strategy and the communication modules get their
+ state through this context instead of the globals, so a host process can
+ run several simulated robots, each with its own context (and its own
+ thread for the blocking strategy calls).
+
+ The robot build uses default_context, which points to the globals robot,
+ strat, beacon_com and boot_hot, so the shell commands keep using them.
+ */
+struct robot_context {
+    struct _rob *robot;
+    struct strat_info *strat;
+    struct beacon_com *beacon_com;
+    struct boot_hot_state *hot;           ///< Hot restart state, NULL to disable.
+
+    /** Returns 1 once the starter cord is pulled. */
+    int (*starter_pulled)(struct robot_context *ctx);
+
+    struct robot_link *link;              ///< Link to the teammate, NULL if none.
+
+    /** Hardware checked by the self test, see selftest.h. */
+    const struct selftest_io *selftest_io;
+
+    /** Temps maximum passe dans une boucle du scheduler, en us. */
+    int32_t longest_scheduler_interrupt_time;
+};
+
+/** The context of the robot build. */
+extern struct robot_context default_context;
+
+/** The beacon link of the robot build. */
+extern struct beacon_com beacon_com;
+
 /**
  @brief Inits all the regulation related modules.
  
@@ -113,7 +202,7 @@ extern struct _rob robot;
  - blocking_detection_manager
  - couple_limiter
  */
-void cvra_cs_init(void);
+void cvra_cs_init(struct robot_context *ctx);
 
 
 /**
@@ -128,7 +217,32 @@ void cvra_cs_init(void);
  @note This function needs to be called often and is compatible with the
  base/scheduler module. The trajectory_manager runs its own task at 10 Hz.
  */        
-void cvra_cs_manage(void * dummy);
+void cvra_cs_manage(void *ctx);
+
+/** @brief Critical section against the control loop.
+ *
+ * The foreground code (strategy, shell commands) takes it while it changes
+ * state the control loop reads, so the tick never sees half of a change.
+ * On the robot the interrupts are disabled. On the host the simulation runs
+ * the tick in its own thread, sim_step() holds the same lock during the
+ * tick. It can be nested, and taken again from the tick itself.
+ */
+#ifdef COMPILE_ON_ROBOT
+#define CVRA_CS_LOCK()      alt_irq_context cvra_cs_irq = alt_irq_disable_all()
+#define CVRA_CS_UNLOCK()    alt_irq_enable_all(cvra_cs_irq)
+#else
+#define CVRA_CS_LOCK()      cvra_cs_lock()
+#define CVRA_CS_UNLOCK()    cvra_cs_unlock()
+void cvra_cs_lock(void);
+void cvra_cs_unlock(void);
+#endif
+
+/** @brief Enables or disables the wheel control systems.
+ *
+ * Enabling is bumpless : the PIDs are reset and the robot starts from a zero
+ * consign, instead of jumping to the velocity it had when disabled.
+ */
+void cvra_cs_enable(struct robot_context *ctx, int enabled);
 
 
  
@@ -44,6 +44,9 @@
 #define ROBOT_WHEEL_THICKNESS1_MM 12.5
 #define ROBOT_WHEEL_THICKNESS2_MM 12.5
 
+/** Radius of the circle around the robot, used by clearance, orca and sim. */
+#define ROBOT_RADIUS_MM 150.
+
 #define ROBOT_BETA_WHEEL0_RAD  (60.0*M_PI/180.0)
 #define ROBOT_BETA_WHEEL1_RAD  (180.0*M_PI/180.0)
 #define ROBOT_BETA_WHEEL2_RAD  (300.0*M_PI/180.0)
@@ -54,6 +57,9 @@
 #define ROBOT_INDEX_OFFSET1 4195
 #define ROBOT_INDEX_OFFSET2 2601
 
+/** Units of rsh_set_rotation_speed() for 1 rad/s (the robot system takes deg/s). */
+#define ROBOT_OMEGA_UNITS_PER_RAD_S (180.0/M_PI)
+
 //                       *********************************************
 //                                             Blocage
 //                       *********************************************
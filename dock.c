@@ -0,0 +1,120 @@
+/** @file dock.c
+ * @brief Final approach of a border, on the distance sensors.
+ * @sa dock.h
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+#include <uptime.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/position_manager.h>
+
+#include "cvra_cs.h"
+#include "hardware.h"
+#include "path_follower.h"
+#include "dock.h"
+
+void dock_init(struct dock *d, struct robot_context *ctx) {
+    memset(d, 0, sizeof(struct dock));
+    d->ctx = ctx;
+}
+
+int dock_read(double *left, double *right) {
+    int l, r;
+
+    cvra_get_distance_sensors(&l, &r);
+    if(l < DOCK_ADC_MIN || r < DOCK_ADC_MIN)
+        return -1;
+
+    *left = DOCK_ADC_K / l;
+    *right = DOCK_ADC_K / r;
+    return 0;
+}
+
+int dock_start(struct dock *d, double distance, double x) {
+    double left, right;
+
+    if(dock_read(&left, &right) < 0) {
+        d->state = DOCK_LOST;
+        return -1;
+    }
+
+    CVRA_CS_LOCK();
+    d->distance = distance;
+    d->x = x;
+    d->left = left;
+    d->right = right;
+    d->settled = 0;
+    d->start = uptime_get();
+    d->state = DOCK_ACTIVE;
+    CVRA_CS_UNLOCK();
+    return 0;
+}
+
+void dock_stop(struct dock *d) {
+    CVRA_CS_LOCK();
+    if(d->state == DOCK_ACTIVE)
+        d->state = DOCK_IDLE;
+    rsh_set_speed(&d->ctx->robot->rs, 0);
+    rsh_set_rotation_speed(&d->ctx->robot->rs, 0);
+    CVRA_CS_UNLOCK();
+}
+
+static double dock_clamp(double v, double max) {
+    if(v > max)
+        return max;
+    if(v < -max)
+        return -max;
+    return v;
+}
+
+void dock_manage(struct dock *d) {
+    struct _rob *r = d->ctx->robot;
+    double left, right, a, normal, vn, vx, vy, omega;
+    int32_t now;
+
+    if(d->state != DOCK_ACTIVE)
+        return;
+
+    now = uptime_get();
+    if(dock_read(&left, &right) < 0 || now - d->start > DOCK_TIMEOUT) {
+        d->state = DOCK_LOST;
+        dock_stop(d);
+        return;
+    }
+
+    d->left += DOCK_FILTER * (left - d->left);
+    d->right += DOCK_FILTER * (right - d->right);
+
+    /* Plus loin a gauche : on regarde trop a gauche, on tourne a droite. */
+    d->angle = atan2(d->left - d->right, DOCK_SENSOR_SPACING);
+    d->error = (d->left + d->right) / 2. * cos(d->angle) + DOCK_SENSOR_MOUNT - d->distance;
+
+    if(fabs(d->error) < DOCK_WINDOW && fabs(d->angle) < DOCK_ANGLE_WINDOW &&
+       fabs(d->x - holonomic_position_get_x_double(&r->pos)) < DOCK_WINDOW) {
+        if(!d->settled) {
+            d->settled = 1;
+            d->settled_since = now;
+        }
+        else if(now - d->settled_since >= DOCK_SETTLE_TIME) {
+            d->state = DOCK_DONE;
+            dock_stop(d);
+            return;
+        }
+    }
+    else
+        d->settled = 0;
+
+    /* Vers le bord dans la direction des capteurs, corrigee de l'angle
+     * mesure : le bord est parallele a X, donc normal a Y. */
+    a = holonomic_position_get_a_rad_double(&r->pos);
+    normal = sin(a + DOCK_SENSOR_ANGLE + d->angle) > 0 ? M_PI_2 : -M_PI_2;
+    vn = dock_clamp(DOCK_KP * d->error, DOCK_MAX_SPEED);
+    vx = dock_clamp(DOCK_KX * (d->x - holonomic_position_get_x_double(&r->pos)), DOCK_MAX_SPEED);
+    vy = vn * sin(normal);
+    omega = dock_clamp(-DOCK_KA * d->angle, DOCK_MAX_OMEGA);
+
+    holonomic_set_world_velocity(&r->rs, &r->pos, hypot(vx, vy), atan2(vy, vx),
+                                 (int32_t)(omega * ROBOT_OMEGA_UNITS_PER_RAD_S));
+}
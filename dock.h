@@ -0,0 +1,92 @@
+/** @file dock.h
+ * @brief Final approach of a border, on the distance sensors.
+ *
+ * The gifts are triggered from a given distance of the border. The odometry
+ * alone is a few millimeters and a few tenths of a degree off at the end of
+ * the match, so the last centimeters are servoed on the two distance sensors
+ * (ADC_DISTANCE_LEFT and ADC_DISTANCE_RIGHT) looking at the border :
+ *  - their mean gives the distance to the border, held at the target ;
+ *  - their difference gives the angle to the border, held at zero, so the
+ *    robot ends parallel to it ;
+ *  - the position along the border comes from the odometry, held at the
+ *    target too.
+ *
+ * The border must be parallel to the X axis, as the ones of the gifts.
+ * "Left" is the sensor on the left when looking at the border.
+ *
+ * Docking ends when both errors stayed within their windows for
+ * DOCK_SETTLE_TIME. If a sensor is out of its range, or the robot did not
+ * settle within DOCK_TIMEOUT, it stops with DOCK_LOST and the caller falls
+ * back to the odometry.
+ */
+#ifndef _DOCK_H_
+#define _DOCK_H_
+
+#include <aversive.h>
+
+/** Sensors : direction they look at and position, in the robot frame. */
+#define DOCK_SENSOR_ANGLE      M_PI     /**< rad */
+#define DOCK_SENSOR_MOUNT      80.      /**< mm, from the center along their direction. */
+#define DOCK_SENSOR_SPACING    120.     /**< mm, between the two. */
+
+/** Conversion of the 10 bits values, distance = K / value. Values below
+ * DOCK_ADC_MIN are out of range. To calibrate with the dock command. */
+#define DOCK_ADC_K             30000.
+#define DOCK_ADC_MIN           100
+#define DOCK_FILTER            0.3      /**< Weight of a new sample. */
+
+#define DOCK_KP                4.       /**< 1/s, on the distance. */
+#define DOCK_KX                4.       /**< 1/s, along the border. */
+#define DOCK_KA                4.       /**< 1/s, on the angle. */
+#define DOCK_MAX_SPEED         200.     /**< mm/s */
+#define DOCK_MAX_OMEGA         1.       /**< rad/s */
+
+#define DOCK_WINDOW            2.       /**< mm */
+#define DOCK_ANGLE_WINDOW      0.01     /**< rad */
+#define DOCK_SETTLE_TIME       100000   /**< us */
+#define DOCK_TIMEOUT           1500000  /**< us */
+
+typedef enum {
+    DOCK_IDLE = 0,
+    DOCK_ACTIVE,                   /**< Servoing on the sensors. */
+    DOCK_DONE,                     /**< At the target. */
+    DOCK_LOST,                     /**< A sensor out of range, or too long. */
+} dock_state_t;
+
+struct robot_context;
+
+struct dock {
+    struct robot_context *ctx;
+    volatile dock_state_t state;
+
+    double distance;               /**< Target, center to border, in mm. */
+    double x;                      /**< Target along the border, in mm. */
+    int32_t start;                 /**< us */
+    int32_t settled_since;         /**< us */
+    uint8_t settled;
+
+    double left, right;            /**< Filtered distances, sensors to border, in mm. */
+    double error;                  /**< Last distance error, in mm. */
+    double angle;                  /**< Last angle to the border, in rad. */
+};
+
+void dock_init(struct dock *d, struct robot_context *ctx);
+
+/** Starts docking, from a few centimeters of the border.
+ *
+ * @param [in] distance Distance to reach from the center of the robot to the border, in mm.
+ * @param [in] x Position to reach along the border, in mm.
+ * @returns 0, or -1 if the sensors do not see the border.
+ */
+int dock_start(struct dock *d, double distance, double x);
+
+/** Stops docking, the robot stops. */
+void dock_stop(struct dock *d);
+
+/** Reads the sensors, in mm from the sensors. Returns -1 if out of range. */
+int dock_read(double *left, double *right);
+
+/** Servoes the robot on the border. Called at each control tick, before orca_manage(). */
+void dock_manage(struct dock *d);
+
+#endif
@@ -0,0 +1,379 @@
+/** @file fmt.c
+ * @brief Lightweight formatted output.
+ * @sa fmt.h
+ */
+
+#include <aversive.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#ifdef COMPILE_ON_ROBOT
+#include <sys/alt_irq.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "fmt.h"
+
+static char fmt_buffer[FMT_BUFFER_SIZE];
+static volatile uint16_t fmt_head; /**< Next character written. */
+static volatile uint16_t fmt_tail; /**< Next character sent, written by the foreground only. */
+static volatile uint32_t fmt_drop_count;
+static volatile uint8_t fmt_interrupt; /**< =1 inside the timer interrupt. */
+
+/* Sur le robot, une insertion ne doit pas etre coupee par une interruption.
+ * Sur le PC, plusieurs robots simules ecrivent depuis des threads differents,
+ * un appel complet est protege pour ne pas melanger les lignes. */
+#ifdef COMPILE_ON_ROBOT
+#define FMT_IRQ_LOCK()      alt_irq_context fmt_irq = alt_irq_disable_all()
+#define FMT_IRQ_UNLOCK()    alt_irq_enable_all(fmt_irq)
+#define FMT_HOST_LOCK()
+#define FMT_HOST_UNLOCK()
+#else
+static pthread_mutex_t fmt_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define FMT_IRQ_LOCK()
+#define FMT_IRQ_UNLOCK()
+#define FMT_HOST_LOCK()     pthread_mutex_lock(&fmt_mutex)
+#define FMT_HOST_UNLOCK()   pthread_mutex_unlock(&fmt_mutex)
+#endif
+
+/* Quand le buffer est plein, le premier plan attend la sortie plutot que de
+ * perdre du texte : seule l'interruption du robot, qui ne doit jamais
+ * attendre l'UART, perd ce qui ne rentre pas. Sur le PC tout le monde
+ * peut attendre. */
+#ifdef COMPILE_ON_ROBOT
+#define FMT_CAN_WAIT()      (!fmt_interrupt)
+#else
+#define FMT_CAN_WAIT()      1
+#endif
+
+static int fmt_drain_unlocked(void);
+
+/** Free room in the buffer. */
+static int fmt_free(void) {
+    return (fmt_tail - fmt_head - 1) & (FMT_BUFFER_SIZE - 1);
+}
+
+/* Le buffer n'est pas vide ici, pour garder ce qui a ete ecrit avant. La
+ * sortie reste bloquante, pour le shell et aversive qui ecrivent aussi
+ * dessus : le buffer est vide par la boucle de premier plan (voir main()). */
+void fmt_init(void) {
+}
+
+void fmt_interrupt_enter(void) {
+    fmt_interrupt = 1;
+}
+
+void fmt_interrupt_exit(void) {
+    fmt_interrupt = 0;
+}
+
+/** Inserts a character, the caller holds the host lock. */
+static void fmt_insert(char c) {
+    uint16_t next;
+
+    while(FMT_CAN_WAIT() && fmt_free() == 0 && fmt_drain_unlocked() > 0);
+
+    FMT_IRQ_LOCK();
+
+    next = (fmt_head + 1) & (FMT_BUFFER_SIZE - 1);
+    if(next == fmt_tail) {
+        fmt_drop_count++;
+    }
+    else {
+        fmt_buffer[fmt_head] = c;
+        fmt_head = next;
+    }
+
+    FMT_IRQ_UNLOCK();
+}
+
+void fmt_putchar(char c) {
+    FMT_HOST_LOCK();
+    fmt_insert(c);
+    FMT_HOST_UNLOCK();
+}
+
+int fmt_write(const void *data, int len) {
+    const char *p = data;
+    int ret = 0;
+    FMT_HOST_LOCK();
+
+    if(len < FMT_BUFFER_SIZE)
+        while(FMT_CAN_WAIT() && fmt_free() < len && fmt_drain_unlocked() > 0);
+
+    FMT_IRQ_LOCK();
+
+    if(fmt_free() < len) {
+        fmt_drop_count += len;
+        ret = -1;
+    }
+    else {
+        while(len--) {
+            fmt_buffer[fmt_head] = *p++;
+            fmt_head = (fmt_head + 1) & (FMT_BUFFER_SIZE - 1);
+        }
+    }
+
+    FMT_IRQ_UNLOCK();
+#ifndef COMPILE_ON_ROBOT
+    fmt_drain_unlocked();
+#endif
+    FMT_HOST_UNLOCK();
+    return ret;
+}
+
+void fmt_drain(void) {
+    FMT_HOST_LOCK();
+    fmt_drain_unlocked();
+    FMT_HOST_UNLOCK();
+}
+
+/** Sends the buffer, the caller holds the host lock.
+ * @returns The number of characters sent. */
+static int fmt_drain_unlocked(void) {
+    uint16_t head = fmt_head, tail = fmt_tail;
+    int len, written, sent = 0;
+
+    while(head != tail) {
+        /* Partie contigue du buffer. */
+        len = (head > tail ? head : FMT_BUFFER_SIZE) - tail;
+#ifdef COMPILE_ON_ROBOT
+        written = write(STDOUT_FILENO, &fmt_buffer[tail], len);
+#else
+        written = fwrite(&fmt_buffer[tail], 1, len, stdout);
+#endif
+        if(written <= 0)
+            break;
+        tail = (tail + written) & (FMT_BUFFER_SIZE - 1);
+        fmt_tail = tail;
+        sent += written;
+    }
+#ifndef COMPILE_ON_ROBOT
+    fflush(stdout);
+#endif
+    return sent;
+}
+
+void fmt_flush(void) {
+    FMT_HOST_LOCK();
+    while(fmt_head != fmt_tail && fmt_drain_unlocked() > 0);
+    FMT_HOST_UNLOCK();
+}
+
+uint32_t fmt_dropped(void) {
+    return fmt_drop_count;
+}
+
+/** Writes an unsigned number, padded to width. */
+static int fmt_unsigned(uint32_t value, int base, int upper, int width, char pad, int left, const char *prefix) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[11];
+    int len = 0, prefix_len = strlen(prefix), count, i;
+
+    do {
+        tmp[len++] = digits[value % base];
+        value /= base;
+    } while(value);
+
+    count = len + prefix_len;
+
+    /* Le signe va devant les zeros, mais apres les espaces. */
+    if(pad == '0' && !left) {
+        for(i=0;i<prefix_len;i++)
+            fmt_insert(prefix[i]);
+        prefix_len = 0;
+    }
+    if(!left) {
+        for(;count<width;count++)
+            fmt_insert(pad);
+    }
+    for(i=0;i<prefix_len;i++)
+        fmt_insert(prefix[i]);
+    while(len)
+        fmt_insert(tmp[--len]);
+    if(left) {
+        for(;count<width;count++)
+            fmt_insert(' ');
+    }
+    return count;
+}
+
+/** Writes a fixed point value with precision decimals. */
+static int fmt_fixed(double value, int precision, int width, char pad, int left) {
+    static const uint32_t scale[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+    double a = value < 0 ? -value : value;
+    uint32_t integer, decimals;
+    int count, i;
+    char tmp[7];
+    const char *s;
+
+    if(precision > 6)
+        precision = 6;
+
+    /* Hors de 32 bits (inf et nan compris) la conversion n'est pas definie. */
+    if(!(a < 4294967295.)) {
+        s = value < 0 ? "-ovf" : "ovf";
+        for(count=0;!left && count+(int)strlen(s)<width;count++)
+            fmt_insert(' ');
+        for(i=0;s[i];i++,count++)
+            fmt_insert(s[i]);
+        for(;left && count<width;count++)
+            fmt_insert(' ');
+        return count;
+    }
+
+    /* La partie entiere d'abord : seules les decimales sont mises a
+     * l'echelle, sans depasser 32 bits. */
+    integer = (uint32_t)a;
+    decimals = (uint32_t)((a - integer) * scale[precision] + 0.5);
+    if(decimals >= scale[precision]) {
+        decimals -= scale[precision];
+        integer++;
+    }
+
+    if(precision == 0)
+        return fmt_unsigned(integer, 10, 0, width, pad, left, value < 0 ? "-" : "");
+
+    count = fmt_unsigned(integer, 10, 0, left ? 0 : width - precision - 1, pad, 0, value < 0 ? "-" : "");
+    fmt_insert('.');
+    for(i=precision-1;i>=0;i--) {
+        tmp[i] = '0' + decimals % 10;
+        decimals /= 10;
+    }
+    for(i=0;i<precision;i++)
+        fmt_insert(tmp[i]);
+    count += precision + 1;
+    if(left) {
+        for(;count<width;count++)
+            fmt_insert(' ');
+    }
+    return count;
+}
+
+int fmt_vprintf(const char *format, va_list ap) {
+    int count = 0, width, precision, left, longarg, len;
+    char pad;
+    const char *s;
+    int32_t value;
+
+    FMT_HOST_LOCK();
+
+    for(;*format;format++) {
+        if(*format != '%') {
+            fmt_insert(*format);
+            count++;
+            continue;
+        }
+        format++;
+
+        left = 0;
+        pad = ' ';
+        for(;;format++) {
+            if(*format == '-')
+                left = 1;
+            else if(*format == '0')
+                pad = '0';
+            else
+                break;
+        }
+
+        width = 0;
+        while(*format >= '0' && *format <= '9')
+            width = width * 10 + *format++ - '0';
+
+        precision = -1;
+        if(*format == '.') {
+            precision = 0;
+            format++;
+            while(*format >= '0' && *format <= '9')
+                precision = precision * 10 + *format++ - '0';
+        }
+
+        /* int et long font 32 bits sur le Nios, les 'h' sont promus. */
+        longarg = 0;
+        while(*format == 'l' || *format == 'h') {
+            if(*format == 'l')
+                longarg = 1;
+            format++;
+        }
+
+        switch(*format) {
+            case 'd':
+            case 'i':
+                value = longarg ? (int32_t)va_arg(ap, long) : va_arg(ap, int);
+                if(value < 0)
+                    count += fmt_unsigned(-(uint32_t)value, 10, 0, width, pad, left, "-");
+                else
+                    count += fmt_unsigned(value, 10, 0, width, pad, left, "");
+                break;
+            case 'u':
+                count += fmt_unsigned(longarg ? (uint32_t)va_arg(ap, unsigned long) : va_arg(ap, unsigned int),
+                                      10, 0, width, pad, left, "");
+                break;
+            case 'x':
+            case 'X':
+                count += fmt_unsigned(longarg ? (uint32_t)va_arg(ap, unsigned long) : va_arg(ap, unsigned int),
+                                      16, *format == 'X', width, pad, left, "");
+                break;
+            case 'p':
+                count += fmt_unsigned((uint32_t)(uintptr_t)va_arg(ap, void *), 16, 0, width, pad, left, "0x");
+                break;
+            case 'f':
+                count += fmt_fixed(va_arg(ap, double), precision < 0 ? FMT_DEFAULT_PRECISION : precision,
+                                   width, pad, left);
+                break;
+            case 'c':
+                fmt_insert((char)va_arg(ap, int));
+                count++;
+                break;
+            case 's':
+                s = va_arg(ap, const char *);
+                if(s == NULL)
+                    s = "(null)";
+                len = strlen(s);
+                if(precision >= 0 && len > precision)
+                    len = precision;
+                for(;!left && len<width;width--,count++)
+                    fmt_insert(' ');
+                count += len;
+                width -= len;
+                while(len--)
+                    fmt_insert(*s++);
+                for(;left && width>0;width--,count++)
+                    fmt_insert(' ');
+                break;
+            case '%':
+                fmt_insert('%');
+                count++;
+                break;
+            case '\0':
+                format--;
+                break;
+            default:
+                /* Conversion inconnue : on la recopie. */
+                fmt_insert('%');
+                fmt_insert(*format);
+                count += 2;
+                break;
+        }
+    }
+
+#ifndef COMPILE_ON_ROBOT
+    fmt_drain_unlocked();
+#endif
+    FMT_HOST_UNLOCK();
+    return count;
+}
+
+int fmt_printf(const char *format, ...) {
+    va_list ap;
+    int count;
+
+    va_start(ap, format);
+    count = fmt_vprintf(format, ap);
+    va_end(ap);
+    return count;
+}
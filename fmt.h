@@ -0,0 +1,68 @@
+/** @file fmt.h
+ * @brief Lightweight formatted output.
+ *
+ * fmt_printf() understands the subset of printf used in this code :
+ * %d %i %u %x %X %c %s %p %% with the '-' and '0' flags, a width and the
+ * 'l' and 'h' length modifiers. The floating point values are printed by
+ * %f as fixed point, with the number of decimals given by the precision
+ * (3 by default, at most 6) : "%.1f" of 12.345 prints "12.3". There is no
+ * exponent : a value whose integer part does not fit in 32 bits, nan or inf
+ * prints "ovf" (or "-ovf").
+ *
+ * The output goes to a RAM ring buffer, stdout itself stays blocking. On
+ * the robot the buffer is sent by the foreground loop (see main()) with
+ * fmt_drain(). When it is full, a foreground caller waits for the UART, so
+ * long dumps are never cut, while the timer interrupt never waits : what
+ * does not fit is dropped and counted. On the host it is written to
+ * stdout at the end of every call.
+ *
+ * Safe to call from interrupt context, and from several threads on the host.
+ */
+#ifndef _FMT_H_
+#define _FMT_H_
+
+#include <aversive.h>
+#include <stdarg.h>
+
+/** Size of the output buffer, must be a power of two. */
+#define FMT_BUFFER_SIZE 1024
+
+/** Default number of decimals of %f. */
+#define FMT_DEFAULT_PRECISION 3
+
+/** Inits the output. What was written before is kept and sent. */
+void fmt_init(void);
+
+/** Bracket the timer interrupt : output written from it never waits. */
+void fmt_interrupt_enter(void);
+void fmt_interrupt_exit(void);
+
+/** Formatted output, see the supported conversions above.
+ * @returns The number of characters formatted, including the dropped ones. */
+int fmt_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/** Same as fmt_printf() with a va_list. */
+int fmt_vprintf(const char *format, va_list ap);
+
+/** Outputs a single character. */
+void fmt_putchar(char c);
+
+/** Outputs len bytes as a block : either all of them are queued, without
+ * anything in between, or none are and they are counted as dropped.
+ * Used for binary frames.
+ * @returns 0 on success, -1 if the buffer was full. */
+int fmt_write(const void *data, int len);
+
+/** Sends the buffer. Called by the foreground loop.
+ * @warning Blocks on the UART, never call it from interrupt context. */
+void fmt_drain(void);
+
+/** Waits until the buffer is empty, for example before a reset or after a
+ * long dump.
+ * @warning Never call it from interrupt context. */
+void fmt_flush(void);
+
+/** Number of characters dropped because the buffer was full. */
+uint32_t fmt_dropped(void);
+
+#endif
@@ -31,6 +31,7 @@
 
 
 #include "error_numbers.h"
+#include "log.h"
 #include "hardware.h"
 #include "cvra_cs.h"
 #include "adresses.h"
@@ -45,7 +46,7 @@ void cvra_set_uart_speed(int32_t *uart_adress, int baudrate) {
     divisor = (int32_t)(((float)ALT_CPU_FREQ/(float)baudrate) + 0.5);
     IOWR(uart_adress, 0x04, divisor); // ecrit le diviseur dans le bon registre
 #endif
-    DEBUG(E_UART, "Changed UART speed to %d at adress %p\n", baudrate, uart_adress);
+    LDEBUG(ERROR_COMM, "Changed UART speed to %d at adress %p\n", baudrate, uart_adress);
 }
 
 
@@ -59,7 +60,7 @@ void cvra_set_uart_speed(int32_t *uart_adress, int baudrate) {
 void cvra_board_init(void) {
     /* Init de l'ADC */
 #ifdef COMPILE_ON_ROBOT
-//    cvra_adc_init(&robot.analog_in, ANALOG_SPI_ADRESS, ANALOGIN_IRQ);
+    cvra_adc_init(&robot.analog_in, ANALOG_SPI_ADRESS, ANALOGIN_IRQ);
 #endif
     /* On manage les capteurs toutes les 5 ms. */
     scheduler_add_periodical_event_priority(cvra_board_manage_sensors,NULL,5000/SCHEDULER_UNIT,130);
@@ -68,20 +69,37 @@ void cvra_board_init(void) {
 
 
 void cvra_board_manage_sensors(__attribute__((unused)) void * dummy) {
-    //cvra_adc_start_scan(&robot.analog_in);
+#ifdef COMPILE_ON_ROBOT
+    cvra_adc_start_scan(&robot.analog_in);
+#endif
 }
 
 void cvra_get_avoiding_sensors(int *l, int *r) {
-    //TODO : delete. this is only to eliminate warnings.
-    (void*)l;
-    (void*)r;
-    /* C'est branche sur un analog in => seuillage. la val est sur 10
-     * bits donc sur 1024. */
-    /* Le capteur gauche est sur le port analogique 3. */
-    //*l = (cvra_adc_get_value(&robot.analog_in, ADC_OBSTACLE_LEFT) < 500);
-    
-    ///* Le capteur droit est sur le port analogique 4. */
-    //*r = (cvra_adc_get_value(&robot.analog_in, ADC_OBSTACLE_RIGHT) < 500);
+#ifdef COMPILE_ON_ROBOT
+    /* C'est branche sur un analog in, la val est sur 10 bits donc sur
+     * 1024. Le seuillage est fait par l'appelant. */
+    *l = cvra_adc_get_value(&robot.analog_in, ADC_OBSTACLE_LEFT);
+    *r = cvra_adc_get_value(&robot.analog_in, ADC_OBSTACLE_RIGHT);
+#else
+    *l = *r = 1023;
+#endif
+}
+
+void cvra_get_distance_sensors(int *l, int *r) {
+#ifdef COMPILE_ON_ROBOT
+    *l = cvra_adc_get_value(&robot.analog_in, ADC_DISTANCE_LEFT);
+    *r = cvra_adc_get_value(&robot.analog_in, ADC_DISTANCE_RIGHT);
+#else
+    *l = *r = 0;
+#endif
+}
+
+int cvra_get_battery_voltage(void) {
+#if defined(COMPILE_ON_ROBOT) && defined(BATTERY_ENABLED)
+    return cvra_adc_get_value(&robot.analog_in, ADC_BATTERY_VOLTAGE);
+#else
+    return 0;
+#endif
 }
 
 void cvra_board_manage_outputs(void) {
@@ -34,13 +34,29 @@
 #define ADC_STARTER 4
 #define ADC_OBSTACLE_LEFT 5
 #define ADC_OBSTACLE_RIGHT 6
-#define ADC_NOT_CONNECTED 7
+#define ADC_BATTERY_VOLTAGE 7 /**< Not wired yet, see BATTERY_ENABLED in battery.h. */
 
 /** Inits the IO pins. */
 void cvra_board_init(void);
 
 void cvra_board_manage_sensors(void * dummy);
-void nastya_get_avoiding_sensors(int *l, int *r);
+
+/** Reads the proximity sensors, on 10 bits. Something is close when the
+ * value is low ; off the robot nothing ever is.
+ *
+ * @param [out] l, r The left and right values.
+ */
+void cvra_get_avoiding_sensors(int *l, int *r);
+
+/** Reads the distance sensors, on 10 bits. Off the robot they see nothing.
+ *
+ * @param [out] l, r The left and right values, see dock.h.
+ */
+void cvra_get_distance_sensors(int *l, int *r);
+
+/** Reads the battery voltage, on 10 bits, see battery.h. Off the robot, or
+ * without BATTERY_ENABLED, there is no measure : 0. */
+int cvra_get_battery_voltage(void);
 
 /** @brief : Update all the outputs */
 void cvra_board_manage_outputs(void);
@@ -0,0 +1,101 @@
+/** @file log.c
+ * @brief Per module log levels.
+ * @sa log.h
+ */
+
+#include <aversive.h>
+#include <aversive/error.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "log.h"
+#include "fmt.h"
+
+uint8_t log_mask[LOG_NB_MODULES];
+
+static const char *log_module_names[LOG_NB_MODULES] = {
+    "arm",
+    "cs",
+    "avoiding",
+    "scanner",
+    "drivers",
+    "comm",
+    "misc",
+    "other",
+};
+
+static const uint8_t log_compiled_level[LOG_NB_MODULES] = {
+    LOG_LEVEL_ARM,
+    LOG_LEVEL_CS,
+    LOG_LEVEL_AVOIDING,
+    LOG_LEVEL_SCANNER,
+    LOG_LEVEL_DRIVERS,
+    LOG_LEVEL_COMM,
+    LOG_LEVEL_MISC,
+    ERROR_SEVERITY_DEBUG,
+};
+
+/** Prints the header and the message. */
+static void log_vprint(const char *file, int line, const char *text, va_list ap) {
+    /* Prints the filename (not the full path) and line number. */
+    fmt_printf("%s:%d ", strrchr(file, '/') ? strrchr(file, '/')+1 : file, line);
+    fmt_vprintf(text, ap);
+    fmt_printf("\r\n");
+}
+
+/** Logs an event of the aversive modules.
+ *
+ * This function is never called directly, but instead, the error
+ * modules fills an error structure and calls it.
+ * @param [in] e The error structure, filled with every needed info.
+ */
+static void log_error_handler(struct error *e, ...) {
+    va_list ap;
+
+    if(!(log_mask[LOG_INDEX(e->err_num)] & (1 << e->severity)))
+        return;
+
+    va_start(ap, e);
+    log_vprint(e->file, e->line, e->text, ap);
+    va_end(ap);
+}
+
+void log_init(void) {
+    int i;
+
+    for(i=0;i<LOG_NB_MODULES;i++)
+        log_set_level(i, ERROR_SEVERITY_NOTICE);
+
+    error_register_emerg(log_error_handler);
+    error_register_error(log_error_handler);
+    error_register_warning(log_error_handler);
+    error_register_notice(log_error_handler);
+    error_register_debug(log_error_handler);
+}
+
+void log_set_level(log_module_t module, int level) {
+    if(level > log_compiled_level[module])
+        level = log_compiled_level[module];
+    log_mask[module] = (1 << (level + 1)) - 1;
+}
+
+int log_get_level(log_module_t module) {
+    int level = -1;
+    while(level < ERROR_SEVERITY_DEBUG && (log_mask[module] & (1 << (level + 1))))
+        level++;
+    return level;
+}
+
+const char *log_module_name(log_module_t module) {
+    return log_module_names[module];
+}
+
+void log_message(uint8_t num, uint8_t severity, const char *file, int line, const char *text, ...) {
+    va_list ap;
+    (void)num;
+    (void)severity;
+
+    va_start(ap, text);
+    log_vprint(file, line, text, ap);
+    va_end(ap);
+}
@@ -0,0 +1,113 @@
+/** @file log.h
+ * @brief Per module log levels.
+ *
+ * The LEMERG, LERROR, LWARNING, LNOTICE and LDEBUG macros replace the ones of
+ * the aversive error module for the code of the robot. A message is printed
+ * if its severity is enabled for its module (see error_numbers.h) :
+ *  - At compile time, by LOG_LEVEL_<MODULE> (LOG_LEVEL_DEFAULT if not
+ *    defined). The messages above it compile to nothing, and their arguments
+ *    are never evaluated.
+ *  - At run time, by one bit of log_mask, tested before the arguments are
+ *    evaluated. The `log` command changes it.
+ *
+ * The messages of the aversive modules go through the error module and are
+ * only filtered at run time, under LOG_MODULE_OTHER.
+ */
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <aversive.h>
+#include <aversive/error.h>
+#include "error_numbers.h"
+
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT ERROR_SEVERITY_NOTICE
+#endif
+
+#ifndef LOG_LEVEL_ARM
+#define LOG_LEVEL_ARM LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_CS
+#define LOG_LEVEL_CS LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_AVOIDING
+#define LOG_LEVEL_AVOIDING LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_SCANNER
+#define LOG_LEVEL_SCANNER LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_DRIVERS
+#define LOG_LEVEL_DRIVERS LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_COMM
+#define LOG_LEVEL_COMM LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_MISC
+#define LOG_LEVEL_MISC LOG_LEVEL_DEFAULT
+#endif
+
+/** Dense index of the modules in log_mask. */
+typedef enum {
+    LOG_MODULE_ARM=0,
+    LOG_MODULE_CS,
+    LOG_MODULE_AVOIDING,
+    LOG_MODULE_SCANNER,
+    LOG_MODULE_DRIVERS,
+    LOG_MODULE_COMM,
+    LOG_MODULE_MISC,
+    LOG_MODULE_OTHER,   /**< Aversive modules and unknown numbers. */
+    LOG_NB_MODULES
+} log_module_t;
+
+/** Index of an error number, folded by the compiler when num is constant. */
+#define LOG_INDEX(num) \
+    ((num) == ERROR_ARM ? LOG_MODULE_ARM : \
+     (num) == ERROR_CS ? LOG_MODULE_CS : \
+     (num) == ERROR_AVOIDING ? LOG_MODULE_AVOIDING : \
+     (num) == ERROR_SCANNER ? LOG_MODULE_SCANNER : \
+     (num) == ERROR_DRIVERS ? LOG_MODULE_DRIVERS : \
+     (num) == ERROR_COMM ? LOG_MODULE_COMM : \
+     (num) == ERROR_MISC ? LOG_MODULE_MISC : LOG_MODULE_OTHER)
+
+/** Compile time level of an error number. */
+#define LOG_LEVEL(num) \
+    ((num) == ERROR_ARM ? LOG_LEVEL_ARM : \
+     (num) == ERROR_CS ? LOG_LEVEL_CS : \
+     (num) == ERROR_AVOIDING ? LOG_LEVEL_AVOIDING : \
+     (num) == ERROR_SCANNER ? LOG_LEVEL_SCANNER : \
+     (num) == ERROR_DRIVERS ? LOG_LEVEL_DRIVERS : \
+     (num) == ERROR_COMM ? LOG_LEVEL_COMM : \
+     (num) == ERROR_MISC ? LOG_LEVEL_MISC : ERROR_SEVERITY_DEBUG)
+
+/** Run time mask, bit n of log_mask[i] enables the severity n of module i. */
+extern uint8_t log_mask[LOG_NB_MODULES];
+
+#define LOG(num, severity, text, ...) do { \
+    if((severity) <= LOG_LEVEL(num) && (log_mask[LOG_INDEX(num)] & (1 << (severity)))) \
+        log_message((num), (severity), __FILE__, __LINE__, text, ##__VA_ARGS__); \
+} while(0)
+
+#define LEMERG(num, text, ...)   LOG(num, ERROR_SEVERITY_EMERG, text, ##__VA_ARGS__)
+#define LERROR(num, text, ...)   LOG(num, ERROR_SEVERITY_ERROR, text, ##__VA_ARGS__)
+#define LWARNING(num, text, ...) LOG(num, ERROR_SEVERITY_WARNING, text, ##__VA_ARGS__)
+#define LNOTICE(num, text, ...)  LOG(num, ERROR_SEVERITY_NOTICE, text, ##__VA_ARGS__)
+#define LDEBUG(num, text, ...)   LOG(num, ERROR_SEVERITY_DEBUG, text, ##__VA_ARGS__)
+
+/** Enables the compiled levels up to ERROR_SEVERITY_NOTICE and registers
+ * the output of the aversive error module. */
+void log_init(void);
+
+/** Enables the severities up to level (-1 for none) of a module. */
+void log_set_level(log_module_t module, int level);
+
+/** Gets the highest enabled severity of a module, -1 if none. */
+int log_get_level(log_module_t module);
+
+/** Name of a module, used by the `log` command. */
+const char *log_module_name(log_module_t module);
+
+/** Prints a message, use the macros instead. */
+void log_message(uint8_t num, uint8_t severity, const char *file, int line, const char *text, ...)
+    __attribute__((format(printf, 5, 6)));
+
+#endif
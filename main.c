@@ -13,12 +13,13 @@
 #include <scheduler.h>
 #include <fast_math.h>
 #include <stdio.h>
-#include <stdarg.h>
 #include <uptime.h>
 #include <string.h>
 #include <commandline.h>
+#include <unistd.h>
 
 #ifdef COMPILE_ON_ROBOT
+#include <fcntl.h>
 #include <cvra_beacon.h>
 #endif
 
@@ -28,27 +29,16 @@
 #include <nios2.h>
 #endif
 
+#include "fmt.h"
 #include "hardware.h"
 #include "cvra_cs.h"
+#include "strat.h"
+#include "boot.h"
+#include "memcheck.h"
+#include "trace.h"
+#include "busstat.h"
+#include "log.h"
 
-/** Logs an event.
- *
- * This function is never called directly, but instead, the error
- * modules fills an error structure and calls it.
- * @param [in] e The error structure, filled with every needed info.
- */
-void mylog(struct error * e, ...) {
-    va_list ap;
-    va_start(ap, e);    
-    /* Prints the filename (not the full path) and line number. */
-    printf("%s:%d ", strrchr(e->file, '/') ? strrchr(e->file, '/')+1:e->file, e->line);
-    vprintf(e->text, ap);
-    printf("\r\n");
-    va_end(ap);
-}
-/** Cette variable contient le temps maximum passe dans une boucle du scheduler.
- * Elle donne donc une assez bonne indication de l'occupation du CPU. */
-int32_t longest_scheduler_interrupt_time=0;
 
 extern command_t commands_list[];
 
@@ -64,25 +54,51 @@ void main_timer_interrupt(__attribute__((unused)) void *param) {
 
     /* Chenillard sur les LEDs */
     i++;
-    IOWR(LED_BASE, 0, i/100);
+    BUS_IOWR(BUS_MISC, LED_BASE, 0, i/100);
     if(i==0xfe*100)
         i=0;
 
     /* Reset le timer. */
-    IOWR(TICK_BASE, 0, 0x00); 
+    BUS_IOWR(BUS_MISC, TICK_BASE, 0, 0x00); 
 
     /* Execute les taches programmees en mesurant le temps mis. */
     time = uptime_get(); 
+    TRACE_BEGIN(TRACE_SCHEDULER);
+    fmt_interrupt_enter();
     scheduler_interrupt();
+    fmt_interrupt_exit();
+    TRACE_END(TRACE_SCHEDULER);
     time = uptime_get() - time;
 
     /* Si le temps est plus grand que le maximum, on le garde en memoire. */
-    if(time > longest_scheduler_interrupt_time) {
-     longest_scheduler_interrupt_time = time;
+    if(time > default_context.longest_scheduler_interrupt_time) {
+     default_context.longest_scheduler_interrupt_time = time;
     }
 }
 #endif
 
+/** Un octet qui n'appartient pas a une requete RPC commencee.
+ * @param rpc =0 pour les octets rendus par le decodeur RPC : ils ne peuvent
+ * pas y retourner. */
+static void main_input_char(uint8_t c, int rpc) {
+    int used, rejected;
+
+    used = teleop_input_char(&robot.teleop, c);
+
+    /* Octets d'une trame de teleoperation abandonnee : c'etait du texte. */
+    while((rejected = teleop_get_rejected(&robot.teleop)) >= 0)
+        commandline_input_char(rejected);
+
+    if(!used && rpc)
+        used = rpc_input_char(&robot.rpc, c);
+
+    if(!used) {
+        TRACE_BEGIN(TRACE_COMMAND);
+        commandline_input_char(c);
+        TRACE_END(TRACE_COMMAND);
+    }
+}
+
 /** @brief Demarre le robot
  *
  * Cette fonction est la premiere executee par notre code. Elle est responsable
@@ -95,20 +111,21 @@ void main_timer_interrupt(__attribute__((unused)) void *param) {
  */ 
 int main(__attribute__((unused)) int argc, __attribute__((unused)) char **argv) {
 
-    robot.verbosity_level = ERROR_SEVERITY_NOTICE;
-    
+    boot_mark(BOOT_START);
+
+    /* Step 0 : Peint la pile pour pouvoir mesurer sa profondeur maximale. */
+    memcheck_paint_stacks();
+
     /* Step 1 : Setup UART speed. Doit etre en premier car necessaire pour le log. */
     //cvra_set_uart_speed(COMPC_BASE, 57600);
     //
-    error_register_emerg(mylog);
-    error_register_error(mylog);
-    error_register_warning(mylog);
-    error_register_notice(mylog);
-    //error_register_debug(mylog);
+    log_init();
+    boot_mark(BOOT_LOG);
 
     /* Step 2 : Init de la librairie math de Mathieu. */
     /**FIXME @todo Est-ce qu'on a encore besoin de fast_math_init() dans la version finale ? */
     fast_math_init();
+    boot_mark(BOOT_FAST_MATH);
 
     /* Step 3 : Demarre le scheduler pour le multitache. */
     scheduler_init(); 
@@ -118,23 +135,71 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **argv)
     /* Step 3 (suite) : Si on est sur le robot on inscrit le tick dans la table des interrupts. */
     alt_ic_isr_register(0, TICK_IRQ, main_timer_interrupt, NULL, 0);
 #endif
+    /* Les sorties texte sont envoyees par la boucle de premier plan. */
+    fmt_init();
+    boot_mark(BOOT_SCHEDULER);
 
     /* Step 4 : Init les IO. 
      * Init de l'ADC et planification des updates des capteurs */
-    //cvra_board_init(); /** @todo : c'est bien le bon harware.c qui est appelé */
+    cvra_board_init();
     
     /* Step 5 : Init la regulation et l'odometrie (+ planification). */
-    cvra_cs_init();
+    cvra_cs_init(&default_context);
+    boot_mark(BOOT_CS);
+
+    /* Step 5 (suite) : Si on a ete reset en plein match (brownout), on
+     * reprend le match directement a partir de l'etat sauve en RAM. */
+    if(boot_hot_available(&default_context)) {
+        boot_hot_restore(&default_context);
+        boot_mark(BOOT_HOT_RESTART);
+        strat_resume(&default_context);
+    }
+    else {
+        boot_mark(BOOT_HOT_RESTART);
+    }
 
     /* Step 6 : Demarre la comm avec le PC, pas de retour de cette fonction. */
     commandline_init(commands_list);
+    boot_mark(BOOT_READY);
     
 #ifdef COMPILE_ON_ROBOT
     //cvra_beacon_init(&robot.beacon, AVOIDING_BASE, AVOIDING_IRQ);
-    IOWR(AVOIDING_BASE, 3, 127);
+    BUS_IOWR(BUS_BEACON, AVOIDING_BASE, 3, 127);
 #endif
     
-    for(;;) commandline_input_char(getchar());
+#ifdef COMPILE_ON_ROBOT
+    /* stdin non bloquant : la boucle vide la sortie en attendant les
+     * caracteres. stdout reste bloquant. */
+    fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
+#endif
+
+    /* Les trames binaires de teleoperation et de RPC sont multiplexees avec
+     * le shell. Une trame commencee garde tous ses octets, meme ceux qui
+     * ressemblent au debut de l'autre : un octet de depart n'ouvre une
+     * trame que si les deux decodeurs attendent. Une trame trop lente ou
+     * fausse rend ses octets. */
+    for(;;) {
+        uint8_t ch;
+        int c, used, rejected;
+
+        fmt_drain();
+        if(read(STDIN_FILENO, &ch, 1) != 1)
+            continue;
+        c = ch;
+
+        if(robot.rpc.frame_pos == 0) {
+            main_input_char(c, 1);
+            continue;
+        }
+
+        /* Une requete abandonnee rend ses octets au shell et a la
+         * teleoperation, avant l'octet courant. */
+        used = rpc_input_char(&robot.rpc, (uint8_t)c);
+        while((rejected = rpc_get_rejected(&robot.rpc)) >= 0)
+            main_input_char(rejected, 0);
+        if(!used)
+            main_input_char(c, 1);
+    }
         
     return 0;
 }
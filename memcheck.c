@@ -0,0 +1,136 @@
+/** @file memcheck.c
+ * @brief Stack high-watermarks and static RAM usage.
+ * @sa memcheck.h
+ */
+
+#include <aversive.h>
+#include <unistd.h>
+#include <scheduler.h>
+#include <scheduler_private.h>
+
+#include "fmt.h"
+#include "memcheck.h"
+#include "cvra_cs.h"
+#include "strat.h"
+#include "boot.h"
+
+#ifdef COMPILE_ON_ROBOT
+/* Symbols defined by the Nios II HAL linker script. */
+extern char __alt_stack_pointer[];
+extern char __bss_start[];
+extern char __bss_end[];
+#ifdef ALT_EXCEPTION_STACK
+extern char __alt_exception_stack_pointer[];
+extern char __alt_exception_stack_limit[];
+#endif
+#endif
+
+/** Bounds of the painted part of the main stack. */
+static uint32_t *main_stack_bottom;
+static uint32_t *main_stack_top;
+
+/** Paints [bottom, top[ with the pattern. */
+static void memcheck_paint(uint32_t *bottom, uint32_t *top) {
+    while(bottom < top)
+        *bottom++ = MEMCHECK_PAINT_PATTERN;
+}
+
+#ifdef COMPILE_ON_ROBOT
+/** Returns the first word above the current end of the heap. */
+static uint32_t *memcheck_heap_end(void) {
+    return (uint32_t *)(((uint32_t)sbrk(0) + 3) & ~3);
+}
+#endif
+
+/** Returns the number of bytes overwritten in a painted stack. */
+static int32_t memcheck_used(uint32_t *bottom, uint32_t *top) {
+    uint32_t *p = bottom;
+
+    /* Stacks grow downward, the first modified word from the bottom is the
+     * deepest point reached. */
+    while(p < top && *p == MEMCHECK_PAINT_PATTERN)
+        p++;
+
+    return (top - p) * sizeof(uint32_t);
+}
+
+void memcheck_paint_stacks(void) {
+#ifdef COMPILE_ON_ROBOT
+    uint32_t here;
+
+    /* The stack grows down toward the heap : paint from a bit above the
+     * current end of the heap up to just below our own frame. */
+    main_stack_bottom = memcheck_heap_end() + MEMCHECK_HEAP_MARGIN / sizeof(uint32_t);
+    main_stack_top = (uint32_t *)(((uint32_t)&here - MEMCHECK_PAINT_MARGIN) & ~3);
+    memcheck_paint(main_stack_bottom, main_stack_top);
+
+#ifdef ALT_EXCEPTION_STACK
+    memcheck_paint((uint32_t *)__alt_exception_stack_limit,
+                   (uint32_t *)__alt_exception_stack_pointer);
+#endif
+#endif
+}
+
+int32_t memcheck_main_stack_used(void) {
+    uint32_t *bottom = main_stack_bottom;
+
+    if(bottom == NULL)
+        return -1;
+
+#ifdef COMPILE_ON_ROBOT
+    /* Le heap a pu depasser la marge : ce qu'il a ecrit n'est pas la pile. */
+    if(memcheck_heap_end() > bottom)
+        bottom = memcheck_heap_end();
+    if(bottom > main_stack_top)
+        bottom = main_stack_top;
+#endif
+
+    return memcheck_used(bottom, main_stack_top) + MEMCHECK_PAINT_MARGIN;
+}
+
+int32_t memcheck_main_stack_size(void) {
+    if(main_stack_bottom == NULL)
+        return 0;
+
+    return (main_stack_top - main_stack_bottom) * sizeof(uint32_t) + MEMCHECK_PAINT_MARGIN;
+}
+
+int32_t memcheck_irq_stack_used(void) {
+#if defined(COMPILE_ON_ROBOT) && defined(ALT_EXCEPTION_STACK)
+    return memcheck_used((uint32_t *)__alt_exception_stack_limit,
+                         (uint32_t *)__alt_exception_stack_pointer);
+#else
+    return -1;
+#endif
+}
+
+void memcheck_print_report(void) {
+    int32_t used;
+
+    fmt_printf("==Stacks==\n");
+    used = memcheck_main_stack_used();
+    if(used < 0)
+        fmt_printf("main: not painted\n");
+    else
+        fmt_printf("main: %d / %d bytes\n", (int)used, (int)memcheck_main_stack_size());
+
+    used = memcheck_irq_stack_used();
+    if(used < 0)
+        fmt_printf("irq: shared with main\n");
+    else
+        fmt_printf("irq: %d bytes\n", (int)used);
+
+    fmt_printf("==Static RAM==\n");
+    fmt_printf("robot     %6u\n", (unsigned int)sizeof(robot));
+    fmt_printf(" teleop   %6u\n", (unsigned int)sizeof(robot.teleop));
+    fmt_printf(" follower %6u\n", (unsigned int)sizeof(robot.follower));
+    fmt_printf(" traj     %6u\n", (unsigned int)sizeof(robot.traj));
+    fmt_printf("strat     %6u\n", (unsigned int)sizeof(strat));
+    fmt_printf(" opening  %6u\n", (unsigned int)sizeof(strat.opening));
+    fmt_printf(" costs    %6u\n", (unsigned int)sizeof(strat.travel_cost));
+    fmt_printf("scheduler %6u\n", (unsigned int)sizeof(g_tab_event));
+    fmt_printf("boot      %6u\n", (unsigned int)sizeof(struct boot_hot_state));
+#ifdef COMPILE_ON_ROBOT
+    fmt_printf("bss total %6u\n", (unsigned int)(__bss_end - __bss_start));
+#endif
+}
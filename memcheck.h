@@ -0,0 +1,46 @@
+/** @file memcheck.h
+ * @brief Stack high-watermarks and static RAM usage.
+ *
+ * The on-chip RAM of the Nios is small, and a deep call chain (recursive
+ * strategy, printf) can silently run the stack into the heap. At boot the
+ * free part of the stacks is painted with a known pattern. The deepest point
+ * reached by a stack is then the lowest word that was overwritten.
+ */
+#ifndef _MEMCHECK_H_
+#define _MEMCHECK_H_
+
+#include <aversive.h>
+
+/** Pattern written in the unused part of the stacks. */
+#define MEMCHECK_PAINT_PATTERN 0xdeadbeef
+
+/** Bytes kept unpainted below the current stack pointer when painting. */
+#define MEMCHECK_PAINT_MARGIN 256
+
+/** Bytes kept unpainted above the end of the heap when painting, for the
+ * malloc()s after boot (stdio buffers, ...). */
+#define MEMCHECK_HEAP_MARGIN 4096
+
+/** Paints the unused part of the stacks.
+ *
+ * @note Must be called as early as possible in main(), before the heap is
+ * used and before interrupts are enabled.
+ */
+void memcheck_paint_stacks(void);
+
+/** Returns the maximum number of bytes used in the main stack, or -1 if
+ * the stack was not painted. The words the heap grew over since the painting
+ * are not counted. */
+int32_t memcheck_main_stack_used(void);
+
+/** Returns the size of the painted part of the main stack, in bytes. */
+int32_t memcheck_main_stack_size(void);
+
+/** Returns the maximum number of bytes used in the exception stack, or -1
+ * if there is no separate exception stack. */
+int32_t memcheck_irq_stack_used(void);
+
+/** Prints the stack watermarks and the RAM used by each module. */
+void memcheck_print_report(void);
+
+#endif
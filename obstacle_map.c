@@ -0,0 +1,213 @@
+/** @file obstacle_map.c
+ * @brief Obstacles around the robot, fused from all the sensors.
+ * @sa obstacle_map.h
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+#include <uptime.h>
+#include <holonomic/position_manager.h>
+
+#include "cvra_cs.h"
+#include "hardware.h"
+#include "com_balises.h"
+#include "team_sync.h"
+#include "obstacle_map.h"
+
+void obstacle_map_init(struct obstacle_map *m, struct robot_context *ctx) {
+    memset(m, 0, sizeof(struct obstacle_map));
+    m->ctx = ctx;
+    m->min_x = m->min_y = HUGE_VAL;
+    m->max_x = m->max_y = -HUGE_VAL;
+#ifdef COMPILE_ON_ROBOT
+    m->sensors_enabled = 1;
+#endif
+}
+
+static void obstacle_see(struct obstacle *o, double x, double y, double radius, int32_t now) {
+    o->x = x;
+    o->y = y;
+    o->radius = radius;
+    o->seen = now;
+    o->valid = 1;
+}
+
+/** A proximity hit : merged into a track next to it, or an obstacle of its own. */
+static void obstacle_map_hit(struct obstacle_map *m, obstacle_source_t source,
+                             double x, double y, double a, double mount_angle, int32_t now) {
+    double dir = a + mount_angle;
+    double far = OBSTACLE_SENSOR_MOUNT + OBSTACLE_SENSOR_RANGE;
+    double fx = x + far * cos(dir), fy = y + far * sin(dir);
+    double hx, hy;
+    struct obstacle *o;
+    int i;
+
+    /* Le capteur dit seulement qu'il y a quelque chose avant la fin de sa
+     * portee : au pire juste devant lui. Plus loin, la detection resterait
+     * toujours hors de la distance d'arret de l'evitement. */
+    hx = x + OBSTACLE_SENSOR_MOUNT * cos(dir);
+    hy = y + OBSTACLE_SENSOR_MOUNT * sin(dir);
+
+    /* Les capteurs voient aussi les bordures : comme dans clearance.c,
+     * elles ne sont pas des obstacles, sinon la poussee finale d'un cadeau
+     * s'arreterait devant. La bordure peut etre n'importe ou dans la
+     * portee, on teste son bout. */
+    if(fx < OBSTACLE_BORDER_MARGIN || fx > TABLE_X_MM - OBSTACLE_BORDER_MARGIN ||
+       fy < OBSTACLE_BORDER_MARGIN || fy > TABLE_Y_MM - OBSTACLE_BORDER_MARGIN) {
+        m->border_hits++;
+        return;
+    }
+
+    for(i=OBSTACLE_OPPONENT1;i<=OBSTACLE_TEAMMATE;i++) {
+        o = &m->o[i];
+        if(!o->valid || hypot(o->x - hx, o->y - hy) - o->radius > OBSTACLE_FUSION_GATE)
+            continue;
+
+        /* Le coequipier sait ou il est, les balises moins bien de pres :
+         * on met le bord de l'adversaire sur la detection. */
+        if(i != OBSTACLE_TEAMMATE) {
+            o->x = hx + o->radius * cos(dir);
+            o->y = hy + o->radius * sin(dir);
+        }
+        o->seen = now;
+        m->o[source].valid = 0;
+        m->fusions++;
+        return;
+    }
+
+    obstacle_see(&m->o[source], hx, hy, 0., now);
+}
+
+void obstacle_map_update(struct obstacle_map *m) {
+    struct beacon_com *b = m->ctx->beacon_com;
+    struct holonomic_robot_position *pos = &m->ctx->robot->pos;
+    struct team_sync *team = &m->ctx->robot->team;
+    const struct team_state *peer = team_sync_peer(team);
+    int32_t now = uptime_get();
+    struct obstacle *o;
+    int i, left, right;
+
+    /* Seule une nouvelle trame rafraichit les pistes : les positions restent
+     * dans beacon_com quand la balise se tait, et elles ecraseraient la
+     * piste tiree sur une detection de proximite. Une balise qui ne voit
+     * rien donne (0, 0). */
+    if(b->frames != m->beacon_frames) {
+        m->beacon_frames = b->frames;
+        if(b->pos1X || b->pos1Y)
+            obstacle_see(&m->o[OBSTACLE_OPPONENT1], b->pos1X, b->pos1Y, OBSTACLE_ROBOT_RADIUS, now);
+        if(b->pos2X || b->pos2Y)
+            obstacle_see(&m->o[OBSTACLE_OPPONENT2], b->pos2X, b->pos2Y, OBSTACLE_ROBOT_RADIUS, now);
+    }
+    if(peer && team->peer_seq != m->peer_seq) {
+        m->peer_seq = team->peer_seq;
+        obstacle_see(&m->o[OBSTACLE_TEAMMATE], peer->f[TEAM_X], peer->f[TEAM_Y],
+                     OBSTACLE_ROBOT_RADIUS, now);
+    }
+
+    if(m->sensors_enabled) {
+        double x = holonomic_position_get_x_double(pos);
+        double y = holonomic_position_get_y_double(pos);
+        double a = holonomic_position_get_a_rad_double(pos);
+
+        cvra_get_avoiding_sensors(&left, &right);
+        if(left < OBSTACLE_SENSOR_THRESHOLD)
+            obstacle_map_hit(m, OBSTACLE_SENSOR_LEFT, x, y, a, OBSTACLE_SENSOR_LEFT_A, now);
+        if(right < OBSTACLE_SENSOR_THRESHOLD)
+            obstacle_map_hit(m, OBSTACLE_SENSOR_RIGHT, x, y, a, OBSTACLE_SENSOR_RIGHT_A, now);
+    }
+
+    m->min_x = m->min_y = HUGE_VAL;
+    m->max_x = m->max_y = -HUGE_VAL;
+    m->count = 0;
+
+    for(i=0;i<OBSTACLE_MAP_SIZE;i++) {
+        o = &m->o[i];
+        if(!o->valid)
+            continue;
+
+        if(now - o->seen > (i < OBSTACLE_SENSOR_LEFT ? OBSTACLE_DECAY_TRACK : OBSTACLE_DECAY_SENSOR)) {
+            o->valid = 0;
+            continue;
+        }
+
+        if(o->x - o->radius < m->min_x) m->min_x = o->x - o->radius;
+        if(o->x + o->radius > m->max_x) m->max_x = o->x + o->radius;
+        if(o->y - o->radius < m->min_y) m->min_y = o->y - o->radius;
+        if(o->y + o->radius > m->max_y) m->max_y = o->y + o->radius;
+        m->count++;
+    }
+}
+
+/** Distance from (x, y) to the bounding box, 0 inside. */
+static double obstacle_map_box(struct obstacle_map *m, double x, double y) {
+    double dx = 0, dy = 0;
+
+    if(x < m->min_x) dx = m->min_x - x;
+    if(x > m->max_x) dx = x - m->max_x;
+    if(y < m->min_y) dy = m->min_y - y;
+    if(y > m->max_y) dy = y - m->max_y;
+
+    return hypot(dx, dy);
+}
+
+double obstacle_map_nearest(struct obstacle_map *m, double x, double y,
+                            double heading, double cone, double limit) {
+    struct obstacle *o;
+    double d, angle;
+    int i;
+
+    if(m->count == 0 || obstacle_map_box(m, x, y) >= limit)
+        return limit;
+
+    for(i=0;i<OBSTACLE_MAP_SIZE;i++) {
+        o = &m->o[i];
+        if(!o->valid)
+            continue;
+
+        if(cone < M_PI) {
+            angle = atan2(o->y - y, o->x - x) - heading;
+            if(fabs(atan2(sin(angle), cos(angle))) > cone)
+                continue;
+        }
+
+        d = hypot(o->x - x, o->y - y) - o->radius;
+        if(d < limit)
+            limit = d < 0 ? 0 : d;
+    }
+
+    return limit;
+}
+
+double obstacle_map_segment(struct obstacle_map *m, double x1, double y1,
+                            double x2, double y2, double limit) {
+    struct obstacle *o;
+    double dx = x2 - x1, dy = y2 - y1;
+    double len2 = dx * dx + dy * dy;
+    double t, d;
+    int i;
+
+    if(m->count == 0)
+        return limit;
+
+    /* The box of the segment, grown by limit, must touch the obstacles. */
+    if((x1 < x2 ? x1 : x2) - limit > m->max_x || (x1 > x2 ? x1 : x2) + limit < m->min_x ||
+       (y1 < y2 ? y1 : y2) - limit > m->max_y || (y1 > y2 ? y1 : y2) + limit < m->min_y)
+        return limit;
+
+    for(i=0;i<OBSTACLE_MAP_SIZE;i++) {
+        o = &m->o[i];
+        if(!o->valid)
+            continue;
+
+        t = len2 > 1e-6 ? ((o->x - x1) * dx + (o->y - y1) * dy) / len2 : 0.;
+        if(t < 0.) t = 0.;
+        if(t > 1.) t = 1.;
+
+        d = hypot(x1 + t * dx - o->x, y1 + t * dy - o->y) - o->radius;
+        if(d < limit)
+            limit = d < 0 ? 0 : d;
+    }
+
+    return limit;
+}
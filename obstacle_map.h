@@ -0,0 +1,113 @@
+/** @file obstacle_map.h
+ * @brief Obstacles around the robot, fused from all the sensors.
+ *
+ * A handful of obstacles, updated at the control rate from two sources :
+ *  - long range : the opponents tracked by the beacon and the teammate
+ *    (see team_sync.h), robots of OBSTACLE_ROBOT_RADIUS ;
+ *  - short range : the proximity sensors on ADC_OBSTACLE_LEFT and
+ *    ADC_OBSTACLE_RIGHT, which only tell that something is closer than
+ *    OBSTACLE_SENSOR_RANGE in their direction.
+ *
+ * A proximity hit is placed at the near end of the range, in front of the
+ * sensor (OBSTACLE_SENSOR_MOUNT from the center) : the object may be that
+ * close, and it must stop the robot. A hit next to a tracked robot is the
+ * same robot : the track is pulled so that its edge is on the hit, and kept
+ * alive even if the beacon lost it (it often does at short range). A hit
+ * far from any track is an obstacle of its own, a point, unless the range
+ * reaches a border of the table.
+ *
+ * A track is only refreshed by a new beacon frame or teammate state, and
+ * every obstacle fades out OBSTACLE_DECAY_* after it was last seen, so a
+ * source gone silent is forgotten and a flickering one does not make the
+ * obstacles blink.
+ *
+ * The obstacles are kept in the table frame, so they do not move with us ;
+ * the queries give distances from any pose, usually ours. The bounding box
+ * of all the obstacles is kept up to date, so a query with nothing around
+ * returns after a single test.
+ */
+#ifndef _OBSTACLE_MAP_H_
+#define _OBSTACLE_MAP_H_
+
+#include <aversive.h>
+
+/** Two opponents, the teammate and a hit of each proximity sensor. */
+#define OBSTACLE_MAP_SIZE 5
+
+#define OBSTACLE_ROBOT_RADIUS     200.     /**< mm, the other robots. */
+
+/** Time an obstacle is kept after it was last seen, in us. */
+#define OBSTACLE_DECAY_TRACK      500000
+#define OBSTACLE_DECAY_SENSOR     300000
+
+/** A proximity hit closer than this to a track belongs to it, in mm. */
+#define OBSTACLE_FUSION_GATE      300.
+
+/** Proximity sensors : threshold on the 10 bits value, position on the robot. */
+#define OBSTACLE_SENSOR_THRESHOLD 500      /**< Detection below. */
+#define OBSTACLE_SENSOR_RANGE     200.     /**< mm, from the mount. */
+#define OBSTACLE_SENSOR_MOUNT     100.     /**< mm, from the center. */
+#define OBSTACLE_SENSOR_LEFT_A    (30. * M_PI / 180.)  /**< rad, robot frame. */
+#define OBSTACLE_SENSOR_RIGHT_A   (-30. * M_PI / 180.) /**< rad, robot frame. */
+
+/** Proximity hits closer than this to a border are the border, in mm. */
+#define OBSTACLE_BORDER_MARGIN    100.
+
+typedef enum {
+    OBSTACLE_OPPONENT1 = 0,
+    OBSTACLE_OPPONENT2,
+    OBSTACLE_TEAMMATE,
+    OBSTACLE_SENSOR_LEFT,
+    OBSTACLE_SENSOR_RIGHT,
+} obstacle_source_t;
+
+struct obstacle {
+    double x, y;                   /**< Center, in mm, table. */
+    double radius;                 /**< mm, 0 for a proximity hit. */
+    int32_t seen;                  /**< Last time it was seen, in us. */
+    uint8_t valid;
+};
+
+struct robot_context;
+
+struct obstacle_map {
+    struct robot_context *ctx;
+    struct obstacle o[OBSTACLE_MAP_SIZE];
+
+    /** Bounding box of the valid obstacles, edges included. Empty if
+     * min_x > max_x. */
+    double min_x, max_x, min_y, max_y;
+    uint8_t count;
+
+    uint32_t beacon_frames;        /**< Last beacon frame read, see beacon_com.frames. */
+    uint8_t peer_seq;              /**< Last teammate state read, see team_sync.peer_seq. */
+
+    uint8_t sensors_enabled;       /**< =0 to ignore the proximity sensors. */
+    uint32_t fusions;              /**< Proximity hits merged into a track. */
+    uint32_t border_hits;          /**< Proximity hits dropped on a border. */
+};
+
+/** Inits an empty map, the proximity sensors enabled on the robot only. */
+void obstacle_map_init(struct obstacle_map *m, struct robot_context *ctx);
+
+/** Reads all the sources and forgets the old obstacles.
+ * @note Called at each control tick. */
+void obstacle_map_update(struct obstacle_map *m);
+
+/** Distance from (x, y) to the edge of the nearest obstacle, in mm.
+ *
+ * @param [in] heading, cone Only the obstacles whose center is less than
+ * cone from the direction heading count, in rad. A cone of M_PI or more
+ * takes all of them.
+ * @param [in] limit The distances above this do not matter.
+ * @returns The distance, or limit if nothing is closer.
+ */
+double obstacle_map_nearest(struct obstacle_map *m, double x, double y,
+                            double heading, double cone, double limit);
+
+/** Distance from the segment [(x1, y1), (x2, y2)] to the edge of the nearest
+ * obstacle, in mm, or limit if nothing is closer. For the planning. */
+double obstacle_map_segment(struct obstacle_map *m, double x1, double y1,
+                            double x2, double y2, double limit);
+
+#endif
@@ -0,0 +1,310 @@
+/** @file orca.c
+ * @brief Reactive avoidance of the moving robots, with velocity obstacles.
+ * @sa orca.h
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+#include <uptime.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/position_manager.h>
+
+#include "cvra_cs.h"
+#include "com_balises.h"
+#include "team_sync.h"
+#include "orca.h"
+
+/** Tolerance on the constraints, in mm/s. */
+#define ORCA_EPSILON 1e-3
+
+/** An obstacle whose position did not change for this long is stopped, in us. */
+#define ORCA_STILL_TIME 1000000
+
+/** Allowed velocities : on the left of the line through p with direction d,
+ * det(d, v - p) >= 0, see orca_violation(). */
+struct orca_line {
+    double px, py;
+    double dx, dy;                 /**< Unit vector. */
+};
+
+static double det(double ax, double ay, double bx, double by) {
+    return ax * by - ay * bx;
+}
+
+void orca_init(struct orca *o, struct robot_context *ctx, double frequency) {
+    memset(o, 0, sizeof(struct orca));
+    o->ctx = ctx;
+    o->period = 1. / frequency;
+    o->horizon = ORCA_DEFAULT_HORIZON;
+    o->radius = ORCA_DEFAULT_RADIUS;
+    o->obstacle_radius = ORCA_DEFAULT_OBST_RADIUS;
+    o->margin = ORCA_DEFAULT_MARGIN;
+    o->enabled = 1;
+}
+
+void orca_enable(struct orca *o, int enabled) {
+    o->enabled = enabled;
+}
+
+/** Updates a track with a new position, estimating its velocity. */
+static void orca_track(struct orca_obstacle *ob, double x, double y, int reciprocal, int32_t now) {
+    double dt;
+
+    ob->reciprocal = reciprocal;
+
+    if(!ob->valid) {
+        ob->x = x;
+        ob->y = y;
+        ob->vx = ob->vy = 0;
+        ob->last_move = now;
+        ob->valid = 1;
+        return;
+    }
+
+    if(x == ob->x && y == ob->y) {
+        if(now - ob->last_move > ORCA_STILL_TIME)
+            ob->vx = ob->vy = 0;
+        return;
+    }
+
+    /* The positions come at the rate of the beacon, not at each tick. */
+    dt = (now - ob->last_move) / 1000000.;
+    if(dt > 0) {
+        double k = dt / (dt + ORCA_VELOCITY_FILTER);
+        ob->vx += k * ((x - ob->x) / dt - ob->vx);
+        ob->vy += k * ((y - ob->y) / dt - ob->vy);
+    }
+
+    ob->x = x;
+    ob->y = y;
+    ob->last_move = now;
+}
+
+static void orca_update_tracks(struct orca *o, int32_t now) {
+    struct beacon_com *b = o->ctx->beacon_com;
+    const struct team_state *peer = team_sync_peer(&o->ctx->robot->team);
+
+    /* Une balise qui ne voit rien donne (0, 0). */
+    if(b->pos1X || b->pos1Y)
+        orca_track(&o->obstacles[0], b->pos1X, b->pos1Y, 0, now);
+    else
+        o->obstacles[0].valid = 0;
+
+    if(b->pos2X || b->pos2Y)
+        orca_track(&o->obstacles[1], b->pos2X, b->pos2Y, 0, now);
+    else
+        o->obstacles[1].valid = 0;
+
+    if(peer)
+        orca_track(&o->obstacles[2], peer->f[TEAM_X], peer->f[TEAM_Y], 1, now);
+    else
+        o->obstacles[2].valid = 0;
+}
+
+/** Half-plane of the velocities which do not hit ob within the horizon. */
+static void orca_line_for(struct orca *o, const struct orca_obstacle *ob,
+                          double x, double y, struct orca_line *l) {
+    double rpx = ob->x - x, rpy = ob->y - y;
+    double rvx = o->vx - ob->vx, rvy = o->vy - ob->vy;
+    double dist2 = rpx * rpx + rpy * rpy;
+    double r = o->radius + o->obstacle_radius + o->margin;
+    double inv, wx, wy, wl, ux, uy;
+    double resp = ob->reciprocal ? 0.5 : 1.;
+
+    if(dist2 > r * r) {
+        inv = 1. / o->horizon;
+        wx = rvx - inv * rpx;
+        wy = rvy - inv * rpy;
+        double dot = wx * rpx + wy * rpy;
+
+        if(dot < 0 && dot * dot > r * r * (wx * wx + wy * wy)) {
+            /* Closest to the cut-off circle. */
+            wl = hypot(wx, wy);
+            l->dx = wy / wl;
+            l->dy = -wx / wl;
+            ux = (r * inv - wl) * wx / wl;
+            uy = (r * inv - wl) * wy / wl;
+        }
+        else {
+            /* Closest to one of the legs of the cone. */
+            double leg = sqrt(dist2 - r * r);
+            if(det(rpx, rpy, wx, wy) > 0) {
+                l->dx = (rpx * leg - rpy * r) / dist2;
+                l->dy = (rpx * r + rpy * leg) / dist2;
+            }
+            else {
+                l->dx = -(rpx * leg + rpy * r) / dist2;
+                l->dy = -(-rpx * r + rpy * leg) / dist2;
+            }
+            double d = rvx * l->dx + rvy * l->dy;
+            ux = d * l->dx - rvx;
+            uy = d * l->dy - rvy;
+        }
+    }
+    else {
+        /* Already in contact : get out within one period. */
+        inv = 1. / o->period;
+        wx = rvx - inv * rpx;
+        wy = rvy - inv * rpy;
+        wl = hypot(wx, wy);
+        if(wl < ORCA_EPSILON) {
+            wx = -rpx;
+            wy = -rpy;
+            wl = hypot(wx, wy) + ORCA_EPSILON;
+        }
+        l->dx = wy / wl;
+        l->dy = -wx / wl;
+        ux = (r * inv - wl) * wx / wl;
+        uy = (r * inv - wl) * wy / wl;
+    }
+
+    l->px = o->vx + resp * ux;
+    l->py = o->vy + resp * uy;
+}
+
+/** Largest violation of the constraints by (vx, vy), 0 if allowed. */
+static double orca_violation(const struct orca_line *lines, int n, double vmax,
+                             double vx, double vy) {
+    double worst = hypot(vx, vy) - vmax;
+    int i;
+
+    if(worst < 0)
+        worst = 0;
+
+    for(i=0;i<n;i++) {
+        double v = det(lines[i].dx, lines[i].dy, lines[i].px - vx, lines[i].py - vy);
+        if(v > worst)
+            worst = v;
+    }
+    return worst;
+}
+
+/** Best candidate so far : least violation, then closest to the asked velocity. */
+struct orca_best {
+    const struct orca_line *lines;
+    int n;
+    double vmax, dvx, dvy;
+    double vx, vy, violation, distance;
+};
+
+static void orca_try(struct orca_best *b, double vx, double vy) {
+    double violation = orca_violation(b->lines, b->n, b->vmax, vx, vy);
+    double distance = hypot(vx - b->dvx, vy - b->dvy);
+
+    if(violation < b->violation - ORCA_EPSILON ||
+       (violation < b->violation + ORCA_EPSILON && distance < b->distance)) {
+        b->vx = vx;
+        b->vy = vy;
+        b->violation = violation;
+        b->distance = distance;
+    }
+}
+
+/** Closest velocity to (dvx, dvy) in the half-planes and the speed circle. */
+static void orca_solve(struct orca_best *b) {
+    const struct orca_line *l = b->lines;
+    double norm = hypot(b->dvx, b->dvy);
+    int i, j;
+
+    b->violation = HUGE_VAL;
+    b->distance = HUGE_VAL;
+
+    orca_try(b, b->dvx, b->dvy);
+    orca_try(b, 0, 0);
+    if(norm > ORCA_EPSILON)
+        orca_try(b, b->dvx * b->vmax / norm, b->dvy * b->vmax / norm);
+
+    for(i=0;i<b->n;i++) {
+        /* Projection on the line. */
+        double t = (b->dvx - l[i].px) * l[i].dx + (b->dvy - l[i].py) * l[i].dy;
+        orca_try(b, l[i].px + t * l[i].dx, l[i].py + t * l[i].dy);
+
+        /* Intersections with the speed circle. */
+        double pd = l[i].px * l[i].dx + l[i].py * l[i].dy;
+        double disc = pd * pd - (l[i].px * l[i].px + l[i].py * l[i].py) + b->vmax * b->vmax;
+        if(disc >= 0) {
+            double s = sqrt(disc);
+            orca_try(b, l[i].px + (-pd - s) * l[i].dx, l[i].py + (-pd - s) * l[i].dy);
+            orca_try(b, l[i].px + (-pd + s) * l[i].dx, l[i].py + (-pd + s) * l[i].dy);
+        }
+
+        /* Intersections with the other lines. */
+        for(j=i+1;j<b->n;j++) {
+            double d = det(l[i].dx, l[i].dy, l[j].dx, l[j].dy);
+            if(fabs(d) < ORCA_EPSILON)
+                continue;
+            t = det(l[j].px - l[i].px, l[j].py - l[i].py, l[j].dx, l[j].dy) / d;
+            orca_try(b, l[i].px + t * l[i].dx, l[i].py + t * l[i].dy);
+        }
+    }
+}
+
+void orca_manage(struct orca *o) {
+    struct robot_system_holonomic *rs = &o->ctx->robot->rs;
+    struct holonomic_robot_position *pos = &o->ctx->robot->pos;
+    struct orca_line lines[ORCA_MAX_OBSTACLES];
+    struct orca_best best;
+    double x, y, a, speed, heading;
+    int32_t now = uptime_get();
+    int i, n = 0;
+
+    x = holonomic_position_get_x_double(pos);
+    y = holonomic_position_get_y_double(pos);
+    a = holonomic_position_get_a_rad_double(pos);
+
+    /* Nouvelle consigne depuis le dernier tick ? Sinon c'est encore la
+     * notre, et on repart de celle demandee (le trajectory manager ne
+     * tourne qu'a 10 Hz). */
+    if(rs->speed != o->out_speed || rs->direction != o->out_direction) {
+        o->desired_speed = rs->speed;
+        o->desired_heading = rs->direction + a;
+    }
+
+    orca_update_tracks(o, now);
+
+    best.dvx = o->desired_speed * cos(o->desired_heading);
+    best.dvy = o->desired_speed * sin(o->desired_heading);
+
+    if(!o->enabled || fabs(o->desired_speed) < 1.) {
+        /* On ne se met pas a bouger tout seul. */
+        speed = o->desired_speed;
+        heading = o->desired_heading;
+        o->vx = best.dvx;
+        o->vy = best.dvy;
+        o->active = 0;
+    }
+    else {
+        for(i=0;i<ORCA_MAX_OBSTACLES;i++)
+            if(o->obstacles[i].valid)
+                orca_line_for(o, &o->obstacles[i], x, y, &lines[n++]);
+
+        best.lines = lines;
+        best.n = n;
+        best.vmax = fabs(o->desired_speed);
+        orca_solve(&best);
+
+        o->vx = best.vx;
+        o->vy = best.vy;
+        o->active = best.distance > 1.;
+        if(o->active)
+            o->active_ticks++;
+
+        /* Sans solution, la moins mauvaise peut demander plus que la
+         * consigne : on reste a la vitesse demandee. */
+        speed = hypot(best.vx, best.vy);
+        if(speed > best.vmax)
+            speed = best.vmax;
+        heading = atan2(best.vy, best.vx);
+    }
+
+    if(speed < 0) {
+        speed = -speed;
+        heading += M_PI;
+    }
+
+    rsh_set_speed(rs, (int32_t)speed);
+    rsh_set_direction(rs, heading - a);
+    o->out_speed = rs->speed;
+    o->out_direction = rs->direction;
+}
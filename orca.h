@@ -0,0 +1,92 @@
+/** @file orca.h
+ * @brief Reactive avoidance of the moving robots, with velocity obstacles.
+ *
+ * Runs at every control tick, between the modules which set the robot
+ * velocity (path follower, trajectory manager, teleop) and rsh_update(). It
+ * takes the velocity they asked for and replaces it by the closest velocity
+ * which does not hit any of the tracked robots within ORCA_DEFAULT_HORIZON :
+ * the holonomic base slides around a moving opponent instead of stopping.
+ *
+ * Each robot around gives a half-plane of allowed velocities (optimal
+ * reciprocal collision avoidance, ORCA). The opponents do not avoid us, so
+ * we take the whole avoidance on us. The teammate runs the same code, each
+ * one takes half. The velocity is also limited to the asked speed : this
+ * layer can turn and slow down, never go faster.
+ *
+ * The robots come from the opponent positions of our beacon and from the
+ * pose of the teammate (see team_sync.h), at most ORCA_MAX_OBSTACLES. Their
+ * velocity is estimated from the successive positions.
+ *
+ * With so few half-planes the optimum is found by trying every candidate
+ * (the asked velocity, zero, the projections of the asked velocity on the
+ * speed circle and on the lines, the intersections of the lines with the
+ * circle and with each other) : at most 1 + 1 + 1 + 3 + 6 + 3 = 15
+ * candidates of 4 constraints, a bounded time at each tick. When no velocity satisfies all
+ * the half-planes, the one which violates them the least is taken.
+ */
+#ifndef _ORCA_H_
+#define _ORCA_H_
+
+#include <aversive.h>
+#include "cvra_param_robot.h"
+
+/** Opponents from the beacon, and the teammate. */
+#define ORCA_MAX_OBSTACLES 3
+
+#define ORCA_DEFAULT_HORIZON      1.5   /**< s */
+#define ORCA_DEFAULT_RADIUS       ROBOT_RADIUS_MM /**< mm, our robot. */
+#define ORCA_DEFAULT_OBST_RADIUS  200.  /**< mm, the others. */
+#define ORCA_DEFAULT_MARGIN       50.   /**< mm */
+
+/** Time constant of the velocity estimate of the obstacles, in s. */
+#define ORCA_VELOCITY_FILTER      0.3
+
+/** A tracked robot. */
+struct orca_obstacle {
+    double x, y;                   /**< mm, table. */
+    double vx, vy;                 /**< mm/s, estimated. */
+    int32_t last_move;             /**< Time its position last changed, in us. */
+    uint8_t valid;
+    uint8_t reciprocal;            /**< =1 if it runs ORCA too (the teammate). */
+};
+
+struct robot_context;
+
+struct orca {
+    struct robot_context *ctx;
+    double period;                 /**< Control period, in s. */
+
+    double horizon;
+    double radius;
+    double obstacle_radius;
+    double margin;
+
+    struct orca_obstacle obstacles[ORCA_MAX_OBSTACLES];
+
+    /** Velocity asked by the other modules, table frame. */
+    double desired_speed;          /**< mm/s */
+    double desired_heading;        /**< rad */
+
+    /** Our last output, to know if somebody asked for a new velocity since. */
+    int32_t out_speed;
+    double out_direction;
+    double vx, vy;                 /**< mm/s, table. */
+
+    uint8_t enabled;
+    uint8_t active;                /**< =1 if the last output differs from the asked velocity. */
+    uint32_t active_ticks;
+};
+
+/** Inits the layer with the default parameters, enabled.
+ * @param [in] frequency Frequency of orca_manage(), in Hz. */
+void orca_init(struct orca *o, struct robot_context *ctx, double frequency);
+
+/** Enables or disables the layer. Disabled, the velocity is not changed. */
+void orca_enable(struct orca *o, int enabled);
+
+/** Updates the tracks and corrects the velocity in ctx->robot->rs.
+ * @note Must be called after the modules setting the velocity and before
+ * rsh_update(). */
+void orca_manage(struct orca *o);
+
+#endif
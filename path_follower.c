@@ -0,0 +1,535 @@
+/** @file path_follower.c
+ * @brief Continuous polyline path follower.
+ * @sa path_follower.h for a description of the control law.
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/position_manager.h>
+#include <holonomic/trajectory_manager.h>
+
+#include "path_follower.h"
+#include "curve.h"
+#include "cvra_param_robot.h"
+
+void path_follower_init(struct path_follower *pf,
+                        struct robot_system_holonomic *rs,
+                        struct holonomic_robot_position *pos,
+                        struct h_trajectory *traj,
+                        double frequency) {
+    memset(pf, 0, sizeof(struct path_follower));
+
+    pf->rs = rs;
+    pf->pos = pos;
+    pf->traj = traj;
+    pf->period = 1. / frequency;
+
+    pf->max_speed = PATH_DEFAULT_MAX_SPEED;
+    pf->acceleration = PATH_DEFAULT_ACCELERATION;
+    pf->lateral_acceleration = PATH_DEFAULT_LATERAL_ACC;
+    pf->lookahead = PATH_DEFAULT_LOOKAHEAD;
+    pf->cross_track_gain = PATH_DEFAULT_CROSS_TRACK_GAIN;
+    pf->end_window = PATH_DEFAULT_END_WINDOW;
+    pf->clearance_stop = PATH_DEFAULT_CLEARANCE_STOP;
+    pf->clearance_slow = PATH_DEFAULT_CLEARANCE_SLOW;
+    pf->max_omega = PATH_DEFAULT_MAX_OMEGA;
+    pf->angular_acceleration = PATH_DEFAULT_ANGULAR_ACC;
+    pf->angle_window = PATH_DEFAULT_ANGLE_WINDOW;
+}
+
+void path_follower_set_speed(struct path_follower *pf, double max_speed,
+                             double acceleration, double lateral_acceleration) {
+    pf->max_speed = max_speed;
+    pf->acceleration = acceleration;
+    pf->lateral_acceleration = lateral_acceleration;
+}
+
+void path_follower_set_tracking(struct path_follower *pf, double lookahead,
+                                double cross_track_gain) {
+    pf->lookahead = lookahead;
+    pf->cross_track_gain = cross_track_gain;
+}
+
+void path_follower_set_rotation(struct path_follower *pf, double max_omega,
+                                double angular_acceleration) {
+    pf->max_omega = max_omega;
+    pf->angular_acceleration = angular_acceleration;
+}
+
+void path_follower_set_clearance(struct path_follower *pf,
+                                 double (*clearance)(void *, double, double),
+                                 void *param, double stop, double slow) {
+    pf->clearance = clearance;
+    pf->clearance_param = param;
+    pf->clearance_stop = stop;
+    pf->clearance_slow = slow;
+}
+
+/** Loads a path, leaving the follower inactive. */
+static int path_follower_load(struct path_follower *pf, const point_t *points, int nb_points) {
+    if(nb_points < 1 || nb_points > PATH_MAX_POINTS - 1)
+        return -1;
+
+    /* The control loop must not see a half written path. */
+    pf->active = 0;
+    holonomic_delete_event(pf->traj);
+
+    pf->points[0].x = holonomic_position_get_x_double(pf->pos);
+    pf->points[0].y = holonomic_position_get_y_double(pf->pos);
+    memcpy(&pf->points[1], points, nb_points * sizeof(point_t));
+    pf->nb_points = nb_points + 1;
+    pf->segment = 0;
+    pf->curves = NULL;
+    pf->heading_enabled = 0;
+    pf->omega = 0;
+    pf->speed = 0;
+    pf->cross_track_error = 0;
+    pf->finished = 0;
+
+    return 0;
+}
+
+int path_follower_start(struct path_follower *pf, const point_t *points, int nb_points) {
+    if(path_follower_load(pf, points, nb_points) < 0)
+        return -1;
+
+    pf->active = 1;
+    return 0;
+}
+
+int path_follower_start_curves(struct path_follower *pf, const struct curve *curves, int nb_curves) {
+    if(nb_curves < 1)
+        return -1;
+
+    pf->active = 0;
+    holonomic_delete_event(pf->traj);
+
+    pf->curves = curves;
+    pf->nb_curves = nb_curves;
+    pf->curve_index = 0;
+    pf->curve_s = 0;
+    pf->heading_enabled = 0;
+    pf->omega = 0;
+    pf->speed = 0;
+    pf->cross_track_error = 0;
+    pf->finished = 0;
+
+    pf->active = 1;
+    return 0;
+}
+
+void path_follower_set_heading(struct path_follower *pf, double heading) {
+    pf->target_heading = heading;
+    pf->heading_enabled = 1;
+}
+
+void path_follower_goto_xya(struct path_follower *pf, double x, double y, double a) {
+    point_t p;
+
+    p.x = x;
+    p.y = y;
+
+    path_follower_load(pf, &p, 1);
+    path_follower_set_heading(pf, a);
+    pf->active = 1;
+}
+
+void path_follower_stop(struct path_follower *pf) {
+    pf->active = 0;
+    pf->speed = 0;
+    pf->omega = 0;
+    rsh_set_speed(pf->rs, 0);
+    rsh_set_rotation_speed(pf->rs, 0);
+}
+
+void path_follower_pause(struct path_follower *pf) {
+    pf->paused = 1;
+}
+
+void path_follower_resume(struct path_follower *pf) {
+    pf->paused = 0;
+}
+
+int path_follower_end_of_path(struct path_follower *pf) {
+    return pf->finished;
+}
+
+void holonomic_set_world_velocity(struct robot_system_holonomic *rs,
+                                  struct holonomic_robot_position *pos,
+                                  double speed, double heading, int32_t omega) {
+    rsh_set_speed(rs, (int32_t)speed);
+    rsh_set_direction(rs, heading - holonomic_position_get_a_rad_double(pos));
+    rsh_set_rotation_speed(rs, omega);
+}
+
+/** Length of segment i. */
+static double segment_length(struct path_follower *pf, int i) {
+    return hypot(pf->points[i+1].x - pf->points[i].x,
+                 pf->points[i+1].y - pf->points[i].y);
+}
+
+/** Projects (x, y) on segment i.
+ *
+ * @returns The position along the segment, normalized between 0 and 1 (not
+ * clamped).
+ */
+static double segment_project(struct path_follower *pf, int i, double x, double y) {
+    double dx = pf->points[i+1].x - pf->points[i].x;
+    double dy = pf->points[i+1].y - pf->points[i].y;
+    double len2 = dx * dx + dy * dy;
+
+    if(len2 < 1e-6)
+        return 1.;
+
+    return ((x - pf->points[i].x) * dx + (y - pf->points[i].y) * dy) / len2;
+}
+
+/** Distance from (x, y) to segment i. */
+static double segment_distance(struct path_follower *pf, int i, double x, double y) {
+    double t = segment_project(pf, i, x, y);
+
+    if(t < 0.) t = 0.;
+    if(t > 1.) t = 1.;
+
+    return hypot(pf->points[i].x + t * (pf->points[i+1].x - pf->points[i].x) - x,
+                 pf->points[i].y + t * (pf->points[i+1].y - pf->points[i].y) - y);
+}
+
+/** Returns 1 if the robot is done with segment i and must follow the next one.
+ *
+ * Passing the end of the segment is not enough : on a corner sharper than
+ * about 90 degrees the look-ahead pulls the robot inside the corner, where
+ * its projection never reaches the end.
+ */
+static int segment_done(struct path_follower *pf, int i, double x, double y) {
+    double t = segment_project(pf, i, x, y);
+
+    if(t >= 1.)
+        return 1;
+    if((1. - t) * segment_length(pf, i) < pf->lookahead)
+        return 1;
+    return segment_distance(pf, i+1, x, y) < segment_distance(pf, i, x, y);
+}
+
+/** Maximum speed at distance d before a corner of angle phi. */
+static double corner_speed_limit(struct path_follower *pf, double phi, double d) {
+    double s = sin(fabs(phi) / 2.);
+    double v_corner;
+
+    if(s < 1e-3)
+        return pf->max_speed;
+
+    /* The look-ahead cuts the corner with a radius of about L / (2 sin(phi/2)). */
+    v_corner = sqrt(pf->lateral_acceleration * pf->lookahead / (2. * s));
+
+    return sqrt(v_corner * v_corner + 2. * pf->acceleration * d);
+}
+
+/** Time needed to travel a distance, starting at speed v0 and ending stopped.
+ *
+ * Trapezoidal profile with acceleration acc and cruise speed vmax.
+ */
+static double profile_time(double distance, double v0, double vmax, double acc) {
+    double d_acc, d_dec, vp;
+
+    if(distance <= 0. || vmax <= 0. || acc <= 0.)
+        return 0.;
+
+    if(v0 > vmax)
+        v0 = vmax;
+
+    d_acc = (vmax * vmax - v0 * v0) / (2. * acc);
+    d_dec = vmax * vmax / (2. * acc);
+
+    if(d_acc + d_dec <= distance)
+        return (vmax - v0) / acc + vmax / acc + (distance - d_acc - d_dec) / vmax;
+
+    /* Triangular profile. */
+    vp = sqrt((2. * acc * distance + v0 * v0) / 2.);
+    if(vp < v0)
+        return 2. * distance / v0;
+    return (vp - v0) / acc + vp / acc;
+}
+
+/** Signed heading error to the target, in the shortest direction. */
+static double heading_error(struct path_follower *pf) {
+    double err = pf->target_heading - holonomic_position_get_a_rad_double(pf->pos);
+    return atan2(sin(err), cos(err));
+}
+
+/** Computes the rotation speed so the heading is reached in a given time.
+ *
+ * @param [in] time_left Time left for the translation, in s.
+ * @param [out] rotation_time Time the rotation needs at full speed, in s.
+ * @returns The rotation speed, in rad/s.
+ */
+static double path_follower_rotation(struct path_follower *pf, double time_left,
+                                     double *rotation_time) {
+    double err, omega, limit;
+
+    *rotation_time = 0.;
+    if(!pf->heading_enabled)
+        return 0.;
+
+    err = heading_error(pf);
+    *rotation_time = profile_time(fabs(err), fabs(pf->omega), pf->max_omega,
+                                  pf->angular_acceleration);
+
+    if(fabs(err) < pf->angle_window)
+        return 0.;
+
+    /* Spread the rotation over the translation, but never slower than
+     * needed to stop on the target. */
+    if(time_left > *rotation_time && time_left > pf->period)
+        omega = err / time_left;
+    else
+        omega = err > 0 ? pf->max_omega : -pf->max_omega;
+
+    limit = sqrt(2. * pf->angular_acceleration * fabs(err));
+    if(fabs(omega) > limit)
+        omega = omega > 0 ? limit : -limit;
+
+    if(omega > pf->omega + pf->angular_acceleration * pf->period)
+        omega = pf->omega + pf->angular_acceleration * pf->period;
+    if(omega < pf->omega - pf->angular_acceleration * pf->period)
+        omega = pf->omega - pf->angular_acceleration * pf->period;
+
+    return omega;
+}
+
+/** Called once the translation is done.
+ *
+ * @returns 1 if the robot still has to turn, 0 if the path is finished.
+ */
+static int path_follower_end_rotation(struct path_follower *pf) {
+    double rotation_time;
+
+    if(pf->heading_enabled && fabs(heading_error(pf)) >= pf->angle_window) {
+        pf->speed = 0;
+        pf->omega = path_follower_rotation(pf, 0., &rotation_time);
+        rsh_set_speed(pf->rs, 0);
+        rsh_set_rotation_speed(pf->rs, (int32_t)(pf->omega * ROBOT_OMEGA_UNITS_PER_RAD_S));
+        return 1;
+    }
+
+    path_follower_stop(pf);
+    pf->finished = 1;
+    return 0;
+}
+
+/** Applies the control law once the geometry around the robot is known.
+ *
+ * @param [in] x, y Robot position.
+ * @param [in] cx, cy Closest point on the path.
+ * @param [in] gx, gy Look-ahead point.
+ * @param [in] v Speed limit from the path geometry, in mm/s.
+ */
+static void path_follower_drive(struct path_follower *pf, double x, double y,
+                                double cx, double cy, double gx, double gy,
+                                double v, double remaining) {
+    double dirx, diry, norm, time_left, rotation_time;
+
+    /* Direction : toward the look-ahead point, pulled back on the path. */
+    dirx = gx - cx;
+    diry = gy - cy;
+    norm = hypot(dirx, diry);
+    if(norm > 1e-3) {
+        dirx /= norm;
+        diry /= norm;
+    }
+    dirx += pf->cross_track_gain * (cx - x);
+    diry += pf->cross_track_gain * (cy - y);
+
+    /* Near the end the path collapses to a point, aim straight at it. */
+    if(hypot(dirx, diry) < 1e-3) {
+        dirx = gx - x;
+        diry = gy - y;
+    }
+
+    /* Clearance to the nearest obstacle. */
+    if(pf->clearance != NULL) {
+        double c = pf->clearance(pf->clearance_param, x, y);
+        double scale = (c - pf->clearance_stop) / (pf->clearance_slow - pf->clearance_stop);
+        if(scale < 0.) scale = 0.;
+        if(scale < 1. && pf->max_speed * scale < v)
+            v = pf->max_speed * scale;
+    }
+
+    /* Rotation : end together with the translation. If the rotation takes
+     * longer, slow the translation down to its pace instead. */
+    time_left = profile_time(remaining, pf->speed, v, pf->acceleration);
+    pf->omega = path_follower_rotation(pf, time_left, &rotation_time);
+    if(rotation_time > time_left && rotation_time > 0.)
+        v *= time_left / rotation_time;
+
+    /* Acceleration limit, deceleration is handled by the limits above. */
+    if(v > pf->speed + pf->acceleration * pf->period)
+        v = pf->speed + pf->acceleration * pf->period;
+    pf->speed = v;
+
+    holonomic_set_world_velocity(pf->rs, pf->pos, v, atan2(diry, dirx),
+                                 (int32_t)(pf->omega * ROBOT_OMEGA_UNITS_PER_RAD_S));
+}
+
+/** Follows a chain of curves. */
+static void path_follower_manage_curves(struct path_follower *pf, double x, double y) {
+    const struct curve *c = &pf->curves[pf->curve_index];
+    point_t closest, goal, end;
+    double heading, s, left, remaining, v, d, k, limit, braking_distance;
+    int i;
+
+    pf->curve_s = curve_project(c, pf->curve_s, x, y);
+
+    /* Go to the next curve once we are closer to its start than the
+     * look-ahead, as for the segments (see segment_done()). */
+    if(pf->curve_index < pf->nb_curves - 1 && curve_length(c) - pf->curve_s < pf->lookahead) {
+        pf->curve_index++;
+        c++;
+        pf->curve_s = curve_project(c, 0., x, y);
+    }
+
+    curve_eval(c, pf->curve_s, &closest, &heading);
+    pf->cross_track_error = cos(heading) * (y - closest.y) - sin(heading) * (x - closest.x);
+
+    /* End of path. */
+    curve_eval(&pf->curves[pf->nb_curves-1], curve_length(&pf->curves[pf->nb_curves-1]), &end, NULL);
+    if(pf->curve_index == pf->nb_curves - 1 && hypot(end.x - x, end.y - y) < pf->end_window) {
+        path_follower_end_rotation(pf);
+        return;
+    }
+
+    /* Look-ahead point, possibly on one of the next curves. */
+    s = pf->curve_s + pf->lookahead;
+    for(i=pf->curve_index;i<pf->nb_curves-1 && s > curve_length(&pf->curves[i]);i++)
+        s -= curve_length(&pf->curves[i]);
+    curve_eval(&pf->curves[i], s, &goal, NULL);
+
+    remaining = curve_length(c) - pf->curve_s;
+    for(i=pf->curve_index+1;i<pf->nb_curves;i++)
+        remaining += curve_length(&pf->curves[i]);
+
+    /* Speed : braking before the end and before the tight parts of the curve. */
+    v = pf->max_speed;
+    d = sqrt(2. * pf->acceleration * remaining);
+    if(d < v) v = d;
+
+    braking_distance = pf->max_speed * pf->max_speed / (2. * pf->acceleration);
+    for(left=0.;left<braking_distance && pf->curve_s + left <= curve_length(c);left+=c->step) {
+        k = fabs(curve_curvature(c, pf->curve_s + left));
+        if(k < 1e-6)
+            continue;
+        limit = sqrt(pf->lateral_acceleration / k);
+        limit = sqrt(limit * limit + 2. * pf->acceleration * left);
+        if(limit < v) v = limit;
+    }
+
+    path_follower_drive(pf, x, y, closest.x, closest.y, goal.x, goal.y, v, remaining);
+}
+
+void path_follower_manage(struct path_follower *pf) {
+    double x, y, t, len, tx, ty, cx, cy;
+    double gx, gy;
+    double remaining, left, d, v, braking_distance;
+    int i;
+
+    if(!pf->active)
+        return;
+
+    /* En pause : on freine dans la meme direction, puis on attend. La
+     * vitesse repart de zero avec la limite d'acceleration. */
+    if(pf->paused) {
+        pf->speed -= 2. * pf->acceleration * pf->period;
+        if(pf->speed < 0.)
+            pf->speed = 0.;
+        pf->omega = 0.;
+        rsh_set_speed(pf->rs, (int32_t)pf->speed);
+        rsh_set_rotation_speed(pf->rs, 0);
+        return;
+    }
+
+    x = holonomic_position_get_x_double(pf->pos);
+    y = holonomic_position_get_y_double(pf->pos);
+
+    if(pf->curves != NULL) {
+        path_follower_manage_curves(pf, x, y);
+        return;
+    }
+
+    while(pf->segment < pf->nb_points - 2 && segment_done(pf, pf->segment, x, y))
+        pf->segment++;
+
+    i = pf->segment;
+    len = segment_length(pf, i);
+    t = segment_project(pf, i, x, y);
+    if(t < 0.) t = 0.;
+    if(t > 1.) t = 1.;
+
+    if(len > 1e-3) {
+        tx = (pf->points[i+1].x - pf->points[i].x) / len;
+        ty = (pf->points[i+1].y - pf->points[i].y) / len;
+    }
+    else {
+        tx = ty = 0.;
+    }
+
+    /* Closest point on the path and signed cross-track error. */
+    cx = pf->points[i].x + tx * t * len;
+    cy = pf->points[i].y + ty * t * len;
+    pf->cross_track_error = tx * (y - pf->points[i].y) - ty * (x - pf->points[i].x);
+
+    /* Walk the look-ahead distance along the path. */
+    remaining = (1. - t) * len;
+    left = pf->lookahead;
+    gx = cx; gy = cy;
+    d = remaining;
+    if(left <= d) {
+        /* Le point vise est sur ce segment, les suivants ne comptent
+         * plus que pour la distance restante. */
+        gx += tx * left;
+        gy += ty * left;
+        left = 0.;
+    }
+    else {
+        gx = pf->points[i+1].x;
+        gy = pf->points[i+1].y;
+        left -= d;
+    }
+
+    for(i=pf->segment+1;i<pf->nb_points-1;i++) {
+        len = segment_length(pf, i);
+        if(left > 0. && len > 1e-3) {
+            double step = left < len ? left : len;
+            gx = pf->points[i].x + (pf->points[i+1].x - pf->points[i].x) * step / len;
+            gy = pf->points[i].y + (pf->points[i+1].y - pf->points[i].y) * step / len;
+            left -= step;
+        }
+        remaining += len;
+    }
+
+    /* End of path. */
+    if(pf->segment == pf->nb_points - 2 && hypot(pf->points[pf->nb_points-1].x - x,
+                                                  pf->points[pf->nb_points-1].y - y) < pf->end_window) {
+        path_follower_end_rotation(pf);
+        return;
+    }
+
+    /* Speed : braking before the end of the path and before the corners. */
+    v = pf->max_speed;
+    d = sqrt(2. * pf->acceleration * remaining);
+    if(d < v) v = d;
+
+    braking_distance = pf->max_speed * pf->max_speed / (2. * pf->acceleration);
+    d = (1. - t) * segment_length(pf, pf->segment);
+    for(i=pf->segment+1;i<pf->nb_points-1 && d < braking_distance;i++) {
+        double a1 = atan2(pf->points[i].y - pf->points[i-1].y, pf->points[i].x - pf->points[i-1].x);
+        double a2 = atan2(pf->points[i+1].y - pf->points[i].y, pf->points[i+1].x - pf->points[i].x);
+        double phi = atan2(sin(a2 - a1), cos(a2 - a1));
+        double limit = corner_speed_limit(pf, phi, d);
+        if(limit < v) v = limit;
+        d += segment_length(pf, i);
+    }
+
+    path_follower_drive(pf, x, y, cx, cy, gx, gy, v, remaining);
+}
@@ -0,0 +1,210 @@
+/** @file path_follower.h
+ * @brief Continuous polyline path follower.
+ *
+ * The trajectory manager only knows point to point moves, so a multi-waypoint
+ * path given to it is driven stop-and-go. This module tracks a whole polyline
+ * without stopping at the waypoints :
+ *
+ * - The robot position is projected on the current segment, giving the
+ *   cross-track error.
+ * - A look-ahead point is taken further along the path. The velocity
+ *   direction is the direction toward this point, corrected proportionally
+ *   to the cross-track error.
+ * - The speed is limited by the corners ahead (smaller radius, smaller speed),
+ *   by the distance to the end of the path and by the clearance to the
+ *   nearest obstacle, if a clearance function was given.
+ *
+ * The same control law can follow a chain of curves (splines and clothoids,
+ * see curve.h) instead of a polyline. The curvature limit then comes from the
+ * precomputed curvature table of the curve.
+ *
+ * The robot is holonomic, so by default the heading is kept constant while
+ * following. A final heading can be given instead : the robot then turns in
+ * the shortest direction while it translates, and the rotation speed is
+ * chosen so that rotation and translation end at the same time. If the
+ * rotation is the longest of the two, the translation is slowed down.
+ */
+#ifndef _PATH_FOLLOWER_H_
+#define _PATH_FOLLOWER_H_
+
+#include <aversive.h>
+#include <vect_base.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/position_manager.h>
+#include <holonomic/trajectory_manager.h>
+
+#include "curve.h"
+
+/** Maximum number of points in a path, current position included. */
+#define PATH_MAX_POINTS 16
+
+/** Default parameters. */
+#define PATH_DEFAULT_MAX_SPEED      500.  /**< mm/s */
+#define PATH_DEFAULT_ACCELERATION   500.  /**< mm/s^2 */
+#define PATH_DEFAULT_LATERAL_ACC    400.  /**< mm/s^2 */
+#define PATH_DEFAULT_LOOKAHEAD      100.  /**< mm */
+#define PATH_DEFAULT_CROSS_TRACK_GAIN 0.02 /**< 1/mm */
+#define PATH_DEFAULT_END_WINDOW     10.   /**< mm */
+#define PATH_DEFAULT_CLEARANCE_STOP 100.  /**< mm, full stop below this. */
+#define PATH_DEFAULT_CLEARANCE_SLOW 500.  /**< mm, full speed above this. */
+#define PATH_DEFAULT_MAX_OMEGA      3.    /**< rad/s */
+#define PATH_DEFAULT_ANGULAR_ACC    6.    /**< rad/s^2 */
+#define PATH_DEFAULT_ANGLE_WINDOW   0.02  /**< rad */
+
+/** Path follower state. */
+struct path_follower {
+    struct robot_system_holonomic *rs;
+    struct holonomic_robot_position *pos;
+    struct h_trajectory *traj;       /**< Stopped when a path is started. */
+
+    double period;                   /**< Control period, in s. */
+
+    point_t points[PATH_MAX_POINTS]; /**< Path, points[0] is the start position. */
+    int nb_points;
+    int segment;                     /**< Index of the start of the current segment. */
+
+    const struct curve *curves;      /**< Curves being followed, NULL for a polyline. */
+    int nb_curves;
+    int curve_index;                 /**< Curve the robot is on. */
+    double curve_s;                  /**< Arc length of the robot on this curve. */
+
+    double max_speed;
+    double acceleration;
+    double lateral_acceleration;
+    double lookahead;
+    double cross_track_gain;
+    double end_window;
+
+    /** Returns the clearance (mm) around a point, or NULL if unused. */
+    double (*clearance)(void *param, double x, double y);
+    void *clearance_param;
+    double clearance_stop;
+    double clearance_slow;
+
+    uint8_t heading_enabled;         /**< =1 if target_heading must be reached. */
+    double target_heading;           /**< Heading at the end of the path, in rad. */
+    double max_omega;                /**< rad/s */
+    double angular_acceleration;     /**< rad/s^2 */
+    double angle_window;             /**< rad */
+    double omega;                    /**< Last commanded rotation speed, in rad/s. */
+
+    double speed;                    /**< Last commanded speed, in mm/s. */
+    double cross_track_error;        /**< Last cross-track error, in mm. */
+
+    volatile uint8_t active;         /**< =1 while a path is being followed. */
+    volatile uint8_t finished;       /**< =1 when the last path was completed. */
+    volatile uint8_t paused;         /**< =1 while the robot waits on its path. */
+};
+
+/** Inits the path follower with the default parameters.
+ *
+ * @param [in] frequency Frequency at which path_follower_manage() is called, in Hz.
+ */
+void path_follower_init(struct path_follower *pf,
+                        struct robot_system_holonomic *rs,
+                        struct holonomic_robot_position *pos,
+                        struct h_trajectory *traj,
+                        double frequency);
+
+/** Sets the speed limits.
+ *
+ * @param [in] max_speed Cruise speed, in mm/s.
+ * @param [in] acceleration Tangential acceleration, in mm/s^2.
+ * @param [in] lateral_acceleration Maximum acceleration allowed in corners, in mm/s^2.
+ */
+void path_follower_set_speed(struct path_follower *pf, double max_speed,
+                             double acceleration, double lateral_acceleration);
+
+/** Sets the tracking parameters.
+ *
+ * @param [in] lookahead Distance of the look-ahead point along the path, in mm.
+ * @param [in] cross_track_gain Correction gain for the cross-track error, in 1/mm.
+ */
+void path_follower_set_tracking(struct path_follower *pf, double lookahead,
+                                double cross_track_gain);
+
+/** Sets the rotation limits used when a final heading is given.
+ *
+ * @param [in] max_omega Maximum rotation speed, in rad/s.
+ * @param [in] angular_acceleration Rotation acceleration, in rad/s^2.
+ */
+void path_follower_set_rotation(struct path_follower *pf, double max_omega,
+                                double angular_acceleration);
+
+/** Sets the function used to slow down near obstacles.
+ *
+ * @param [in] clearance Returns the free distance around a point, in mm.
+ * @param [in] stop Below this clearance the robot stops.
+ * @param [in] slow Above this clearance the robot goes full speed.
+ */
+void path_follower_set_clearance(struct path_follower *pf,
+                                 double (*clearance)(void *, double, double),
+                                 void *param, double stop, double slow);
+
+/** Starts following a path from the current position.
+ *
+ * The points are copied, so the caller can reuse its array. The running
+ * trajectory of the trajectory manager is cancelled.
+ * @param [in] points The waypoints, the last one is the destination.
+ * @param [in] nb_points Number of waypoints, at most PATH_MAX_POINTS - 1.
+ * @returns 0 on success, -1 if the path is empty or too long.
+ */
+int path_follower_start(struct path_follower *pf, const point_t *points, int nb_points);
+
+/** Starts following a chain of curves.
+ *
+ * The curves are \a not copied, they must stay valid until the end of the
+ * path. The first curve should start at the current position.
+ * @param [in] curves The curves, each one should start where the previous ends.
+ * @param [in] nb_curves Number of curves.
+ * @returns 0 on success, -1 if there is no curve.
+ */
+int path_follower_start_curves(struct path_follower *pf, const struct curve *curves, int nb_curves);
+
+/** Sets the heading to reach at the end of the current path.
+ *
+ * @param [in] heading Final heading, in rad. The robot turns in the
+ * shortest direction.
+ */
+void path_follower_set_heading(struct path_follower *pf, double heading);
+
+/** Goes to a full pose in a single move.
+ *
+ * Translation and rotation are done simultaneously and end together.
+ * @param [in] x, y Destination, in mm.
+ * @param [in] a Final heading, in rad.
+ */
+void path_follower_goto_xya(struct path_follower *pf, double x, double y, double a);
+
+/** Stops the robot on its path, keeping the path.
+ *
+ * The robot brakes at twice the acceleration and stays still until
+ * path_follower_resume(). A path started meanwhile waits as well.
+ */
+void path_follower_pause(struct path_follower *pf);
+
+/** Goes on with the path after path_follower_pause(), from zero speed. */
+void path_follower_resume(struct path_follower *pf);
+
+/** Stops following the path and stops the robot. */
+void path_follower_stop(struct path_follower *pf);
+
+/** Returns 1 when the robot reached the end of the path. */
+int path_follower_end_of_path(struct path_follower *pf);
+
+/** Computes and applies the velocity. Must be called at the control frequency. */
+void path_follower_manage(struct path_follower *pf);
+
+/** Applies a velocity given in the table coordinate system.
+ *
+ * The robot system expects a direction relative to the robot, this converts
+ * it using the current heading.
+ * @param [in] speed Translation speed, in mm/s.
+ * @param [in] heading Direction of the translation on the table, in rad.
+ * @param [in] omega Rotation speed, in the unit of rsh_set_rotation_speed().
+ */
+void holonomic_set_world_velocity(struct robot_system_holonomic *rs,
+                                  struct holonomic_robot_position *pos,
+                                  double speed, double heading, int32_t omega);
+
+#endif
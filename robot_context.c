@@ -0,0 +1,31 @@
+/** @file robot_context.c
+ * @brief The default robot context, used by the robot build.
+ *
+ * The modules themselves only work through a struct robot_context. This file
+ * holds the global instances of the real robot and ties them together.
+ */
+
+#include <aversive.h>
+
+#include "cvra_cs.h"
+#include "strat.h"
+#include "com_balises.h"
+#include "boot.h"
+#include "selftest.h"
+
+struct _rob robot;
+
+struct strat_info strat;
+
+struct beacon_com beacon_com;
+
+struct robot_context default_context = {
+    .robot = &robot,
+    .strat = &strat,
+    .beacon_com = &beacon_com,
+    .hot = &boot_hot,
+    .starter_pulled = strat_starter_pio,
+    .link = NULL,
+    .selftest_io = &selftest_robot_io,
+    .longest_scheduler_interrupt_time = 0,
+};
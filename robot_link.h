@@ -0,0 +1,24 @@
+/** @file robot_link.h
+ * @brief Byte link between the two robots of the team.
+ *
+ * The link is a pair of non blocking functions, so the modules using it do
+ * not care whether it is a serial radio or the simulated link of sim.c.
+ */
+#ifndef _ROBOT_LINK_H_
+#define _ROBOT_LINK_H_
+
+#include <aversive.h>
+
+struct robot_link {
+    /** Queues up to len bytes for the teammate.
+     * @returns The number of bytes accepted, 0 if the link is full. */
+    int (*write)(void *param, const uint8_t *data, int len);
+
+    /** Gets up to len received bytes.
+     * @returns The number of bytes read, 0 if none arrived. */
+    int (*read)(void *param, uint8_t *data, int len);
+
+    void *param;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/** @file rpc.c
+ * @brief Binary request/response channel multiplexed with the command line.
+ * @sa rpc.h for the frame format.
+ */
+
+#include <aversive.h>
+#include <string.h>
+#include <uptime.h>
+#include <cvra_dc.h>
+#include <holonomic/position_manager.h>
+
+#ifdef COMPILE_ON_ROBOT
+#include <sys/alt_irq.h>
+#endif
+
+#include "adresses.h"
+#include "cvra_cs.h"
+#include "strat.h"
+#include "fmt.h"
+#include "rpc.h"
+
+#define RPC_FLAG_TELEOP     0x01
+#define RPC_FLAG_FOLLOWER   0x02
+#define RPC_FLAG_STARTED    0x04
+#define RPC_FLAG_WATCHDOG   0x08
+
+void rpc_init(struct rpc *r, struct robot_context *ctx) {
+    r->ctx = ctx;
+    r->frame_pos = 0;
+    r->rejected_len = r->rejected_pos = 0;
+    r->requests_ok = r->requests_bad = 0;
+}
+
+static uint8_t *rpc_put8(uint8_t *p, uint8_t v) {
+    *p++ = v;
+    return p;
+}
+
+static uint8_t *rpc_put16(uint8_t *p, int32_t v) {
+    /* Sature au lieu de boucler. */
+    if(v > 32767)
+        v = 32767;
+    if(v < -32768)
+        v = -32768;
+    *p++ = (v >> 8) & 0xff;
+    *p++ = v & 0xff;
+    return p;
+}
+
+static uint8_t *rpc_put32(uint8_t *p, uint32_t v) {
+    *p++ = v >> 24;
+    *p++ = (v >> 16) & 0xff;
+    *p++ = (v >> 8) & 0xff;
+    *p++ = v & 0xff;
+    return p;
+}
+
+/** Fills the state vector, in one consistent snapshot.
+ *
+ *     version (uint8) | uptime (uint32, us)
+ *     x, y (int16, mm) | a (int16, mrad)
+ *     speed (int16, mm/s) | direction (int16, deg) | omega (int16, mrad/s)
+ *     consign speed, direction (mrad), rotation speed (int16)
+ *     delta_enc[3] (int32)
+ *     cs_manage_time_max (int16, us)
+ *     strat state (uint8) | match time (uint8, s) | flags (uint8, RPC_FLAG_*)
+ */
+static uint8_t *rpc_state_vector(struct robot_context *ctx, uint8_t *p) {
+    uint8_t flags = 0;
+    int i;
+#ifdef COMPILE_ON_ROBOT
+    /* La regulation ne doit pas tourner pendant la copie. */
+    alt_irq_context irq = alt_irq_disable_all();
+#endif
+
+    p = rpc_put8(p, RPC_STATE_VERSION);
+    p = rpc_put32(p, uptime_get());
+    p = rpc_put16(p, holonomic_position_get_x_s16(&ctx->robot->pos));
+    p = rpc_put16(p, holonomic_position_get_y_s16(&ctx->robot->pos));
+    p = rpc_put16(p, holonomic_position_get_a_rad_double(&ctx->robot->pos) * 1000);
+    p = rpc_put16(p, holonomic_position_get_instant_translation_speed(&ctx->robot->pos));
+    p = rpc_put16(p, holonomic_position_get_theta_v_int(&ctx->robot->pos));
+    p = rpc_put16(p, holonomic_position_get_instant_rotation_speed(&ctx->robot->pos) * 1000);
+    p = rpc_put16(p, ctx->robot->rs.speed);
+    p = rpc_put16(p, ctx->robot->rs.direction * 1000);
+    p = rpc_put16(p, ctx->robot->rs.rotation_speed);
+    for(i=0;i<3;i++)
+        p = rpc_put32(p, ctx->robot->pos.delta_enc[i]);
+    p = rpc_put16(p, ctx->robot->cs_manage_time_max);
+    p = rpc_put8(p, ctx->strat->state);
+    p = rpc_put8(p, ctx->strat->time);
+
+    if(ctx->robot->teleop.enabled)
+        flags |= RPC_FLAG_TELEOP;
+    if(ctx->robot->follower.active)
+        flags |= RPC_FLAG_FOLLOWER;
+    if(ctx->strat->started)
+        flags |= RPC_FLAG_STARTED;
+    if(ctx->robot->teleop.watchdog_fired)
+        flags |= RPC_FLAG_WATCHDOG;
+    p = rpc_put8(p, flags);
+
+#ifdef COMPILE_ON_ROBOT
+    alt_irq_enable_all(irq);
+#endif
+    return p;
+}
+
+/** Executes a request and writes the payload of the reply.
+ * @returns The status of the reply. */
+static rpc_status_t rpc_execute(struct robot_context *ctx, uint8_t method, const uint8_t *in, uint8_t in_len, uint8_t **out) {
+    uint8_t *p = *out;
+    int i;
+
+    switch(method) {
+        case RPC_PING:
+            for(i=0;i<in_len;i++)
+                p = rpc_put8(p, in[i]);
+            break;
+
+        case RPC_GET_POSITION:
+            p = rpc_put16(p, holonomic_position_get_x_s16(&ctx->robot->pos));
+            p = rpc_put16(p, holonomic_position_get_y_s16(&ctx->robot->pos));
+            p = rpc_put16(p, holonomic_position_get_a_rad_double(&ctx->robot->pos) * 1000);
+            break;
+
+        case RPC_GET_SPEED:
+            p = rpc_put16(p, holonomic_position_get_instant_translation_speed(&ctx->robot->pos));
+            p = rpc_put16(p, holonomic_position_get_theta_v_int(&ctx->robot->pos));
+            p = rpc_put16(p, holonomic_position_get_instant_rotation_speed(&ctx->robot->pos) * 1000);
+            break;
+
+        case RPC_GET_DELTA_ENC:
+            for(i=0;i<3;i++)
+                p = rpc_put32(p, ctx->robot->pos.delta_enc[i]);
+            break;
+
+        case RPC_GET_CURRENTS:
+            for(i=0;i<6;i++)
+                p = rpc_put32(p, cvra_dc_get_current(HEXMOTORCONTROLLER_BASE, i));
+            break;
+
+        case RPC_GET_STATE:
+            p = rpc_state_vector(ctx, p);
+            break;
+
+        default:
+            return RPC_UNKNOWN_METHOD;
+    }
+
+    if(method != RPC_PING && in_len != 0)
+        return RPC_BAD_LENGTH;
+
+    *out = p;
+    return RPC_OK;
+}
+
+/** Drops the request being received, its bytes are handed back. The start
+ * byte can not be typed, it is not. */
+static void rpc_reject_frame(struct rpc *r) {
+    memcpy(r->rejected, r->frame + 1, r->frame_pos - 1);
+    r->rejected_len = r->frame_pos - 1;
+    r->rejected_pos = 0;
+    r->frame_pos = 0;
+    r->requests_bad++;
+}
+
+/** Answers a complete request. */
+static void rpc_process(struct rpc *r) {
+    uint8_t reply[RPC_HEADER_LEN + RPC_MAX_PAYLOAD + 1];
+    uint8_t *p = &reply[RPC_HEADER_LEN];
+    uint8_t checksum = 0;
+    uint8_t len = r->frame[3];
+    int i;
+
+    for(i=1;i<RPC_HEADER_LEN+len;i++)
+        checksum += r->frame[i];
+
+    if(checksum != r->frame[RPC_HEADER_LEN+len]) {
+        rpc_reject_frame(r);
+        return;
+    }
+
+    reply[0] = RPC_REPLY_START;
+    reply[1] = r->frame[1];
+    reply[2] = rpc_execute(r->ctx, r->frame[2], &r->frame[RPC_HEADER_LEN], len, &p);
+    reply[3] = p - &reply[RPC_HEADER_LEN];
+
+    checksum = 0;
+    for(i=1;i<p-reply;i++)
+        checksum += reply[i];
+    *p++ = checksum;
+
+    /* La reponse part d'un bloc pour ne pas etre coupee par du texte. */
+    fmt_write(reply, p - reply);
+    r->requests_ok++;
+}
+
+int rpc_input_char(struct rpc *r, uint8_t c) {
+    int32_t now = uptime_get();
+
+    if(r->frame_pos > 0 && now - r->last_byte_time > RPC_BYTE_TIMEOUT)
+        rpc_reject_frame(r);
+
+    if(r->frame_pos == 0) {
+        if(c != RPC_REQUEST_START)
+            return 0;
+    }
+
+    r->frame[r->frame_pos++] = c;
+    r->last_byte_time = now;
+
+    if(r->frame_pos == RPC_HEADER_LEN && r->frame[3] > RPC_MAX_PAYLOAD) {
+        /* On ne peut pas trouver la fin de la trame, on se resynchronise. */
+        rpc_reject_frame(r);
+    }
+    else if(r->frame_pos > RPC_HEADER_LEN && r->frame_pos == RPC_HEADER_LEN + r->frame[3] + 1) {
+        rpc_process(r);
+        r->frame_pos = 0;
+    }
+
+    return 1;
+}
+
+int rpc_get_rejected(struct rpc *r) {
+    if(r->rejected_pos >= r->rejected_len)
+        return -1;
+    return r->rejected[r->rejected_pos++];
+}
@@ -0,0 +1,112 @@
+/** @file rpc.h
+ * @brief Binary request/response channel multiplexed with the command line.
+ *
+ * Like the teleop frames, the RPC frames start with a byte which can never be
+ * typed in a terminal, so the PC tools can query the robot on the same UART
+ * as the shell, without scraping the text output.
+ *
+ * Request (big endian) :
+ *
+ *     0xA6 | id | method | len | payload[len] | checksum
+ *
+ * Reply :
+ *
+ *     0xA7 | id | status | len | payload[len] | checksum
+ *
+ * The checksum is the sum of all the bytes after the start byte, modulo 256.
+ * The id is chosen by the client and copied in the reply, so many requests
+ * can be sent without waiting. A request with a bad checksum gets no reply.
+ *
+ * As for teleop, a request must arrive in one burst : if the gap between two
+ * of its bytes exceeds RPC_BYTE_TIMEOUT, it is dropped. The bytes after the
+ * start byte of a dropped request, or of one with a bad checksum or length,
+ * are handed back (see rpc_get_rejected()), so a stray start byte does not
+ * swallow the shell input or the teleop frames after it.
+ *
+ * Payloads of the replies, all integers big endian :
+ *  - RPC_PING : the request payload.
+ *  - RPC_GET_POSITION : x, y (int16, mm), a (int16, mrad).
+ *  - RPC_GET_SPEED : speed (int16, mm/s), direction (int16, deg),
+ *    omega (int16, mrad/s).
+ *  - RPC_GET_DELTA_ENC : the 3 encoder deltas of the last tick (int32).
+ *  - RPC_GET_CURRENTS : the 6 current channels (int32).
+ *  - RPC_GET_STATE : the state vector, see rpc_state_vector in rpc.c.
+ *
+ * tools/rpc_client.py is the host side.
+ */
+#ifndef _RPC_H_
+#define _RPC_H_
+
+#include <aversive.h>
+
+/** First byte of a request. */
+#define RPC_REQUEST_START 0xA6
+
+/** First byte of a reply. */
+#define RPC_REPLY_START 0xA7
+
+/** Length of the header, start byte included. */
+#define RPC_HEADER_LEN 4
+
+/** Maximum payload length, in both directions. */
+#define RPC_MAX_PAYLOAD 64
+
+/** Longest gap between two bytes of a request, in us. */
+#define RPC_BYTE_TIMEOUT 5000
+
+/** Version of the state vector layout, first byte of RPC_GET_STATE. */
+#define RPC_STATE_VERSION 1
+
+typedef enum {
+    RPC_PING=0,
+    RPC_GET_POSITION,
+    RPC_GET_SPEED,
+    RPC_GET_DELTA_ENC,
+    RPC_GET_CURRENTS,
+    RPC_GET_STATE,
+    RPC_NB_METHODS
+} rpc_method_t;
+
+typedef enum {
+    RPC_OK=0,
+    RPC_UNKNOWN_METHOD,
+    RPC_BAD_LENGTH,
+} rpc_status_t;
+
+struct robot_context;
+
+/** RPC decoder state. */
+struct rpc {
+    struct robot_context *ctx;         /**< Robot the requests are about. */
+    uint8_t frame[RPC_HEADER_LEN + RPC_MAX_PAYLOAD + 1]; /**< Request being received. */
+    uint8_t frame_pos;                 /**< Number of bytes received, 0 if idle. */
+    int32_t last_byte_time;            /**< uptime of the last byte of the request, in us. */
+
+    uint8_t rejected[RPC_HEADER_LEN + RPC_MAX_PAYLOAD + 1]; /**< Bytes to hand back. */
+    uint8_t rejected_len;
+    uint8_t rejected_pos;
+
+    uint32_t requests_ok;              /**< Number of answered requests. */
+    uint32_t requests_bad;             /**< Number of requests with a bad checksum or length, or too slow. */
+};
+
+/** Inits the decoder.
+ * @param [in] ctx The robot the requests are about. */
+void rpc_init(struct rpc *r, struct robot_context *ctx);
+
+/** Feeds a byte received on the UART to the decoder, and answers the
+ * request when it is complete.
+ *
+ * @returns 1 if the byte was part of a request, 0 if it should be given to
+ * the command line instead.
+ */
+int rpc_input_char(struct rpc *r, uint8_t c);
+
+/** Returns the next byte of a rejected request, or -1 if there is none.
+ *
+ * Drain it after each rpc_input_char(). Its bytes go to the other decoders
+ * and the command line before the byte just fed, if that one was not used.
+ */
+int rpc_get_rejected(struct rpc *r);
+
+#endif
@@ -0,0 +1,240 @@
+/** @file selftest.c
+ * @brief Pre-match check of the motors, encoders, servos and beacon.
+ * @sa selftest.h
+ */
+
+#include <aversive.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uptime.h>
+#include <control_system_manager.h>
+#include <cvra_dc.h>
+#include <cvra_servo.h>
+
+#include "adresses.h"
+#include "busstat.h"
+#include "cvra_cs.h"
+#include "com_balises.h"
+#include "fmt.h"
+#include "selftest.h"
+
+/** Bras court et bras long, en haut puis en bas, voir strat_long_arm_up(). */
+static const uint32_t selftest_servo_position[SELFTEST_SERVOS][2] = {
+    {17000, 8000},
+    {15000, 7000},
+};
+
+static int32_t selftest_robot_current(void *base, int wheel) {
+    /* Voir cmd_print_currents(). */
+    static const int channel[3] = {4, 3, 5};
+    return BUS_DC(cvra_dc_get_current)(base, channel[wheel]);
+}
+
+static int32_t selftest_robot_index(void *base, int wheel) {
+    if(wheel == 0)
+        return BUS_DC(cvra_dc_get_index0)(base);
+    if(wheel == 1)
+        return BUS_DC(cvra_dc_get_index1)(base);
+    return BUS_DC(cvra_dc_get_index2)(base);
+}
+
+static uint32_t selftest_robot_servo(void *base, int channel, uint32_t value) {
+    (void)base;
+    BUS_DC(cvra_servo_set)((void*)SERVOS_BASE, channel, value);
+#ifdef COMPILE_ON_ROBOT
+    return BUS_IORD(BUS_SERVO, SERVOS_BASE, channel);
+#else
+    return value;
+#endif
+}
+
+const struct selftest_io selftest_robot_io = {
+    .current = selftest_robot_current,
+    .index = selftest_robot_index,
+    .servo = selftest_robot_servo,
+    .param = (void*)HEXMOTORCONTROLLER_BASE,
+};
+
+/* On passe par les entrees et sorties des regulations : sur le robot c'est
+ * la carte moteur, en simulation le modele des moteurs. */
+static void selftest_set_pwm(struct cs *cs[3], int32_t pwm) {
+    int i;
+    for(i=0;i<3;i++)
+        cs[i]->process_in(cs[i]->process_in_params, pwm);
+}
+
+static void selftest_get_encoders(struct cs *cs[3], int32_t enc[3]) {
+    int i;
+    for(i=0;i<3;i++)
+        enc[i] = cs[i]->process_out(cs[i]->process_out_params);
+}
+
+static void selftest_set_servos(const struct selftest_io *io, struct selftest_result *res, int down) {
+    int i;
+
+    if(io->servo == NULL)
+        return;
+
+    for(i=0;i<SELFTEST_SERVOS;i++) {
+        uint32_t value = selftest_servo_position[i][down];
+        res->servo_read[i] = io->servo(io->param, i, value);
+        /* Relit le registre de la carte, pas la position du servo : ne
+         * verifie que le bus. */
+        if(res->servo_read[i] != value)
+            res->servo_bus[i] = SELFTEST_FAIL;
+        else if(res->servo_bus[i] == SELFTEST_SKIP)
+            res->servo_bus[i] = SELFTEST_PASS;
+    }
+}
+
+static void selftest_wait_until(int32_t start, int32_t t) {
+    while(uptime_get() - start < t);
+}
+
+static void selftest_check_wheels(struct selftest_result *res, int has_index) {
+    struct selftest_wheel *w;
+    double mean = 0, travel;
+    int i;
+
+    /* En valeur absolue : une roue a l'envers ne fait pas echouer les autres. */
+    for(i=0;i<3;i++)
+        mean += (labs(res->wheels[i].forward) + labs(res->wheels[i].backward)) / 6.;
+
+    for(i=0;i<3;i++) {
+        w = &res->wheels[i];
+        travel = (labs(w->forward) + labs(w->backward)) / 2.;
+
+        if(w->forward < SELFTEST_ENCODER_MIN || w->backward > -SELFTEST_ENCODER_MIN ||
+           travel < mean * (1 - SELFTEST_ENCODER_SPREAD) || travel > mean * (1 + SELFTEST_ENCODER_SPREAD))
+            w->encoder = SELFTEST_FAIL;
+        else
+            w->encoder = SELFTEST_PASS;
+
+        /* Sans un tour complet l'index n'a pas forcement passe. */
+        if(!has_index)
+            continue;
+        if(w->index_moved)
+            w->index = SELFTEST_PASS;
+        else if(labs(w->forward) >= SELFTEST_INDEX_PERIOD || labs(w->backward) >= SELFTEST_INDEX_PERIOD)
+            w->index = SELFTEST_FAIL;
+    }
+}
+
+int selftest_run(struct robot_context *ctx, struct selftest_result *res) {
+    struct _rob *r = ctx->robot;
+    const struct selftest_io *io = ctx->selftest_io;
+    struct cs *cs[3] = {&r->wheel0_cs, &r->wheel1_cs, &r->wheel2_cs};
+    int32_t start_enc[3], mid_enc[3], end_enc[3], start_index[3] = {0, 0, 0};
+    int32_t current_sum[3] = {0, 0, 0};
+    int32_t start, t, samples = 0;
+    uint32_t frames = 0;
+    int i;
+
+    memset(res, 0, sizeof(struct selftest_result));
+
+    cvra_cs_enable(ctx, 0);
+
+    selftest_get_encoders(cs, start_enc);
+    for(i=0;i<3;i++) {
+        if(io->index != NULL)
+            start_index[i] = io->index(io->param, i);
+        if(io->current != NULL)
+            res->wheels[i].rest_current = abs(io->current(io->param, i));
+    }
+    if(ctx->beacon_com != NULL)
+        frames = ctx->beacon_com->frames;
+
+    /* Tout en meme temps : les trois roues dans le meme sens (le robot
+     * tourne sur place), les bras et la balise qui tourne de son cote. */
+    start = uptime_get();
+    selftest_set_servos(io, res, 0);
+    selftest_set_pwm(cs, SELFTEST_PWM);
+
+    while((t = uptime_get() - start) < SELFTEST_PULSE) {
+        if(t >= SELFTEST_SETTLE && io->current != NULL) {
+            for(i=0;i<3;i++)
+                current_sum[i] += abs(io->current(io->param, i));
+            samples++;
+        }
+        selftest_wait_until(start, t + SELFTEST_PERIOD);
+    }
+
+    selftest_get_encoders(cs, mid_enc);
+    selftest_set_servos(io, res, 1);
+    selftest_set_pwm(cs, -SELFTEST_PWM);
+    selftest_wait_until(start, 2 * SELFTEST_PULSE);
+
+    selftest_get_encoders(cs, end_enc);
+    selftest_set_pwm(cs, 0);
+    selftest_wait_until(start, SELFTEST_DURATION);
+
+    for(i=0;i<3;i++) {
+        struct selftest_wheel *w = &res->wheels[i];
+
+        w->forward = mid_enc[i] - start_enc[i];
+        w->backward = end_enc[i] - mid_enc[i];
+        if(io->index != NULL)
+            w->index_moved = io->index(io->param, i) != start_index[i];
+
+        if(samples > 0) {
+            w->current = current_sum[i] / samples;
+            if(w->current - w->rest_current >= SELFTEST_CURRENT_MIN && w->current <= SELFTEST_CURRENT_MAX)
+                w->current_status = SELFTEST_PASS;
+            else
+                w->current_status = SELFTEST_FAIL;
+        }
+    }
+    selftest_check_wheels(res, io->index != NULL);
+
+    if(ctx->beacon_com != NULL) {
+        res->beacon_rate = (int32_t)((ctx->beacon_com->frames - frames) * 1000000ULL / (uptime_get() - start));
+        res->beacon = res->beacon_rate >= SELFTEST_BEACON_MIN_RATE ? SELFTEST_PASS : SELFTEST_FAIL;
+    }
+
+    cvra_cs_enable(ctx, 1);
+
+    for(i=0;i<3;i++) {
+        res->failed += res->wheels[i].encoder == SELFTEST_FAIL;
+        res->failed += res->wheels[i].index == SELFTEST_FAIL;
+        res->failed += res->wheels[i].current_status == SELFTEST_FAIL;
+    }
+    for(i=0;i<SELFTEST_SERVOS;i++)
+        res->failed += res->servo_bus[i] == SELFTEST_FAIL;
+    res->failed += res->beacon == SELFTEST_FAIL;
+
+    return res->failed;
+}
+
+static const char *selftest_status_name(selftest_status_t s) {
+    if(s == SELFTEST_PASS)
+        return "PASS";
+    if(s == SELFTEST_FAIL)
+        return "FAIL";
+    return "skip";
+}
+
+void selftest_print(struct selftest_result *res) {
+    int i;
+
+    fmt_printf("check           | value         | result\n");
+    for(i=0;i<3;i++) {
+        struct selftest_wheel *w = &res->wheels[i];
+
+        fmt_printf("wheel %d encoder | %6d %6d | %s\n", i, (int)w->forward, (int)w->backward,
+                   selftest_status_name(w->encoder));
+        fmt_printf("wheel %d index   | %13s | %s\n", i, w->index_moved ? "moved" : "still",
+                   selftest_status_name(w->index));
+        fmt_printf("wheel %d current | %6d %6d | %s\n", i, (int)w->rest_current, (int)w->current,
+                   selftest_status_name(w->current_status));
+    }
+    for(i=0;i<SELFTEST_SERVOS;i++)
+        fmt_printf("servo %d bus     | %13u | %s\n", i, (unsigned int)res->servo_read[i],
+                   selftest_status_name(res->servo_bus[i]));
+    fmt_printf("servos          |   no feedback | %s\n", selftest_status_name(SELFTEST_SKIP));
+    fmt_printf("beacon          | %10d /s | %s\n", (int)res->beacon_rate, selftest_status_name(res->beacon));
+
+    if(res->failed)
+        fmt_printf("selftest : %d FAILED\n", res->failed);
+    else
+        fmt_printf("selftest : all passed\n");
+}
@@ -0,0 +1,101 @@
+/** @file selftest.h
+ * @brief Pre-match check of the motors, encoders, servos and beacon.
+ *
+ * Replaces typing pwm, encoders, index, servo and beacon one after the
+ * other before each match. Everything is checked at the same time, in about
+ * SELFTEST_DURATION :
+ *  - the three wheels get the same PWM pulse, forward then backward, so the
+ *    robot turns in place and comes back. Each encoder must move in the
+ *    direction of its PWM, by at least SELFTEST_ENCODER_MIN, and not too far
+ *    from the two others ;
+ *  - the index of each wheel must have moved if its encoder travelled more
+ *    than SELFTEST_INDEX_PERIOD, else the check is skipped ;
+ *  - the current of each motor must rise during the pulse, without reaching
+ *    SELFTEST_CURRENT_MAX ;
+ *  - the arm servos go up then down, the value read back from the servo
+ *    board must be the one written. This only checks the bus to the board :
+ *    the servos give no feedback, so the servos themselves are reported as
+ *    skipped ;
+ *  - the beacon frames are counted during the whole test.
+ *
+ * The control systems are disabled during the test and enabled again after,
+ * the robot must have room to turn a bit or be lifted.
+ *
+ * The hardware the control systems do not reach goes through a struct
+ * selftest_io, so the same test runs on the simulated robots (see sim.h).
+ */
+#ifndef _SELFTEST_H_
+#define _SELFTEST_H_
+
+#include <aversive.h>
+#include "cvra_param_robot.h"
+
+#define SELFTEST_PWM               200      /**< Pulse on each wheel, of 475. */
+#define SELFTEST_PULSE             300000   /**< us, each direction. */
+#define SELFTEST_SETTLE            100000   /**< us, then the current is averaged. */
+#define SELFTEST_STOP              100000   /**< us, wheels stopping after the pulses. */
+#define SELFTEST_PERIOD            10000    /**< us, between two samples. */
+#define SELFTEST_DURATION          (2 * SELFTEST_PULSE + SELFTEST_STOP)
+
+#define SELFTEST_ENCODER_MIN       2000     /**< Ticks, during a pulse. */
+#define SELFTEST_ENCODER_SPREAD    0.3      /**< Allowed difference to the mean of the wheels. */
+#define SELFTEST_INDEX_PERIOD      ROBOT_ENCODER_RESOLUTION /**< Ticks between two index pulses. */
+
+/** Motor currents, in the units of cvra_dc_get_current(). To calibrate. */
+#define SELFTEST_CURRENT_MIN       20       /**< Rise during the pulse. */
+#define SELFTEST_CURRENT_MAX       400
+
+#define SELFTEST_BEACON_MIN_RATE   5        /**< Frames per second. */
+
+#define SELFTEST_SERVOS            2
+
+typedef enum {
+    SELFTEST_SKIP = 0,             /**< Could not be checked. */
+    SELFTEST_PASS,
+    SELFTEST_FAIL,
+} selftest_status_t;
+
+/** Access to the hardware outside of the control systems. */
+struct selftest_io {
+    /** Current of a wheel motor. */
+    int32_t (*current)(void *param, int wheel);
+    /** Encoder value latched at the last index pulse of a wheel. */
+    int32_t (*index)(void *param, int wheel);
+    /** Sets a servo and returns the value read back, NULL without servos. */
+    uint32_t (*servo)(void *param, int channel, uint32_t value);
+    void *param;
+};
+
+/** Hardware of the robot. */
+extern const struct selftest_io selftest_robot_io;
+
+struct selftest_wheel {
+    int32_t forward, backward;     /**< Encoder travel during each pulse, in ticks. */
+    int32_t rest_current;          /**< Before the pulse. */
+    int32_t current;               /**< Mean during the forward pulse. */
+    uint8_t index_moved;
+
+    selftest_status_t encoder;
+    selftest_status_t index;
+    selftest_status_t current_status;
+};
+
+struct selftest_result {
+    struct selftest_wheel wheels[3];
+    uint32_t servo_read[SELFTEST_SERVOS];   /**< Last value read back from the board. */
+    selftest_status_t servo_bus[SELFTEST_SERVOS]; /**< Register written and read back. */
+    int32_t beacon_rate;           /**< Frames per second. */
+    selftest_status_t beacon;
+    int failed;                    /**< Number of checks failed. */
+};
+
+struct robot_context;
+
+/** Runs the test, blocks for about SELFTEST_DURATION.
+ * @returns The number of checks failed. */
+int selftest_run(struct robot_context *ctx, struct selftest_result *res);
+
+/** Prints the pass/fail table. */
+void selftest_print(struct selftest_result *res);
+
+#endif
@@ -0,0 +1,445 @@
+/** @file sim.c
+ * @brief Team simulation on the PC, see sim.h.
+ */
+
+#include <aversive.h>
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include <scheduler.h>
+#include <uptime.h>
+
+#include "sim.h"
+#include "cvra_cs.h"
+#include "strat.h"
+#include "fmt.h"
+#include "curve.h"
+#include "path_follower.h"
+
+/** Size of the table, in mm. */
+#define SIM_TABLE_X 3000
+#define SIM_TABLE_Y 2000
+
+/** Simulated time, in us. Written by sim_step() only. */
+static volatile int32_t sim_now;
+
+/** Replaces the uptime module : the firmware sees the simulated time. */
+int32_t uptime_get(void) {
+    return sim_now;
+}
+
+int32_t sim_time(void) {
+    return sim_now;
+}
+
+/*
+ * Motors. The control system of each wheel is wired to a struct sim_motor
+ * instead of the motor board.
+ */
+
+static void sim_set_pwm(void *motor, int32_t pwm) {
+    ((struct sim_motor *)motor)->pwm = pwm;
+}
+
+static int32_t sim_get_encoder(void *motor) {
+    return (int32_t)((struct sim_motor *)motor)->position;
+}
+
+static int32_t sim_get_index(__attribute__((unused)) void *motor) {
+    return 0;
+}
+
+static void sim_motor_update(struct sim_motor *m, double dt) {
+    double previous = floor(m->position / SELFTEST_INDEX_PERIOD);
+    double current;
+
+    m->speed += (SIM_MOTOR_GAIN * m->pwm - m->speed) * dt / SIM_MOTOR_TAU;
+    m->position += m->speed * dt;
+
+    current = floor(m->position / SELFTEST_INDEX_PERIOD);
+    if(current != previous)
+        m->index = (int32_t)(SELFTEST_INDEX_PERIOD * (current > previous ? current : previous));
+}
+
+/*
+ * Hardware of the self test. The odometry keeps sim_get_index(), the index is
+ * only modelled for the self test.
+ */
+
+static int32_t sim_selftest_current(void *robot, int wheel) {
+    struct sim_motor *m = &((struct sim_robot *)robot)->motors[wheel];
+    double speed = m->speed / SIM_MOTOR_GAIN;
+
+    return (int32_t)(SIM_MOTOR_CURRENT_GAIN * (m->pwm - speed) + SIM_MOTOR_FRICTION * speed);
+}
+
+static int32_t sim_selftest_index(void *robot, int wheel) {
+    return ((struct sim_robot *)robot)->motors[wheel].index;
+}
+
+/*
+ * Link between teammates. A byte written at t can be read at
+ * max(t, end of the previous byte) + byte_time + latency.
+ */
+
+static int sim_fifo_used(struct sim_link_fifo *f) {
+    return (f->head - f->tail + SIM_LINK_BUFFER) % SIM_LINK_BUFFER;
+}
+
+static int sim_link_write(void *param, const uint8_t *data, int len) {
+    struct sim_link_end *end = param;
+    struct sim_link *l = end->link;
+    struct sim_link_fifo *f = &l->fifo[1 - end->side];
+    int i;
+
+    pthread_mutex_lock(&l->lock);
+
+    /* Like a serial port, a frame which does not fit is not sent at all. */
+    if(sim_fifo_used(f) + len >= SIM_LINK_BUFFER) {
+        l->bytes_refused += len;
+        pthread_mutex_unlock(&l->lock);
+        return 0;
+    }
+
+    if(f->busy_until < sim_now)
+        f->busy_until = sim_now;
+
+    for(i=0;i<len;i++) {
+        f->busy_until += l->byte_time;
+        f->data[f->head] = data[i];
+        f->arrival[f->head] = f->busy_until + l->latency;
+        f->head = (f->head + 1) % SIM_LINK_BUFFER;
+    }
+    l->bytes_sent += len;
+
+    pthread_mutex_unlock(&l->lock);
+    return len;
+}
+
+static int sim_link_read(void *param, uint8_t *data, int len) {
+    struct sim_link_end *end = param;
+    struct sim_link *l = end->link;
+    struct sim_link_fifo *f = &l->fifo[end->side];
+    int n = 0;
+
+    pthread_mutex_lock(&l->lock);
+    while(n < len && f->tail != f->head && f->arrival[f->tail] <= sim_now) {
+        data[n++] = f->data[f->tail];
+        f->tail = (f->tail + 1) % SIM_LINK_BUFFER;
+    }
+    pthread_mutex_unlock(&l->lock);
+
+    return n;
+}
+
+/** The starter cord is pulled as soon as the simulation starts. */
+static int sim_starter_pulled(__attribute__((unused)) struct robot_context *ctx) {
+    return sim_now > 0;
+}
+
+void sim_init(struct sim_world *w, int32_t latency, int32_t bandwidth) {
+    memset(w, 0, sizeof(struct sim_world));
+
+    pthread_mutex_init(&w->link.lock, NULL);
+    w->link.latency = latency;
+    w->link.byte_time = bandwidth > 0 ? 1000000 / bandwidth : 0;
+
+    sim_now = 0;
+    scheduler_init();
+}
+
+struct sim_robot *sim_add_robot(struct sim_world *w, strat_color_t color, int start_x, int start_y) {
+    struct sim_robot *r;
+    struct robot_context *ctx;
+    int i;
+
+    if(w->nb_robots >= SIM_MAX_ROBOTS)
+        return NULL;
+
+    r = &w->robots[w->nb_robots];
+    r->link_end.link = &w->link;
+    r->link_end.side = w->nb_robots;
+    r->link.write = sim_link_write;
+    r->link.read = sim_link_read;
+    r->link.param = &r->link_end;
+    r->color = color;
+    r->min_opponent_distance = SIM_TABLE_X;
+
+    ctx = &r->ctx;
+    ctx->robot = &r->robot;
+    ctx->strat = &r->strat;
+    ctx->beacon_com = &r->beacon_com;
+    ctx->hot = NULL;
+    ctx->starter_pulled = sim_starter_pulled;
+    ctx->link = &r->link;
+
+    /* Pas de servos dans la simulation. */
+    r->selftest_io.current = sim_selftest_current;
+    r->selftest_io.index = sim_selftest_index;
+    r->selftest_io.servo = NULL;
+    r->selftest_io.param = r;
+    ctx->selftest_io = &r->selftest_io;
+
+    r->strat.color = color;
+    r->strat.start_x = start_x;
+    r->strat.start_y = start_y;
+    r->beacon_com.fd = -1;
+
+    cvra_cs_init(ctx);
+
+    /* Branche la regulation sur le modele des moteurs. */
+    cs_set_process_in(&r->robot.wheel0_cs, sim_set_pwm, &r->motors[0]);
+    cs_set_process_in(&r->robot.wheel1_cs, sim_set_pwm, &r->motors[1]);
+    cs_set_process_in(&r->robot.wheel2_cs, sim_set_pwm, &r->motors[2]);
+
+    cs_set_process_out(&r->robot.wheel0_cs, sim_get_encoder, &r->motors[0]);
+    cs_set_process_out(&r->robot.wheel1_cs, sim_get_encoder, &r->motors[1]);
+    cs_set_process_out(&r->robot.wheel2_cs, sim_get_encoder, &r->motors[2]);
+
+    {
+        int32_t (*encoder[])(void *) = {sim_get_encoder, sim_get_encoder, sim_get_encoder};
+        int32_t (*index[])(void *) = {sim_get_index, sim_get_index, sim_get_index};
+        void *param[3];
+
+        for(i=0;i<3;i++)
+            param[i] = &r->motors[i];
+
+        holonomic_position_set_mot_encoder(&r->robot.pos, encoder, param, index, param);
+    }
+
+    r->robot.team.id = w->nb_robots;
+
+    w->nb_robots++;
+    return r;
+}
+
+struct sim_opponent *sim_add_opponent(struct sim_world *w, const point_t *waypoints, int nb, double speed) {
+    struct sim_opponent *o;
+
+    if(w->nb_opponents >= SIM_MAX_OPPONENTS || nb < 1 || nb > SIM_MAX_WAYPOINTS)
+        return NULL;
+
+    o = &w->opponents[w->nb_opponents++];
+    memcpy(o->waypoints, waypoints, nb * sizeof(point_t));
+    o->nb_waypoints = nb;
+    o->current = nb > 1 ? 1 : 0;
+    o->x = waypoints[0].x;
+    o->y = waypoints[0].y;
+    o->speed = speed;
+
+    return o;
+}
+
+static void *sim_strat_thread(void *param) {
+    struct sim_robot *r = param;
+    strat_begin(&r->ctx, r->color);
+    return NULL;
+}
+
+void sim_start(struct sim_world *w) {
+    int i;
+
+    for(i=0;i<w->nb_robots;i++)
+        pthread_create(&w->robots[i].thread, NULL, sim_strat_thread, &w->robots[i]);
+}
+
+int sim_selftest(struct sim_world *w) {
+    struct selftest_result res;
+    int i, failed = 0;
+
+    for(i=0;i<w->nb_robots;i++) {
+        failed += selftest_run(&w->robots[i].ctx, &res);
+        fmt_printf("\nrobot %d\n", i);
+        selftest_print(&res);
+    }
+
+    return failed;
+}
+
+/** Starts the path of sim_paths() with a corner of the given angle, in degrees. */
+static void sim_path_start(struct path_follower *pf, int angle, int curves) {
+    static struct curve chain[2];
+    const double a = angle * M_PI / 180;
+    point_t p[2] = {{1500, 1000}, {1500 + 400 * cos(a), 1000 + 400 * sin(a)}};
+    point_t start = {1000, 1000};
+    vect_t t = {500, 0}, zero = {0, 0};
+
+    if(curves) {
+        curve_quintic(&chain[0], start, t, zero, p[0], t, zero);
+        curve_clothoid(&chain[1], p[0], a, 0, 0, 400);
+        path_follower_start_curves(pf, chain, 2);
+    }
+    else {
+        path_follower_start(pf, p, 2);
+    }
+}
+
+int sim_paths(struct sim_world *w) {
+    static const int angles[] = {90, 135, 170};
+    struct _rob *r = w->robots[0].ctx.robot;
+    int32_t start;
+    int i, curves, failed = 0;
+
+    fmt_printf("path          | corner | result\n");
+    for(curves=0;curves<2;curves++) {
+        for(i=0;i<(int)(sizeof(angles)/sizeof(angles[0]));i++) {
+            CVRA_CS_LOCK();
+            holonomic_position_set(&r->pos, 1000, 1000, 0);
+            sim_path_start(&r->follower, angles[i], curves);
+            CVRA_CS_UNLOCK();
+
+            start = sim_time();
+            while(!path_follower_end_of_path(&r->follower) && sim_time() - start < SIM_PATH_TIMEOUT);
+
+            if(path_follower_end_of_path(&r->follower)) {
+                fmt_printf("%-13s | %6d | done in %d ms\n", curves ? "curves" : "segments",
+                           angles[i], (int)((sim_time() - start) / 1000));
+            }
+            else {
+                fmt_printf("%-13s | %6d | FAIL, stopped at %d %d\n", curves ? "curves" : "segments", angles[i],
+                           (int)holonomic_position_get_x_double(&r->pos),
+                           (int)holonomic_position_get_y_double(&r->pos));
+                CVRA_CS_LOCK();
+                path_follower_stop(&r->follower);
+                CVRA_CS_UNLOCK();
+                failed++;
+            }
+        }
+    }
+
+    return failed;
+}
+
+static void sim_opponent_update(struct sim_opponent *o, double dt) {
+    double dx = o->waypoints[o->current].x - o->x;
+    double dy = o->waypoints[o->current].y - o->y;
+    double d = hypot(dx, dy);
+    double step = o->speed * dt;
+
+    if(d <= step) {
+        o->x = o->waypoints[o->current].x;
+        o->y = o->waypoints[o->current].y;
+        o->current = (o->current + 1) % o->nb_waypoints;
+    }
+    else {
+        o->x += dx * step / d;
+        o->y += dy * step / d;
+    }
+}
+
+/** Pushes (x, y) out of a disc of radius dist around (ox, oy).
+ * @returns 1 if there was a contact. */
+static int sim_push_out(double *x, double *y, double ox, double oy, double dist) {
+    double dx = *x - ox, dy = *y - oy;
+    double d = hypot(dx, dy);
+
+    if(d >= dist)
+        return 0;
+
+    if(d < 1e-3) {
+        dx = 1;
+        dy = 0;
+        d = 1;
+    }
+    *x = ox + dx * dist / d;
+    *y = oy + dy * dist / d;
+    return 1;
+}
+
+/** Table coordinates of a robot, its odometry is in its own color frame. */
+static void sim_robot_pose(struct sim_robot *r, double *x, double *y) {
+    *x = holonomic_position_get_x_double(&r->robot.pos);
+    *y = COLOR_Y(&r->strat, holonomic_position_get_y_double(&r->robot.pos));
+}
+
+static void sim_collisions(struct sim_world *w, int i) {
+    struct sim_robot *r = &w->robots[i];
+    double x, y, x0, y0;
+    int contact = 0, j;
+
+    sim_robot_pose(r, &x, &y);
+    x0 = x;
+    y0 = y;
+
+    if(x < SIM_ROBOT_FACE) { x = SIM_ROBOT_FACE; contact = 1; }
+    if(x > SIM_TABLE_X - SIM_ROBOT_FACE) { x = SIM_TABLE_X - SIM_ROBOT_FACE; contact = 1; }
+    if(y < SIM_ROBOT_FACE) { y = SIM_ROBOT_FACE; contact = 1; }
+    if(y > SIM_TABLE_Y - SIM_ROBOT_FACE) { y = SIM_TABLE_Y - SIM_ROBOT_FACE; contact = 1; }
+
+    for(j=0;j<w->nb_robots;j++) {
+        double ox, oy;
+        if(j == i)
+            continue;
+        sim_robot_pose(&w->robots[j], &ox, &oy);
+        contact |= sim_push_out(&x, &y, ox, oy, 2 * SIM_ROBOT_RADIUS);
+    }
+
+    for(j=0;j<w->nb_opponents;j++) {
+        double d = hypot(x - w->opponents[j].x, y - w->opponents[j].y);
+        if(d < r->min_opponent_distance)
+            r->min_opponent_distance = d;
+        contact |= sim_push_out(&x, &y, w->opponents[j].x, w->opponents[j].y, 2 * SIM_ROBOT_RADIUS);
+    }
+
+    if(contact) {
+        if(!r->in_contact)
+            r->collisions++;
+        r->contact_time += SCHEDULER_UNIT;
+    }
+    r->in_contact = contact;
+
+    if(x != x0 || y != y0) {
+        holonomic_position_set(&r->robot.pos, x, COLOR_Y(&r->strat, y),
+                               holonomic_position_get_a_rad_double(&r->robot.pos));
+    }
+}
+
+/** Writes what the beacon of each robot sees, in the color frame. */
+static void sim_beacons(struct sim_world *w) {
+    int i;
+
+    for(i=0;i<w->nb_robots;i++) {
+        struct sim_robot *r = &w->robots[i];
+        struct beacon_com *b = &r->beacon_com;
+
+        b->frames++;
+
+        if(w->nb_opponents > 0) {
+            b->pos1X = w->opponents[0].x;
+            b->pos1Y = COLOR_Y(&r->strat, w->opponents[0].y);
+        }
+        if(w->nb_opponents > 1) {
+            b->pos2X = w->opponents[1].x;
+            b->pos2Y = COLOR_Y(&r->strat, w->opponents[1].y);
+        }
+    }
+}
+
+void sim_step(struct sim_world *w) {
+    const double dt = SCHEDULER_UNIT / 1000000.;
+    int i, j;
+
+    /* Comme l'interruption sur le robot : les threads des strategies ne
+     * modifient pas l'etat des regulations pendant le tick. */
+    CVRA_CS_LOCK();
+    sim_now += SCHEDULER_UNIT;
+
+    for(i=0;i<w->nb_robots;i++)
+        for(j=0;j<3;j++)
+            sim_motor_update(&w->robots[i].motors[j], dt);
+
+    for(i=0;i<w->nb_opponents;i++)
+        sim_opponent_update(&w->opponents[i], dt);
+
+    /* Le tick : toutes les regulations sont dans la meme table. */
+    scheduler_interrupt();
+
+    for(i=0;i<w->nb_robots;i++)
+        sim_collisions(w, i);
+
+    if(sim_now >= w->next_beacon) {
+        sim_beacons(w);
+        w->next_beacon = sim_now + SIM_BEACON_PERIOD;
+    }
+    CVRA_CS_UNLOCK();
+}
@@ -0,0 +1,185 @@
+/** @file sim.h
+ * @brief Team simulation on the PC : several robots on one table.
+ *
+ * Each simulated robot runs the real control loop and strategy code with its
+ * own struct robot_context. The harness replaces the hardware :
+ *  - the motors and encoders, by a first order model of the DC motors,
+ *    with their index and current for the self test (see selftest.h),
+ *  - the starter cord, pulled at the beginning of the simulation,
+ *  - the beacon, by writing the opponent positions in the beacon_com of
+ *    each robot at the rotation rate of the real one,
+ *  - the radio between teammates, by a link with latency and bandwidth,
+ *  - uptime_get(), by the simulated time.
+ *
+ * The odometry of a robot is taken as its real pose, there is no wheel
+ * slip. Collisions with the borders, the teammate and the opponents push the
+ * robot back out, as if the wheels slipped, and are counted. For the borders
+ * the robot is a face at SIM_ROBOT_FACE from its center, for the other robots
+ * a disc of SIM_ROBOT_RADIUS.
+ *
+ * The strategy of each robot runs in its own thread, like the foreground
+ * code of the robot, while sim_step() plays the role of the timer interrupt.
+ * The opponents follow scripted waypoints.
+ *
+ * @note Host only, see the nastya_sim target in CMakeLists.txt.
+ */
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <aversive.h>
+#include <pthread.h>
+#include <vect_base.h>
+
+#include "cvra_cs.h"
+#include "strat.h"
+#include "com_balises.h"
+#include "boot.h"
+#include "robot_link.h"
+#include "selftest.h"
+
+/** Maximum number of robots of our team. */
+#define SIM_MAX_ROBOTS 2
+
+/** Maximum number of opponents, the beacon reports two. */
+#define SIM_MAX_OPPONENTS 2
+
+/** Maximum number of waypoints of a scripted opponent. */
+#define SIM_MAX_WAYPOINTS 8
+
+/** Size of each direction of the link, in bytes. */
+#define SIM_LINK_BUFFER 1024
+
+/** Radius of the robots, ours and the opponents, in mm. Only for the
+ * contacts between robots. */
+#define SIM_ROBOT_RADIUS ROBOT_RADIUS_MM
+
+/** Distance from the center of our robots to the border they touch, in mm.
+ * The strategy drives a face against the borders, which is much closer than
+ * SIM_ROBOT_RADIUS. */
+#define SIM_ROBOT_FACE STRAT_ROBOT_THICKNESS
+
+/** Motor model : encoder ticks per second for a PWM of 1 at steady state. */
+#define SIM_MOTOR_GAIN 300.0
+
+/** Motor model : time constant, in s. */
+#define SIM_MOTOR_TAU 0.02
+
+/** Motor model : current per unit of PWM not turned into speed. */
+#define SIM_MOTOR_CURRENT_GAIN 1.0
+
+/** Motor model : friction current per unit of PWM of speed. */
+#define SIM_MOTOR_FRICTION 0.2
+
+/** Time given to each path of sim_paths(), in us. */
+#define SIM_PATH_TIMEOUT 10000000
+
+/** Period of the simulated beacon, in us. */
+#define SIM_BEACON_PERIOD 100000
+
+/** A wheel : motor, gearbox and encoder. */
+struct sim_motor {
+    int32_t pwm;        /**< Last value written by the control system. */
+    double speed;       /**< Encoder ticks per second. */
+    double position;    /**< Encoder ticks. */
+    int32_t index;      /**< Position at the last index pulse. */
+};
+
+/** One direction of the link between teammates. */
+struct sim_link_fifo {
+    uint8_t data[SIM_LINK_BUFFER];
+    int32_t arrival[SIM_LINK_BUFFER];  /**< Time at which each byte can be read. */
+    uint16_t head, tail;
+    int32_t busy_until;                /**< End of the transmission of the last byte. */
+};
+
+/** Link between two robots, with latency and bandwidth. */
+struct sim_link {
+    struct sim_link_fifo fifo[2];      /**< fifo[i] is received by the end i. */
+    int32_t latency;                   /**< In us. */
+    int32_t byte_time;                 /**< Transmission time of a byte, in us. */
+    uint32_t bytes_sent;
+    uint32_t bytes_refused;            /**< Writes refused because the fifo was full. */
+    pthread_mutex_t lock;
+};
+
+/** An end of the link, the param of a struct robot_link. */
+struct sim_link_end {
+    struct sim_link *link;
+    int side;
+};
+
+/** One of our robots. */
+struct sim_robot {
+    struct robot_context ctx;
+    struct _rob robot;
+    struct strat_info strat;
+    struct beacon_com beacon_com;
+    struct boot_hot_state hot;
+
+    struct sim_motor motors[3];
+    struct robot_link link;
+    struct sim_link_end link_end;
+    struct selftest_io selftest_io;
+
+    strat_color_t color;
+    pthread_t thread;
+
+    uint8_t in_contact;                /**< =1 while touching something. */
+    uint32_t collisions;               /**< Number of contacts. */
+    int32_t contact_time;              /**< Total time in contact, in us. */
+    double min_opponent_distance;      /**< Closest approach to an opponent, in mm. */
+};
+
+/** A scripted opponent. */
+struct sim_opponent {
+    point_t waypoints[SIM_MAX_WAYPOINTS];
+    int nb_waypoints;
+    int current;                       /**< Waypoint we are going to. */
+    double x, y;                       /**< Position, in table coordinates. */
+    double speed;                      /**< In mm/s. */
+};
+
+struct sim_world {
+    struct sim_robot robots[SIM_MAX_ROBOTS];
+    int nb_robots;
+
+    struct sim_opponent opponents[SIM_MAX_OPPONENTS];
+    int nb_opponents;
+
+    struct sim_link link;
+
+    int32_t next_beacon;               /**< Time of the next beacon update, in us. */
+};
+
+/** Inits the world, without robots nor opponents.
+ * @param [in] latency, bandwidth Link parameters, in us and bytes/s. */
+void sim_init(struct sim_world *w, int32_t latency, int32_t bandwidth);
+
+/** Adds one of our robots and inits its control loop.
+ * @param [in] start_x, start_y Starting position, see strat_info.start_x.
+ * @returns The robot, NULL if there is no room. */
+struct sim_robot *sim_add_robot(struct sim_world *w, strat_color_t color, int start_x, int start_y);
+
+/** Adds a scripted opponent looping on its waypoints, in table coordinates. */
+struct sim_opponent *sim_add_opponent(struct sim_world *w, const point_t *waypoints, int nb, double speed);
+
+/** Starts the strategy threads. */
+void sim_start(struct sim_world *w);
+
+/** Runs the self test of each robot instead of the strategy, and prints it.
+ * @returns The number of checks failed. Needs sim_step() running in another thread. */
+int sim_selftest(struct sim_world *w);
+
+/** Drives the first robot on polylines and curve chains with a corner of
+ * 90 to 170 degrees, in the middle of the table, and prints whether each
+ * one was finished within SIM_PATH_TIMEOUT.
+ * @returns The number of paths not finished. Needs sim_step() running in another thread. */
+int sim_paths(struct sim_world *w);
+
+/** Advances the world by one scheduler unit. */
+void sim_step(struct sim_world *w);
+
+/** Current simulated time, in us. */
+int32_t sim_time(void);
+
+#endif
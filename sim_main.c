@@ -0,0 +1,118 @@
+/** @file sim_main.c
+ * @brief Runs a match of our two robots against two scripted opponents.
+ *
+ * Usage : nastya_sim [speed [latency_us [bandwidth]]]
+ *         nastya_sim selftest
+ *         nastya_sim paths
+ *
+ * speed is the ratio between simulated and real time, 0 (default) runs as
+ * fast as possible. At the end of the match a table gives, for each robot,
+ * the gifts done, the collisions and the closest approach to an opponent.
+ *
+ * selftest runs the pre-match self test (see selftest.h) on the motor
+ * models instead of a match, the exit status is 1 if a check failed.
+ *
+ * paths drives one robot on paths with sharp corners (see sim_paths()), the
+ * exit status is 1 if one was not finished.
+ */
+
+#include <aversive.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fast_math.h>
+#include <scheduler.h>
+
+#include "sim.h"
+#include "fmt.h"
+#include "log.h"
+
+/** Duration of the simulation, in us : the match and a bit more. */
+#define SIM_DURATION ((MATCH_TIME + 2) * 1000000)
+
+static int (*check)(struct sim_world *w);
+static volatile int check_done;
+static int check_failed;
+
+static void *check_thread(void *param) {
+    check_failed = check(param);
+    check_done = 1;
+    return NULL;
+}
+
+/** Runs a check on one robot instead of a match, the main thread plays the timer. */
+static int run_check(struct sim_world *w, int (*f)(struct sim_world *w)) {
+    pthread_t thread;
+
+    check = f;
+    sim_add_robot(w, RED, STRAT_START_X, STRAT_START_Y);
+    pthread_create(&thread, NULL, check_thread, w);
+
+    while(!check_done) {
+        sim_step(w);
+        fmt_drain();
+    }
+    pthread_join(thread, NULL);
+    fmt_flush();
+
+    return check_failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    static struct sim_world world;
+    double speed = argc > 1 ? atof(argv[1]) : 0;
+    int32_t latency = argc > 2 ? atoi(argv[2]) : 20000;
+    int32_t bandwidth = argc > 3 ? atoi(argv[3]) : 5760;
+    int i, j, gifts;
+
+    /* Deux adversaires : un qui fait des allers-retours au milieu, un qui
+     * longe notre cote de la table. */
+    const point_t opponent0[] = {{1500, 400}, {1500, 1600}};
+    const point_t opponent1[] = {{2700, 1700}, {1000, 1700}, {1000, 1200}, {2700, 1200}};
+
+    log_init();
+    fast_math_init();
+    fmt_init();
+
+    sim_init(&world, latency, bandwidth);
+
+    if(argc > 1 && !strcmp(argv[1], "selftest"))
+        return run_check(&world, sim_selftest);
+    if(argc > 1 && !strcmp(argv[1], "paths"))
+        return run_check(&world, sim_paths);
+
+    /* Les deux robots de l'equipe partent du meme coin, l'un devant l'autre. */
+    sim_add_robot(&world, RED, STRAT_START_X, STRAT_START_Y);
+    sim_add_robot(&world, RED, STRAT_START_X + 100, STRAT_START_Y - 400);
+
+    sim_add_opponent(&world, opponent0, 2, 300);
+    sim_add_opponent(&world, opponent1, 4, 400);
+
+    sim_start(&world);
+
+    while(sim_time() < SIM_DURATION) {
+        sim_step(&world);
+        fmt_drain();
+        if(speed > 0)
+            usleep(SCHEDULER_UNIT / speed);
+    }
+
+    fmt_printf("\nrobot | gifts | collisions | contact [ms] | min opp. dist [mm]\n");
+    for(i=0;i<world.nb_robots;i++) {
+        struct sim_robot *r = &world.robots[i];
+
+        gifts = 0;
+        for(j=0;j<4;j++)
+            gifts += r->strat.gifts[j].done;
+
+        fmt_printf("%5d | %5d | %10d | %12d | %18d\n", i, gifts, (int)r->collisions,
+                   (int)(r->contact_time / 1000), (int)r->min_opponent_distance);
+    }
+    fmt_printf("link : %d bytes sent, %d refused\n",
+               (int)world.link.bytes_sent, (int)world.link.bytes_refused);
+    fmt_flush();
+
+    /* Les threads de strategie attendent peut-etre encore dans une boucle. */
+    exit(0);
+}
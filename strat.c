@@ -8,264 +8,630 @@
 #include <cvra_servo.h>
 #include <uptime.h>
 #include "adresses.h"
-
-struct strat_info strat;
+#include "path_follower.h"
+#include "avoidance.h"
+#include "obstacle_map.h"
+#include "curve.h"
+#include "boot.h"
+#include "trace.h"
+#include "busstat.h"
+#include "fmt.h"
 
 void strat_long_arm_up(void){
-        cvra_servo_set((void*)SERVOS_BASE, 1, 15000); 
+        BUS_DC(cvra_servo_set)((void*)SERVOS_BASE, 1, 15000); 
 }
 
 void strat_long_arm_down(void){
-        cvra_servo_set((void*)SERVOS_BASE, 1, 7000); 
+        BUS_DC(cvra_servo_set)((void*)SERVOS_BASE, 1, 7000); 
 }
 
 void strat_short_arm_up(void){
-        cvra_servo_set((void*)SERVOS_BASE, 0, 17000); 
+        BUS_DC(cvra_servo_set)((void*)SERVOS_BASE, 0, 17000); 
 }
 
 void strat_short_arm_down(void){
-        cvra_servo_set((void*)SERVOS_BASE, 0, 8000); 
+        BUS_DC(cvra_servo_set)((void*)SERVOS_BASE, 0, 8000); 
 }
 
 
 /** Increments the match timer, called every second. */
-static void increment_timer(__attribute__((unused))void *data) {
-    strat.time++;
+static void increment_timer(void *data) {
+    struct robot_context *ctx = data;
+    ctx->strat->time++;
 }
 
-void strat_wait_90_seconds(void)
+void strat_wait_90_seconds(struct robot_context *ctx)
 {
-    printf("Stoppping at end of 90 sec \n");
-    //while (strat.time < 90);
+    fmt_printf("Stoppping at end of 90 sec \n");
+    ctx->strat->started = 0;
+    boot_hot_clear(ctx);
+    //while (ctx->strat->time < 90);
     strat_short_arm_down();
-    cs_disable(&robot.wheel0_cs);
-    cs_disable(&robot.wheel1_cs);
-    cs_disable(&robot.wheel2_cs);
+    cvra_cs_enable(ctx, 0);
     strat_short_arm_down();
 }
 
 
-void strat_set_objects(void) {
-    memset(&strat.glasses, 0, sizeof(glass_t)*12);
-    memset(&strat.gifts, 0, sizeof(gift_t)*4);
+void strat_set_objects(struct robot_context *ctx) {
+    memset(&ctx->strat->glasses, 0, sizeof(glass_t)*12);
+    memset(&ctx->strat->gifts, 0, sizeof(gift_t)*4);
+    claim_init(&ctx->strat->claims, ctx->robot->team.id);
 
     /* Init gifts position. */ 
-    strat.gifts[0].x = 525; /* middle of the gift. */
-    strat.gifts[1].x = 1125;
-    strat.gifts[2].x = 1725;
-    strat.gifts[3].x = 2325;
+    ctx->strat->gifts[0].x = 525; /* middle of the gift. */
+    ctx->strat->gifts[1].x = 1125;
+    ctx->strat->gifts[2].x = 1725;
+    ctx->strat->gifts[3].x = 2325;
 
     /* Init glasses positions. */
-    strat.glasses[0].pos.x = 900; strat.glasses[0].pos.y = (1550);
-    strat.glasses[1].pos.x = 900; strat.glasses[1].pos.y = (1050);
-    strat.glasses[2].pos.x = 1050; strat.glasses[2].pos.y = (1200);
+    ctx->strat->glasses[0].pos.x = 900; ctx->strat->glasses[0].pos.y = (1550);
+    ctx->strat->glasses[1].pos.x = 900; ctx->strat->glasses[1].pos.y = (1050);
+    ctx->strat->glasses[2].pos.x = 1050; ctx->strat->glasses[2].pos.y = (1200);
 
     /*XXX Not sure about coordinates of 3 and 4. */
-    strat.glasses[3].pos.x = 1200; strat.glasses[3].pos.y = (1550);
-    strat.glasses[4].pos.x = 1200; strat.glasses[4].pos.y = (1050);
-    strat.glasses[5].pos.x = 1350; strat.glasses[5].pos.y = (1200);
-    strat.glasses[6].pos.x = 1650; strat.glasses[6].pos.y = (1300);
-    strat.glasses[7].pos.x = 1800; strat.glasses[7].pos.y = (1550);
-    strat.glasses[8].pos.x = 1800; strat.glasses[8].pos.y = (1050);
-    strat.glasses[9].pos.x = 1950; strat.glasses[9].pos.y = (1300);
-    strat.glasses[10].pos.x = 2100; strat.glasses[10].pos.y = (1550);
-    strat.glasses[11].pos.x = 2100; strat.glasses[11].pos.y = (1050);
+    ctx->strat->glasses[3].pos.x = 1200; ctx->strat->glasses[3].pos.y = (1550);
+    ctx->strat->glasses[4].pos.x = 1200; ctx->strat->glasses[4].pos.y = (1050);
+    ctx->strat->glasses[5].pos.x = 1350; ctx->strat->glasses[5].pos.y = (1200);
+    ctx->strat->glasses[6].pos.x = 1650; ctx->strat->glasses[6].pos.y = (1300);
+    ctx->strat->glasses[7].pos.x = 1800; ctx->strat->glasses[7].pos.y = (1550);
+    ctx->strat->glasses[8].pos.x = 1800; ctx->strat->glasses[8].pos.y = (1050);
+    ctx->strat->glasses[9].pos.x = 1950; ctx->strat->glasses[9].pos.y = (1300);
+    ctx->strat->glasses[10].pos.x = 2100; ctx->strat->glasses[10].pos.y = (1550);
+    ctx->strat->glasses[11].pos.x = 2100; ctx->strat->glasses[11].pos.y = (1050);
+}
+
+
+/** Returns the point where the robot stops in front of a gift. */
+static point_t strat_gift_approach(struct robot_context *ctx, int number) {
+    point_t p;
+    p.x = ctx->strat->gifts[number].x + COLOR_C(ctx->strat);
+    p.y = COLOR_Y(ctx->strat, 2000-140);
+    return p;
 }
 
+/** Returns the position of a place of the travel cost matrix. */
+static point_t strat_node_position(struct robot_context *ctx, int node) {
+    point_t p;
+
+    if(node == STRAT_NODE_START) {
+        p.x = holonomic_position_get_x_double(&ctx->robot->pos);
+        p.y = holonomic_position_get_y_double(&ctx->robot->pos);
+    }
+    else if(node < STRAT_NODE_GLASS(0)) {
+        p = strat_gift_approach(ctx, node - STRAT_NODE_GIFT(0));
+    }
+    else {
+        p.x = ctx->strat->glasses[node - STRAT_NODE_GLASS(0)].pos.x;
+        p.y = COLOR_Y(ctx->strat, ctx->strat->glasses[node - STRAT_NODE_GLASS(0)].pos.y);
+    }
+
+    return p;
+}
+
+/** Fills the travel cost matrix with the time of a straight move. */
+static void strat_compute_travel_costs(struct robot_context *ctx) {
+    const double v = ctx->robot->follower.max_speed;
+    const double acc = ctx->robot->follower.acceleration;
+    point_t a, b;
+    double d, t;
+    int i, j;
+
+    for(i=0;i<STRAT_NB_NODES;i++) {
+        a = strat_node_position(ctx, i);
+        for(j=0;j<STRAT_NB_NODES;j++) {
+            b = strat_node_position(ctx, j);
+            d = hypot(b.x - a.x, b.y - a.y);
+
+            /* Trapezoidal profile, or triangular for short moves. */
+            if(d > v * v / acc)
+                t = d / v + v / acc;
+            else
+                t = 2. * sqrt(d / acc);
+
+            ctx->strat->travel_cost[i][j] = (uint16_t)(t * 1000.);
+        }
+    }
+}
+
+/** Orders the gifts, always going to the cheapest one next. */
+static void strat_plan_gifts(struct robot_context *ctx) {
+    int done[4] = {0, 0, 0, 0};
+    int i, j, best, from = STRAT_NODE_START;
+
+    for(i=0;i<4;i++) {
+        best = -1;
+        for(j=0;j<4;j++) {
+            if(done[j] || ctx->strat->gifts[j].done ||
+               claim_get(&ctx->strat->claims, STRAT_NODE_GIFT(j)) == CLAIM_DONE)
+                continue;
+            if(best < 0 || ctx->strat->travel_cost[from][STRAT_NODE_GIFT(j)] <
+                           ctx->strat->travel_cost[from][STRAT_NODE_GIFT(best)])
+                best = j;
+        }
+
+        /* Gifts already done are kept at the end of the plan. */
+        if(best < 0) {
+            for(best=0;done[best];best++);
+        }
+
+        done[best] = 1;
+        ctx->strat->plan[i] = best;
+        from = STRAT_NODE_GIFT(best);
+    }
+}
+
+void strat_warmup(struct robot_context *ctx) {
+    point_t start, goal;
+    vect_t t0, t1, zero = {0, 0};
+    double chord;
+
+    strat_compute_travel_costs(ctx);
+    strat_plan_gifts(ctx);
+
+    /* Opening : leave the start zone toward the middle of the table, then
+     * arrive along the border on the first gift. */
+    start = strat_node_position(ctx, STRAT_NODE_START);
+    goal = strat_gift_approach(ctx, ctx->strat->plan[0]);
+    chord = hypot(goal.x - start.x, goal.y - start.y);
+
+    t0.x = 500 - start.x;
+    t0.y = COLOR_Y(ctx->strat, 1500) - start.y;
+    t1.x = chord;
+    t1.y = 0;
+
+    curve_quintic(&ctx->strat->opening, start, t0, zero, goal, t1, zero);
+}
+
+int strat_starter_pio(__attribute__((unused)) struct robot_context *ctx) {
+    return (BUS_IORD(BUS_PIO, PIO_BASE, 0) & 0x1000) != 0;
+}
+
+void strat_check_starter(struct robot_context *ctx) {
+    if(!ctx->strat->armed)
+        return;
+
+    if(!ctx->starter_pulled(ctx))
+        return;
+
+    /* We are in the control loop, so the move starts on this very tick. */
+    path_follower_start_curves(&ctx->robot->follower, &ctx->strat->opening, 1);
+    path_follower_set_heading(&ctx->robot->follower, COLOR_A(ctx->strat, TO_RAD(-90)));
+
+    ctx->strat->armed = 0;
+    ctx->strat->started = 1;
+}
 
 /** @todo : passe to double */
-void strat_start_position(void) {
+void strat_start_position(struct robot_context *ctx) {
     //distance centre/ coté : 88.5 mm
     //distance centre /calibre : 112.87 mm
     //épaisseur bord blanc : 100 mm
-    holonomic_position_set_x_s16(&robot.pos, 88.5);
-    holonomic_position_set_y_s16(&robot.pos,COLOR_Y(2000 - 213));
-    holonomic_position_set_a_s16(&robot.pos, COLOR_A(90));
+    CVRA_CS_LOCK();
+    holonomic_position_set_x_s16(&ctx->robot->pos, ctx->strat->start_x ? ctx->strat->start_x : STRAT_START_X);
+    holonomic_position_set_y_s16(&ctx->robot->pos,COLOR_Y(ctx->strat, ctx->strat->start_y ? ctx->strat->start_y : STRAT_START_Y));
+    holonomic_position_set_a_s16(&ctx->robot->pos, COLOR_A(ctx->strat, 90));
+    CVRA_CS_UNLOCK();
+}
 
+/* La table du scheduler est parcourue par le tick. */
+static void strat_start_timer(struct robot_context *ctx) {
+    CVRA_CS_LOCK();
+    scheduler_add_periodical_event(increment_timer, ctx, 1000000/SCHEDULER_UNIT);
+    CVRA_CS_UNLOCK();
 }
 
-void strat_begin(strat_color_t color) {
+void strat_begin(struct robot_context *ctx, strat_color_t color) {
 #ifdef COMPILE_ON_ROBOT
-    cvra_beacon_init(&robot.beacon, AVOIDING_BASE, AVOIDING_IRQ);
+    cvra_beacon_init(&ctx->robot->beacon, AVOIDING_BASE, AVOIDING_IRQ);
 #endif
     /* Starts the game timer. */
-    strat.time = 0;
-    strat.state = 0;
-    strat.sub_state = 0;
-    strat.color = color;
+    ctx->strat->time = 0;
+    ctx->strat->state = 0;
+    ctx->strat->sub_state = 0;
+    ctx->strat->color = color;
+    ctx->strat->started = 0;
+    boot_hot_clear(ctx);
     
-    strat_set_objects();
-    strat_start_position();
+    strat_set_objects(ctx);
+
+    /* Sans autopositionnement, on fait confiance a la position de depart. */
+    if (!ctx->strat->positioned)
+        strat_start_position(ctx);
+    ctx->strat->positioned = 0;
 
     strat_long_arm_down();
     strat_short_arm_down();
 
- //   holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 200, COLOR_Y(2000-300));
- //   while(!holonomic_end_of_traj(&robot.traj));
+ //   holonomic_trajectory_moving_straight_goto_xy_abs(&ctx->robot->traj, 200, COLOR_Y(ctx->strat, 2000-300));
+ //   while(!holonomic_end_of_traj(&ctx->robot->traj));
+
+    /* Use the time before the start to precompute the opening, then let the
+     * control loop watch the starter cord. */
+    strat_warmup(ctx);
+    ctx->strat->armed = 1;
+
+    while(!ctx->strat->started);
+    strat_start_timer(ctx);
+
+    /* The opening ends in front of the first gift, skip the approach. If a
+     * robot made us give up, do the approach again. */
+    if (TRAJ_SUCCESS(wait_traj_end(ctx, TRAJ_FLAGS_STD)))
+        ctx->strat->sub_state = 2;
+
+    strat_do_gift(ctx, ctx->strat->plan[ctx->strat->state]);
+    strat_wait_90_seconds(ctx);
+}
+
+void strat_resume(struct robot_context *ctx) {
+#ifdef COMPILE_ON_ROBOT
+    cvra_beacon_init(&ctx->robot->beacon, AVOIDING_BASE, AVOIDING_IRQ);
+#endif
+    ctx->strat->started = 1;
+    strat_start_timer(ctx);
+
+    /* The trajectory was lost with the reset, redo the whole gift. */
+    ctx->strat->sub_state = 0;
+    if (ctx->strat->state < 4)
+        strat_do_gift(ctx, ctx->strat->plan[ctx->strat->state]);
+    else
+        strat_wait_90_seconds(ctx);
+}
+
+/** Returns a gift which is neither done nor leased, -1 if none. The gifts
+ * with an obstacle on the way come last. */
+static int strat_leftover_gift(struct robot_context *ctx) {
+    double x = holonomic_position_get_x_double(&ctx->robot->pos);
+    double y = holonomic_position_get_y_double(&ctx->robot->pos);
+    point_t p;
+    int i, blocked = -1;
+
+    for(i=0;i<4;i++) {
+        if(ctx->strat->gifts[i].done ||
+           claim_get(&ctx->strat->claims, STRAT_NODE_GIFT(i)) != CLAIM_FREE)
+            continue;
+
+        p = strat_gift_approach(ctx, i);
+        if(obstacle_map_segment(&ctx->robot->obstacles, x, y, p.x, p.y,
+                                STRAT_PATH_CLEARANCE) < STRAT_PATH_CLEARANCE) {
+            if(blocked < 0)
+                blocked = i;
+            continue;
+        }
+        return i;
+    }
+    return blocked;
+}
+
+int test_traj_end(struct robot_context *ctx, int why) {
+    struct _rob *r = ctx->robot;
+
+    if((why & END_TIMER) && ctx->strat->time >= MATCH_TIME)
+        return END_TIMER;
+
+    /* Une pause d'evitement n'est pas une fin de trajectoire. */
+    if(avoidance_paused(&r->avoid) || r->follower.active || r->dock.state == DOCK_ACTIVE)
+        return 0;
+
+    if(!holonomic_end_of_traj(&r->traj)) {
+        if((why & END_NEAR) && holonomic_robot_in_xy_window(&r->traj, STRAT_NEAR_WINDOW))
+            return END_NEAR;
+        return 0;
+    }
+
+    /* The move was cancelled, whether the caller allows it or not. */
+    if(avoidance_gave_up(&r->avoid))
+        return END_OBSTACLE;
+
+    return END_TRAJ;
+}
 
-    while((IORD(PIO_BASE, 0) & 0x1000) == 0);
-    scheduler_add_periodical_event(increment_timer, NULL, 1000000/SCHEDULER_UNIT);
-    holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 500, COLOR_Y(1500));
-    while(!holonomic_end_of_traj(&robot.traj));
+int wait_traj_end(struct robot_context *ctx, int why) {
+    int ret;
 
-    strat_do_gift(strat.state);
-    strat_wait_90_seconds();
+    while((ret = test_traj_end(ctx, why)) == 0);
+    return ret;
 }
 
 /** 
  * @brief Do the gift
  */
-void strat_do_gift(int number) {
-    if (!strat.avoiding)
+void strat_do_gift(struct robot_context *ctx, int number) {
+    TRACE_BEGIN(TRACE_STRAT);
+    int node = STRAT_NODE_GIFT(number);
+    int from = ctx->strat->state > 0 ? STRAT_NODE_GIFT(ctx->strat->plan[ctx->strat->state - 1])
+                                     : STRAT_NODE_START;
+    int ret = END_TRAJ;
+
+    /* On ne part qu'avec le bail sur le cadeau : sinon le coequipier y va
+     * deja, ou il est fait. Devant le cadeau, on le garde. */
+    int ours = claim_try(&ctx->strat->claims, node,
+                         ctx->strat->sub_state == 0 ? ctx->strat->travel_cost[from][node] : 0);
+
+    if (ctx->strat->sub_state == 0 && ours)
     {
-        if (strat.sub_state == 0 )
+        /* Translation and rotation in a single move, no stop in between. */
+        strat_short_arm_down();
+        point_t approach = strat_gift_approach(ctx, number);
+        CVRA_CS_LOCK();
+        path_follower_goto_xya(&ctx->robot->follower, approach.x, approach.y,
+                               COLOR_A(ctx->strat, TO_RAD(-90)));
+        CVRA_CS_UNLOCK();
+        ret = wait_traj_end(ctx, TRAJ_FLAGS_STD);
+        if (TRAJ_SUCCESS(ret))
+            ctx->strat->sub_state = 2;
+    }
+    
+    /* Le coequipier a pu gagner le bail pendant l'approche. */
+    if (ctx->strat->sub_state == 2 && ours &&
+        claim_get(&ctx->strat->claims, node) == CLAIM_OURS)
+    { 
+        double x = ctx->strat->gifts[number].x + COLOR_C(ctx->strat);
+        double border = number < 3 ? 140 : 120;
+
+        /* Vite jusqu'a quelques centimetres du bord, puis sur les capteurs de
+         * distance. S'ils ne voient pas le bord, a l'odometrie. */
+        avoidance_goto_xy(&ctx->robot->avoid, x, COLOR_Y(ctx->strat, 2000 - border - STRAT_DOCK_CAPTURE));
+        ret = wait_traj_end(ctx, TRAJ_FLAGS_STD);
+
+        if (TRAJ_SUCCESS(ret) && dock_start(&ctx->robot->dock, border, x) == 0)
+            ret = wait_traj_end(ctx, TRAJ_FLAGS_STD);
+
+        if (TRAJ_SUCCESS(ret) && ctx->robot->dock.state != DOCK_DONE)
         {
-            strat_short_arm_down();
-            holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj,
-                                                        strat.gifts[number].x + COLOR_C,
-                                                         COLOR_Y(2000-140));
-            while(!holonomic_end_of_traj(&robot.traj));
-            strat.sub_state++;
+            avoidance_goto_xy(&ctx->robot->avoid, x, COLOR_Y(ctx->strat, 2000 - border));
+            ret = wait_traj_end(ctx, TRAJ_FLAGS_STD);
         }
-        
-        if (strat.sub_state == 1)
+        strat_short_arm_up();
+        if (TRAJ_SUCCESS(ret))
         {
-            holonomic_trajectory_turning_cap(&robot.traj, COLOR_A(TO_RAD(-90)));
-            while(!holonomic_end_of_traj(&robot.traj));
+            ctx->strat->gifts[number].done = 1;
+            claim_done(&ctx->strat->claims, node);
         
-            strat.sub_state++;
-        }
-        
-        if (strat.sub_state == 2)
-        { 
-            if (strat.state < 3)
-            {
-                holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj,
-                                                             strat.gifts[number].x + COLOR_C,
-                                                             COLOR_Y(2000-140));
-            }
-            else
-            {
-                holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj,
-                                                 strat.gifts[number].x + COLOR_C,
-                                                 COLOR_Y(2000-120));
-            }
-            
-            while(!holonomic_end_of_traj(&robot.traj));
-            strat_short_arm_up();
-            
             int32_t time = uptime_get();
             while(time + 500000 > uptime_get());
         }
+    }
 
-        strat.sub_state = 0;
-        strat.state++;
-        
-        if (strat.state < 4 && strat.state > -1)
-        {
-                strat_do_gift(strat.state);
-        }
-        else
-            strat_wait_90_seconds();
+    /* Bloque par un robot : on le laisse, le balayage de la fin y
+     * reviendra. */
+    if (!TRAJ_SUCCESS(ret))
+        claim_release(&ctx->strat->claims, node);
+
+    ctx->strat->sub_state = 0;
+    ctx->strat->state++;
+    TRACE_END(TRACE_STRAT);
+    
+    if (ret == END_TIMER)
+    {
+        strat_wait_90_seconds(ctx);
+    }
+    else if (ctx->strat->state < 4 && ctx->strat->state > -1)
+    {
+            strat_do_gift(ctx, ctx->strat->plan[ctx->strat->state]);
+    }
+    else if (ctx->strat->time < MATCH_TIME && (number = strat_leftover_gift(ctx)) >= 0)
+    {
+        /* Un cadeau laisse au coequipier qui n'a pas ete fait (son bail a
+         * expire), ou qu'un robot bloquait : on le refait en dernier. */
+        ctx->strat->state = 3;
+        ctx->strat->plan[3] = number;
+        strat_do_gift(ctx, number);
     }
-    strat_do_gift(strat.state);
+    else
+        strat_wait_90_seconds(ctx);
 }
 
+/** Sum of the currents of the wheels, see cmd_print_currents() for the channels. */
+static int32_t strat_wheel_current(void) {
+    int32_t c0 = BUS_DC(cvra_dc_get_current)(HEXMOTORCONTROLLER_BASE, 4);
+    int32_t c1 = BUS_DC(cvra_dc_get_current)(HEXMOTORCONTROLLER_BASE, 3);
+    int32_t c2 = BUS_DC(cvra_dc_get_current)(HEXMOTORCONTROLLER_BASE, 5);
 
-void strat_avoiding(void)
-{
-    strat.avoiding = 1;
-    
-    /** stop current traj */
-    holonomic_delete_event(&robot.traj);
-    
-    /** @strat do gift */
-    //strat_do_gift(strat.state);
-    /** to be sure stop current move */
-    rsh_set_speed(&robot.rs, 0);
-    rsh_set_rotation_speed(&robot.rs, 0);
-    cs_disable(&robot.wheel0_cs);
-    cs_disable(&robot.wheel1_cs);
-    cs_disable(&robot.wheel2_cs);
-    cvra_dc_set_pwm0(HEXMOTORCONTROLLER_BASE,0);
-    cvra_dc_set_pwm1(HEXMOTORCONTROLLER_BASE,0);
-    cvra_dc_set_pwm2(HEXMOTORCONTROLLER_BASE,0);
-    while(1);
-    
+    return (c0 < 0 ? -c0 : c0) + (c1 < 0 ? -c1 : c1) + (c2 < 0 ? -c2 : c2);
 }
 
-void strat_restart_after_avoiding(void)
-{
-    strat.avoiding = 0;
-    /** Si on etait en train de faire des cadeaux */
-    if (strat.state < 4)
-        strat_do_gift(strat.state);
-    else
-        strat_wait_90_seconds();
+static void strat_set_wheel_gains(struct robot_context *ctx, int soft) {
+    struct _rob *r = ctx->robot;
+    CVRA_CS_LOCK();
+
+    if(soft) {
+        pid_set_gains(&r->wheel0_pid, STRAT_AUTOPOS_PID_P, 0, 0);
+        pid_set_gains(&r->wheel1_pid, STRAT_AUTOPOS_PID_P, 0, 0);
+        pid_set_gains(&r->wheel2_pid, STRAT_AUTOPOS_PID_P, 0, 0);
+        CVRA_CS_UNLOCK();
+        return;
+    }
+
+    /* Les PID repartent de zero, sinon le changement de gain donne un coup. */
+    pid_reset(&r->wheel0_pid);
+    pid_reset(&r->wheel1_pid);
+    pid_reset(&r->wheel2_pid);
+    pid_set_gains(&r->wheel0_pid, ROBOT_PID_WHEEL0_P, ROBOT_PID_WHEEL0_I, ROBOT_PID_WHEEL0_D);
+    pid_set_gains(&r->wheel1_pid, ROBOT_PID_WHEEL1_P, ROBOT_PID_WHEEL1_I, ROBOT_PID_WHEEL1_D);
+    pid_set_gains(&r->wheel2_pid, ROBOT_PID_WHEEL2_P, ROBOT_PID_WHEEL2_I, ROBOT_PID_WHEEL2_D);
+    CVRA_CS_UNLOCK();
+}
+
+int strat_autopos(struct robot_context *ctx, int16_t x, int16_t y, int16_t a, int16_t epaisseurRobot) {
+    struct _rob *r = ctx->robot;
+    double past_x[STRAT_AUTOPOS_BLOCK_SAMPLES], past_y[STRAT_AUTOPOS_BLOCK_SAMPLES];
+    double wall_x, wall_y, dir_x, dir_y, cx, cy, first_a = 0, drift;
+    int32_t start, now, current, free_current = 0;
+    int i, n, free_samples = 0, high;
+    int contact_x = 0, contact_y = 0, blocked_x = 0, blocked_y = 0;
+    uint8_t orca_enabled = r->orca.enabled;
+
+    y = COLOR_Y(ctx->strat, y);
+    a = COLOR_A(ctx->strat, a);
+
+    /* Le coin le plus proche de la position de depart. */
+    wall_x = x < TABLE_X_MM / 2 ? 0 : TABLE_X_MM;
+    wall_y = y < TABLE_Y_MM / 2 ? 0 : TABLE_Y_MM;
+    dir_x = wall_x == 0 ? -1 : 1;
+    dir_y = wall_y == 0 ? -1 : 1;
+
+    fmt_printf("Autopos toward %d %d\n", (int)wall_x, (int)wall_y);
+
+    {
+        CVRA_CS_LOCK();
+        path_follower_stop(&r->follower);
+        holonomic_delete_event(&r->traj);
+        orca_enable(&r->orca, 0);
+        r->is_aligning = 1;
+        CVRA_CS_UNLOCK();
+    }
+    strat_set_wheel_gains(ctx, 1);
+
+    start = now = uptime_get();
+    for(n=0;!(contact_x && contact_y) && now - start < STRAT_AUTOPOS_TIMEOUT;n++) {
+        /* En diagonale dans le coin, sans tourner : les gains mous laissent
+         * la face se plaquer sur le premier mur, puis glisser le long. */
+        CVRA_CS_LOCK();
+        holonomic_set_world_velocity(&r->rs, &r->pos, STRAT_AUTOPOS_SPEED, atan2(dir_y, dir_x), 0);
+        CVRA_CS_UNLOCK();
+
+        while(uptime_get() - now < STRAT_AUTOPOS_PERIOD);
+        now = uptime_get();
+
+        cx = holonomic_position_get_x_double(&r->pos);
+        cy = holonomic_position_get_y_double(&r->pos);
+        current = strat_wheel_current();
+        i = n % STRAT_AUTOPOS_BLOCK_SAMPLES;
+
+        if(now - start < STRAT_AUTOPOS_FREE_TIME) {
+            free_current += current;
+            free_samples++;
+        }
+        else if(n >= STRAT_AUTOPOS_BLOCK_SAMPLES) {
+            /* Bloque : on n'avance plus vers le mur depuis une fenetre. Le
+             * courant le confirme tout de suite, sans lui il faut attendre
+             * une deuxieme fenetre. */
+            blocked_x = dir_x * (cx - past_x[i]) < STRAT_AUTOPOS_BLOCK_DIST ? blocked_x + 1 : 0;
+            blocked_y = dir_y * (cy - past_y[i]) < STRAT_AUTOPOS_BLOCK_DIST ? blocked_y + 1 : 0;
+            high = free_samples > 0 &&
+                   current * 100 > free_current / free_samples * STRAT_AUTOPOS_CURRENT_PCT;
+
+            /* Plaque sur le premier mur, le cap vrai est a : on garde le cap
+             * de l'odometrie a cet instant comme reference. */
+            if(!contact_x && !contact_y)
+                first_a = holonomic_position_get_a_rad_double(&r->pos);
+
+            if(!contact_x && blocked_x && (high || blocked_x >= STRAT_AUTOPOS_BLOCK_SAMPLES)) {
+                contact_x = 1;
+                cx = wall_x - dir_x * epaisseurRobot;
+                CVRA_CS_LOCK();
+                holonomic_position_set(&r->pos, cx, cy, holonomic_position_get_a_rad_double(&r->pos));
+                CVRA_CS_UNLOCK();
+            }
+            if(!contact_y && blocked_y && (high || blocked_y >= STRAT_AUTOPOS_BLOCK_SAMPLES)) {
+                contact_y = 1;
+                cy = wall_y - dir_y * epaisseurRobot;
+                CVRA_CS_LOCK();
+                holonomic_position_set(&r->pos, cx, cy, holonomic_position_get_a_rad_double(&r->pos));
+                CVRA_CS_UNLOCK();
+            }
+        }
+
+        past_x[i] = cx;
+        past_y[i] = cy;
+    }
+
+    {
+        CVRA_CS_LOCK();
+        rsh_set_speed(&r->rs, 0);
+        strat_set_wheel_gains(ctx, 0);
+        r->is_aligning = 0;
+        orca_enable(&r->orca, orca_enabled);
+        CVRA_CS_UNLOCK();
+    }
+
+    if(!(contact_x && contact_y)) {
+        fmt_printf("Autopos failed, walls found : x %d, y %d\n", contact_x, contact_y);
+        return -1;
+    }
+
+    /* Le cap est a au premier contact, plus ce que l'odometrie a vu tourner
+     * en glissant jusqu'au second. */
+    drift = holonomic_position_get_a_rad_double(&r->pos) - first_a;
+    drift = atan2(sin(drift), cos(drift));
+    if(fabs(drift) > STRAT_AUTOPOS_MAX_DRIFT)
+        fmt_printf("Autopos : turned by %d deg between the walls\n", (int)(drift * 180 / M_PI));
+
+    {
+        CVRA_CS_LOCK();
+        holonomic_position_set(&r->pos, cx, cy, TO_RAD(a) + drift);
+        ctx->strat->positioned = 1;
+        path_follower_goto_xya(&r->follower, x, y, TO_RAD(a));
+        CVRA_CS_UNLOCK();
+    }
+    wait_traj_end(ctx, TRAJ_FLAGS_STD & ~END_TIMER);
+
+    fmt_printf("Autopos done in %d ms\n", (int)((uptime_get() - start) / 1000));
+    return 0;
 }
 
 /** Rigid calibrating for the holonomic_robot 
  *  Must be called near the calibration stop, and 
  * no trajectory must be running */
-void strat_do_calibration(void)
+void strat_do_calibration(struct robot_context *ctx)
 {
-    printf("Start calibration\n");
+    fmt_printf("Start calibration\n");
     /** Go to the right position */
-    holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 700, COLOR_Y(200));
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_moving_straight_goto_xy_abs(&ctx->robot->traj, 700, COLOR_Y(ctx->strat, 200));
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
 
-    holonomic_trajectory_turning_cap(&robot.traj, 0);
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_turning_cap(&ctx->robot->traj, 0);
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
 
-    holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 700, COLOR_Y(200));
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_moving_straight_goto_xy_abs(&ctx->robot->traj, 700, COLOR_Y(ctx->strat, 200));
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
 
     
     /** Calibration */
-    pid_set_gains(&robot.wheel0_pid, 5, 0, 0);
-    pid_set_gains(&robot.wheel1_pid, 5, 0, 0);
-    pid_set_gains(&robot.wheel2_pid, 5, 0, 0);
+    pid_set_gains(&ctx->robot->wheel0_pid, 5, 0, 0);
+    pid_set_gains(&ctx->robot->wheel1_pid, 5, 0, 0);
+    pid_set_gains(&ctx->robot->wheel2_pid, 5, 0, 0);
     
-    rsh_set_speed(&robot.rs, 50);
-    rsh_set_direction(&robot.rs, -M_PI_2);
+    rsh_set_speed(&ctx->robot->rs, 50);
+    rsh_set_direction(&ctx->robot->rs, -M_PI_2);
     
-    int normal_x_2 = 15 * cvra_dc_get_current(HEXMOTORCONTROLLER_BASE, 3);
+    int normal_x_2 = 15 * BUS_DC(cvra_dc_get_current)(HEXMOTORCONTROLLER_BASE, 3);
     
     /** Wheel  is the most affected since in the right direction */
-    while(cvra_dc_get_current(HEXMOTORCONTROLLER_BASE, 3) < normal_x_2); //TODO : timeout
+    while(BUS_DC(cvra_dc_get_current)(HEXMOTORCONTROLLER_BASE, 3) < normal_x_2); //TODO : timeout
     
     
-    holonomic_position_set(&robot.pos,holonomic_position_get_x_double(&robot.pos), 88.5, 0);
-    rsh_set_speed(&robot.rs, 0);
+    holonomic_position_set(&ctx->robot->pos,holonomic_position_get_x_double(&ctx->robot->pos), 88.5, 0);
+    rsh_set_speed(&ctx->robot->rs, 0);
     
-    holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 700, COLOR_Y(200));
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_moving_straight_goto_xy_abs(&ctx->robot->traj, 700, COLOR_Y(ctx->strat, 200));
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
 
-    holonomic_trajectory_turning_cap(&robot.traj, 0);
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_turning_cap(&ctx->robot->traj, 0);
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
     
 
     int i;
     int32_t time;
 
     for (i = 3; i >= 1; i--){
-        pid_set_gains(&robot.wheel0_pid, ROBOT_PID_WHEEL0_P/i, ROBOT_PID_WHEEL0_I/i,ROBOT_PID_WHEEL0_D/i);
-        pid_set_gains(&robot.wheel1_pid, ROBOT_PID_WHEEL1_P/i, ROBOT_PID_WHEEL1_I/i,ROBOT_PID_WHEEL1_D/i);
-        pid_set_gains(&robot.wheel2_pid, ROBOT_PID_WHEEL2_P/i, ROBOT_PID_WHEEL2_I/i,ROBOT_PID_WHEEL2_D/i);
+        pid_set_gains(&ctx->robot->wheel0_pid, ROBOT_PID_WHEEL0_P/i, ROBOT_PID_WHEEL0_I/i,ROBOT_PID_WHEEL0_D/i);
+        pid_set_gains(&ctx->robot->wheel1_pid, ROBOT_PID_WHEEL1_P/i, ROBOT_PID_WHEEL1_I/i,ROBOT_PID_WHEEL1_D/i);
+        pid_set_gains(&ctx->robot->wheel2_pid, ROBOT_PID_WHEEL2_P/i, ROBOT_PID_WHEEL2_I/i,ROBOT_PID_WHEEL2_D/i);
 
         time = uptime_get();
         while(time + 50000 > uptime_get());
     }
     
-    pid_set_gains(&robot.wheel0_pid, ROBOT_PID_WHEEL0_P, ROBOT_PID_WHEEL0_I,ROBOT_PID_WHEEL0_D);
-    pid_set_gains(&robot.wheel1_pid, ROBOT_PID_WHEEL1_P, ROBOT_PID_WHEEL1_I,ROBOT_PID_WHEEL1_D);
-    pid_set_gains(&robot.wheel2_pid, ROBOT_PID_WHEEL2_P, ROBOT_PID_WHEEL2_I,ROBOT_PID_WHEEL2_D);
+    pid_set_gains(&ctx->robot->wheel0_pid, ROBOT_PID_WHEEL0_P, ROBOT_PID_WHEEL0_I,ROBOT_PID_WHEEL0_D);
+    pid_set_gains(&ctx->robot->wheel1_pid, ROBOT_PID_WHEEL1_P, ROBOT_PID_WHEEL1_I,ROBOT_PID_WHEEL1_D);
+    pid_set_gains(&ctx->robot->wheel2_pid, ROBOT_PID_WHEEL2_P, ROBOT_PID_WHEEL2_I,ROBOT_PID_WHEEL2_D);
     
-    holonomic_trajectory_moving_straight_goto_xy_abs(&robot.traj, 700, COLOR_Y(200));
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_moving_straight_goto_xy_abs(&ctx->robot->traj, 700, COLOR_Y(ctx->strat, 200));
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
 
-    holonomic_trajectory_turning_cap(&robot.traj,0);
-    while(!holonomic_end_of_traj(&robot.traj));
+    holonomic_trajectory_turning_cap(&ctx->robot->traj,0);
+    while(!holonomic_end_of_traj(&ctx->robot->traj));
 
-    printf("End of Calibration\n");
+    fmt_printf("End of Calibration\n");
 }
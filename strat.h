@@ -24,6 +24,9 @@
 #include <aversive.h>
 #include <vect_base.h>
 
+#include "curve.h"
+#include "claim.h"
+
 /** Duration of a match in seconds. */
 #define MATCH_TIME 89
 
@@ -46,17 +49,56 @@
  */
 #define TRAJ_FLAGS_NEAR (TRAJ_FLAGS_STD|END_NEAR)
 
+/** Distance to the destination at which END_NEAR is returned, in mm. */
+#define STRAT_NEAR_WINDOW 50.
+
+/** Distance to the gift position from which the robot docks on the sensors, in mm. */
+#define STRAT_DOCK_CAPTURE 40
+
+/** A path closer than this to an obstacle is blocked, in mm. */
+#define STRAT_PATH_CLEARANCE 200.
+
 /** This enum is used for specifying a team color. */
 typedef enum {RED, BLUE} strat_color_t;
 
-/** Computes the symmetrical position depending on color. */ 
-#define COLOR_Y(x) (strat.color == RED ? (x) : 2000 - (x))
+/** Computes the symmetrical position depending on the color of strat s. */ 
+#define COLOR_Y(s, x) ((s)->color == RED ? (x) : 2000 - (x))
 
-/** Computes the symmetrical angle depending on color. */
-#define COLOR_A(x) (strat.color == RED ? (x) : -(x))
+/** Computes the symmetrical angle depending on the color of strat s. */
+#define COLOR_A(s, x) ((s)->color == RED ? (x) : -(x))
 
 /** Computes correctional value for the servo position */
-#define COLOR_C (strat.color == BLUE ? (20) : -(20))
+#define COLOR_C(s) ((s)->color == BLUE ? (20) : -(20))
+
+/** Default starting position, in mm (Y before COLOR_Y). */
+#define STRAT_START_X 88
+#define STRAT_START_Y (2000 - 213)
+
+/** Distance between the center of the robot and its sides, in mm. */
+#define STRAT_ROBOT_THICKNESS 88
+
+/** Auto positioning : pushing speed and detection of the walls. */
+#define STRAT_AUTOPOS_SPEED         100      /**< mm/s */
+#define STRAT_AUTOPOS_TIMEOUT       5000000  /**< us */
+#define STRAT_AUTOPOS_PERIOD        20000    /**< us, sampling of the contacts. */
+#define STRAT_AUTOPOS_FREE_TIME     300000   /**< us, to measure the free current. */
+#define STRAT_AUTOPOS_BLOCK_SAMPLES 8        /**< Blocked window, in periods. */
+#define STRAT_AUTOPOS_BLOCK_DIST    2.       /**< mm moved toward a blocked wall. */
+#define STRAT_AUTOPOS_CURRENT_PCT   150      /**< Current of a contact, in % of the free current. */
+#define STRAT_AUTOPOS_PID_P         5        /**< Soft gains, to square on the walls. */
+#define STRAT_AUTOPOS_MAX_DRIFT     0.05     /**< rad turned between the contacts before a warning. */
+
+/** Number of places in the travel cost matrix : start, gifts and glasses. */
+#define STRAT_NB_NODES 17
+
+/** Index of the starting position in the travel cost matrix. */
+#define STRAT_NODE_START 0
+
+/** Index of the first gift in the travel cost matrix. */
+#define STRAT_NODE_GIFT(i) (1 + (i))
+
+/** Index of the first glass in the travel cost matrix. */
+#define STRAT_NODE_GLASS(i) (5 + (i))
 
 /**
  * @brief A glass on the table.
@@ -99,65 +141,130 @@ struct strat_info {
     /** Save the state for the strategical finite state machine */
     int state; /** Currently the gift we are working one  (in the future)*/
     int sub_state;
-    int avoiding;
 
     int time; /**< Time since the beginning of the match, in seconds. */
 
+    /** @brief Estimated travel time between two places, in ms.
+     * Indexed with STRAT_NODE_START, STRAT_NODE_GIFT and STRAT_NODE_GLASS.
+     * Computed by strat_warmup() before the match. */
+    uint16_t travel_cost[STRAT_NB_NODES][STRAT_NB_NODES];
+
+    int plan[4];          /**< Order in which the gifts are done. */
+
+    /** Objectives leased by us or by the teammate, and the ones done.
+     * Consulted before going to an objective, see claim.h. */
+    struct claim_table claims;
+    struct curve opening; /**< First move of the match, from the start to the first gift. */
+
+    volatile int armed;   /**< =1 while waiting for the starter cord. */
+    volatile int started; /**< =1 once the starter cord was pulled. */
+
+    /** Starting position (Y before COLOR_Y), 0 for STRAT_START_X/Y. Lets
+     * two simulated robots start side by side. */
+    int start_x, start_y;
+
+    /** =1 once strat_autopos() set the position from the walls. */
+    int positioned;
+
     /* Configuration flags. */
     /** =1 If we should take the 1st glass on the left side, 0 if we take it on the right.*/
     int take_1st_glass_left;
 };
 
-/** This global var holds everything related to the strat. */
+/** The strat of the robot build, see default_context. */
 extern struct strat_info strat;
 
+struct robot_context;
+
 /** Auto positions the robot before the match. 
  *
  * This function positions the robot using the border as references. The
  * color is assumed to be already configured.
+ *
+ * The robot drives diagonally into the corner closest to (x, y), keeping
+ * the heading a with soft wheel gains : the first wall squares the robot
+ * on it, then the robot slides along it into the second one. Each contact
+ * is found when the odometry stops moving toward the wall while the motor
+ * currents rise, and gives one coordinate.
+ *
+ * The heading is not measured on the walls : it is assumed that the face
+ * is flush with the first wall at its contact, so the true heading is a
+ * there. The heading at the end is a plus the rotation the odometry saw
+ * between the two contacts, a warning is printed above
+ * STRAT_AUTOPOS_MAX_DRIFT. The robot then goes to (x, y, a).
  * 
- * @param [in] x, y The starting coordinates, in mm.
- * @param [in] a The starting angle relative to the X-axis, in degrees. 
- * @param epaisseurRobot The distamce between the back of the robot and the wheel axis. 
+ * @param [in] x, y The starting coordinates, in mm (Y before COLOR_Y).
+ * @param [in] a The starting angle relative to the X-axis, in degrees,
+ * before COLOR_A. A face of the robot must be parallel to each wall.
+ * @param epaisseurRobot The distance between the faces touching the walls and the center of the robot, in mm.
+ * @returns 0 on success, -1 if a wall was not found within
+ * STRAT_AUTOPOS_TIMEOUT. The robot then stays where it is, only the
+ * coordinate of the wall found is set.
  */
-void strat_autopos(int16_t x, int16_t y, int16_t a, int16_t epaisseurRobot);
+int strat_autopos(struct robot_context *ctx, int16_t x, int16_t y, int16_t a, int16_t epaisseurRobot);
 
 /** Tests for end of trajectory.
  *
  * @param [in] why The allowed reasons for this function to return true.
  * @returns An error code indicating the reason of the end of the trajectory.
  */
-int test_traj_end(int why);
+int test_traj_end(struct robot_context *ctx, int why);
 
 /** Waits for the end of a trajectory.
  *
  * @param [in] why The allowed reasons to end the trajectory.
  * @returns An error code indicating the reason of the end of the trajectory.
  */
-int wait_traj_end(int why);
+int wait_traj_end(struct robot_context *ctx, int why);
 
 /** @brief Inits the object positions in the strat_info_t structure.
  * @note This function supposes the color has \a already been set.
  * @sa strat_info
  */
-void strat_set_objects(void);
+void strat_set_objects(struct robot_context *ctx);
+
+/** @brief Prepares everything the start of the match needs.
+ *
+ * This computes the travel cost matrix, the opening plan and the opening
+ * trajectory, so that the first move can start as soon as the cord is
+ * pulled. It is called while waiting for the starter.
+ * @note The color, objects and start position must be set.
+ */
+void strat_warmup(struct robot_context *ctx);
+
+/** @brief Starts the opening move when the starter cord is pulled.
+ *
+ * Called at every control tick, does nothing unless the strategy was armed
+ * by strat_begin().
+ */
+void strat_check_starter(struct robot_context *ctx);
+
+/** Reads the starter cord on the PIO, the starter_pulled of the robot build. */
+int strat_starter_pio(struct robot_context *ctx);
+
+/** @brief Resumes a match after a hot restart.
+ *
+ * The strategy state must have been restored by boot_hot_restore(). The
+ * current gift is restarted from its approach.
+ */
+void strat_resume(struct robot_context *ctx);
 
 /** @brief Starts a match
  *
  * This function starts the match. It will \a not check for the starting cord
  * so the caller should do it.
  */
-void strat_begin(strat_color_t color);
+void strat_begin(struct robot_context *ctx, strat_color_t color);
 
 
 
-void strat_do_gift(int number);
+void strat_do_gift(struct robot_context *ctx, int number);
+void strat_start_position(struct robot_context *ctx);
+void strat_wait_90_seconds(struct robot_context *ctx);
+void strat_do_calibration(struct robot_context *ctx);
 void strat_long_arm_up(void);
 void strat_long_arm_down(void);
 void strat_short_arm_up(void);
 void strat_short_arm_down(void);
 
-void strat_avoiding(void);
-void strat_restart_after_avoiding(void);
-
 #endif
@@ -0,0 +1,283 @@
+/** @file team_sync.c
+ * @brief World model shared with the teammate.
+ * @sa team_sync.h for the frame format.
+ */
+
+#include <aversive.h>
+#include <string.h>
+#include <scheduler.h>
+#include <uptime.h>
+#include <holonomic/position_manager.h>
+
+#include "cvra_cs.h"
+#include "strat.h"
+#include "com_balises.h"
+#include "robot_link.h"
+#include "claim.h"
+#include "team_sync.h"
+
+void team_sync_init(struct team_sync *t, struct robot_context *ctx) {
+    memset(t, 0, sizeof(struct team_sync));
+    t->ctx = ctx;
+    t->budget = TEAM_SYNC_BUDGET;
+    t->peer_time = uptime_get() - TEAM_SYNC_TIMEOUT;
+
+    scheduler_add_periodical_event_priority(team_sync_manage, t,
+            TEAM_SYNC_PERIOD / SCHEDULER_UNIT, 60);
+}
+
+void team_sync_set_budget(struct team_sync *t, int32_t bytes_per_second) {
+    t->budget = bytes_per_second;
+}
+
+/** Our own state, as the teammate should see it. */
+static void team_sync_fill(struct team_sync *t, struct team_state *s) {
+    struct robot_context *ctx = t->ctx;
+    uint16_t done, cost = 0;
+    int i;
+
+    s->f[TEAM_X] = holonomic_position_get_x_s16(&ctx->robot->pos);
+    s->f[TEAM_Y] = holonomic_position_get_y_s16(&ctx->robot->pos);
+    s->f[TEAM_A] = holonomic_position_get_a_rad_double(&ctx->robot->pos) * 1000;
+
+    s->f[TEAM_LEASE] = claim_lease(&ctx->strat->claims, &cost);
+    s->f[TEAM_COST] = cost;
+
+    done = claim_done_mask(&ctx->strat->claims);
+    for(i=0;i<4;i++)
+        if(ctx->strat->gifts[i].done)
+            done |= 1 << (STRAT_NODE_GIFT(i) - 1);
+    for(i=0;i<12;i++)
+        if(ctx->strat->glasses[i].taken)
+            done |= 1 << (STRAT_NODE_GLASS(i) - 1);
+    s->f[TEAM_DONE] = done;
+
+    s->f[TEAM_OPP1_X] = ctx->beacon_com->pos1X;
+    s->f[TEAM_OPP1_Y] = ctx->beacon_com->pos1Y;
+    s->f[TEAM_OPP2_X] = ctx->beacon_com->pos2X;
+    s->f[TEAM_OPP2_Y] = ctx->beacon_com->pos2Y;
+}
+
+/** Zigzag : small values of both signs get small codes. */
+static uint8_t *team_put_varint(uint8_t *p, int16_t v) {
+    uint16_t z = ((uint16_t)v << 1) ^ (uint16_t)(v >> 15);
+
+    while(z >= 0x80) {
+        *p++ = (z & 0x7f) | 0x80;
+        z >>= 7;
+    }
+    *p++ = z;
+    return p;
+}
+
+/** @returns The byte after the integer, NULL if it goes past end. */
+static const uint8_t *team_get_varint(const uint8_t *p, const uint8_t *end, int16_t *v) {
+    uint16_t z = 0;
+    int shift = 0;
+
+    do {
+        if(p >= end || shift > 14)
+            return NULL;
+        z |= (uint16_t)(*p & 0x7f) << shift;
+        shift += 7;
+    } while(*p++ & 0x80);
+
+    *v = (int16_t)((z >> 1) ^ -(z & 1));
+    return p;
+}
+
+static uint8_t team_checksum(const uint8_t *data, int len) {
+    uint8_t sum = 0;
+    while(len--)
+        sum += *data++;
+    return sum;
+}
+
+static void team_sync_send(struct team_sync *t) {
+    static const struct team_state zero;
+    struct robot_link *link = t->ctx->link;
+    const struct team_state *base = &zero;
+    struct team_state cur;
+    uint8_t frame[TEAM_SYNC_HEADER_LEN + TEAM_SYNC_MAX_PAYLOAD + 1];
+    uint8_t *p = frame + TEAM_SYNC_HEADER_LEN;
+    uint8_t seq = t->seq + 1;
+    uint16_t mask = 0;
+    int32_t now = uptime_get();
+    int i, len;
+
+    if(seq == 0)
+        seq = 1;
+
+    /* The teammate only keeps its last states, the deltas are against the
+     * zero state if ours is too old. */
+    if(t->acked && (uint8_t)(seq - t->acked) < TEAM_SYNC_HISTORY &&
+       t->sent[t->acked % TEAM_SYNC_HISTORY].seq == t->acked)
+        base = &t->sent[t->acked % TEAM_SYNC_HISTORY];
+
+    team_sync_fill(t, &cur);
+
+    for(i=0;i<TEAM_NB_FIELDS;i++) {
+        int16_t d = (int16_t)(cur.f[i] - base->f[i]);
+        if(d) {
+            mask |= 1 << i;
+            p = team_put_varint(p, d);
+        }
+    }
+
+    /* Rien de neuf : on n'envoie que de temps en temps, pour les acks. */
+    if(!mask && base != &zero && now - t->last_sent < TEAM_SYNC_HEARTBEAT)
+        return;
+
+    len = p - frame + 1;
+    if(t->tokens < len * 1000)
+        return;
+
+    frame[0] = TEAM_SYNC_START;
+    frame[1] = seq;
+    frame[2] = t->peer_seq;
+    frame[3] = base->seq;
+    frame[4] = mask >> 8;
+    frame[5] = mask & 0xff;
+    frame[6] = p - frame - TEAM_SYNC_HEADER_LEN;
+    *p = team_checksum(frame + 1, len - 2);
+
+    if(link->write(link->param, frame, len) != len)
+        return;
+
+    cur.seq = seq;
+    t->sent[seq % TEAM_SYNC_HISTORY] = cur;
+    t->seq = seq;
+    t->last_sent = now;
+    t->tokens -= len * 1000;
+    t->bytes_sent += len;
+    t->frames_sent++;
+}
+
+static void team_sync_decode(struct team_sync *t) {
+    static const struct team_state zero;
+    const uint8_t *p = t->frame + TEAM_SYNC_HEADER_LEN;
+    const uint8_t *end = p + t->frame[6];
+    const struct team_state *base = &zero;
+    struct team_state s;
+    uint8_t seq = t->frame[1], ack = t->frame[2], base_seq = t->frame[3];
+    uint16_t mask = (t->frame[4] << 8) | t->frame[5];
+    int i;
+
+    if(team_checksum(t->frame + 1, end - t->frame - 1) != *end || seq == 0) {
+        t->frames_bad++;
+        return;
+    }
+
+    if(base_seq) {
+        base = &t->received[base_seq % TEAM_SYNC_HISTORY];
+        /* Base perdue : le coequipier repassera a l'etat zero. */
+        if(base->seq != base_seq) {
+            t->frames_bad++;
+            return;
+        }
+    }
+
+    for(i=0;i<TEAM_NB_FIELDS;i++) {
+        int16_t d = 0;
+        if(mask & (1 << i)) {
+            p = team_get_varint(p, end, &d);
+            if(p == NULL) {
+                t->frames_bad++;
+                return;
+            }
+        }
+        s.f[i] = base->f[i] + d;
+    }
+    s.seq = seq;
+
+    t->received[seq % TEAM_SYNC_HISTORY] = s;
+    t->peer_seq = seq;
+    t->peer_time = uptime_get();
+    t->frames_received++;
+
+    if(ack && t->sent[ack % TEAM_SYNC_HISTORY].seq == ack)
+        t->acked = ack;
+
+    claim_update_peer(&t->ctx->strat->claims, s.f[TEAM_LEASE],
+                      (uint16_t)s.f[TEAM_COST], (uint16_t)s.f[TEAM_DONE]);
+}
+
+static void team_sync_input_char(struct team_sync *t, uint8_t c) {
+    if(t->frame_pos == 0 && c != TEAM_SYNC_START)
+        return;
+
+    t->frame[t->frame_pos++] = c;
+
+    if(t->frame_pos == TEAM_SYNC_HEADER_LEN && t->frame[6] > TEAM_SYNC_MAX_PAYLOAD) {
+        t->frames_bad++;
+        t->frame_pos = 0;
+        return;
+    }
+
+    if(t->frame_pos > TEAM_SYNC_HEADER_LEN &&
+       t->frame_pos == TEAM_SYNC_HEADER_LEN + t->frame[6] + 1) {
+        team_sync_decode(t);
+        t->frame_pos = 0;
+    }
+}
+
+void team_sync_manage(void *data) {
+    struct team_sync *t = data;
+    struct robot_link *link = t->ctx->link;
+    uint8_t buf[32];
+    int32_t cap;
+    int i, n;
+
+    if(link == NULL)
+        return;
+
+    while((n = link->read(link->param, buf, sizeof(buf))) > 0)
+        for(i=0;i<n;i++)
+            team_sync_input_char(t, buf[i]);
+
+    /* Seau a jetons, en milliemes d'octet pour les petits budgets : au plus
+     * une demi-seconde de budget d'avance, mais toujours une trame entiere. */
+    cap = t->budget / 2;
+    if(cap < TEAM_SYNC_HEADER_LEN + TEAM_SYNC_MAX_PAYLOAD + 1)
+        cap = TEAM_SYNC_HEADER_LEN + TEAM_SYNC_MAX_PAYLOAD + 1;
+    t->tokens += t->budget * (TEAM_SYNC_PERIOD / 1000);
+    if(t->tokens > cap * 1000)
+        t->tokens = cap * 1000;
+
+    team_sync_send(t);
+}
+
+int team_sync_peer_alive(struct team_sync *t) {
+    return t->peer_seq && uptime_get() - t->peer_time < TEAM_SYNC_TIMEOUT;
+}
+
+const struct team_state *team_sync_peer(struct team_sync *t) {
+    if(!team_sync_peer_alive(t))
+        return NULL;
+    return &t->received[t->peer_seq % TEAM_SYNC_HISTORY];
+}
+
+int team_sync_get_tracks(struct team_sync *t, point_t *points, int max) {
+    const struct team_state *p = team_sync_peer(t);
+    int n = 0, i;
+
+    if(p == NULL)
+        return 0;
+
+    if(n < max) {
+        points[n].x = p->f[TEAM_X];
+        points[n].y = p->f[TEAM_Y];
+        n++;
+    }
+
+    /* Une balise qui ne voit rien donne (0, 0). */
+    for(i=TEAM_OPP1_X;i<=TEAM_OPP2_X && n < max;i+=2) {
+        if(p->f[i] == 0 && p->f[i+1] == 0)
+            continue;
+        points[n].x = p->f[i];
+        points[n].y = p->f[i+1];
+        n++;
+    }
+
+    return n;
+}
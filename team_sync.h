@@ -0,0 +1,129 @@
+/** @file team_sync.h
+ * @brief World model shared with the teammate over the robot link.
+ *
+ * Each robot sends a small state to its teammate : its pose, the lease it
+ * holds and the objectives done (see claim.h) and the opponents its beacon
+ * sees. To fit in a few hundred bytes per second, only the fields which
+ * changed since the last state acknowledged by the teammate are sent, as
+ * differences.
+ *
+ * Frame (big endian) :
+ *
+ *     0xA8 | seq | ack | base | mask (uint16) | len | payload[len] | checksum
+ *
+ *  - seq numbers the frames we send, from 1. 0 is the zero state.
+ *  - ack is the last seq received from the teammate, 0 if none.
+ *  - base is the seq of the state the deltas are computed against : the
+ *    last of our states acknowledged by the teammate, or 0 if it is too old
+ *    or if there was none (the deltas are then the values).
+ *  - bit i of mask is set if field i is in the payload.
+ *  - each field present is a zigzag encoded variable length integer, 7 bits
+ *    per byte, low bits first : a field which moved by less than 64 takes a
+ *    single byte.
+ *  - checksum is the sum of all the bytes after the start byte, modulo 256.
+ *
+ * The sender keeps the last TEAM_SYNC_HISTORY states it sent and the
+ * receiver the last TEAM_SYNC_HISTORY states it decoded, so a lost frame
+ * only costs the deltas being computed against an older base.
+ */
+#ifndef _TEAM_SYNC_H_
+#define _TEAM_SYNC_H_
+
+#include <aversive.h>
+#include <vect_base.h>
+
+/** First byte of a frame. */
+#define TEAM_SYNC_START 0xA8
+
+/** Header length, start byte included. */
+#define TEAM_SYNC_HEADER_LEN 7
+
+/** Number of states kept on each side, power of 2. */
+#define TEAM_SYNC_HISTORY 8
+
+/** Period of team_sync_manage(), in us. */
+#define TEAM_SYNC_PERIOD 50000
+
+/** Default byte budget, in bytes per second. */
+#define TEAM_SYNC_BUDGET 200
+
+/** A frame is sent at least this often, to carry the acks, in us. */
+#define TEAM_SYNC_HEARTBEAT 500000
+
+/** The teammate is considered lost without frame for this long, in us. */
+#define TEAM_SYNC_TIMEOUT 1000000
+
+/** Fields of the shared state, all 16 bits. */
+typedef enum {
+    TEAM_X=0,           /**< Pose, mm, in the frame of our color. */
+    TEAM_Y,
+    TEAM_A,             /**< mrad. */
+    TEAM_LEASE,         /**< Objective we hold a lease on (STRAT_NODE_*), -1 if none. */
+    TEAM_COST,          /**< Cost of the lease, ms. */
+    TEAM_DONE,          /**< Bit n-1 set if objective n is done. */
+    TEAM_OPP1_X,        /**< Opponents seen by our beacon, mm. */
+    TEAM_OPP1_Y,
+    TEAM_OPP2_X,
+    TEAM_OPP2_Y,
+    TEAM_NB_FIELDS
+} team_field_t;
+
+/** Longest payload : every field on 3 bytes. */
+#define TEAM_SYNC_MAX_PAYLOAD (3 * TEAM_NB_FIELDS)
+
+struct team_state {
+    uint8_t seq;                       /**< 0 if the slot is empty. */
+    int16_t f[TEAM_NB_FIELDS];
+};
+
+struct robot_context;
+
+struct team_sync {
+    struct robot_context *ctx;
+    uint8_t id;                        /**< Our index in the team, breaks ties. */
+
+    /* Emission. */
+    struct team_state sent[TEAM_SYNC_HISTORY];
+    uint8_t seq;                       /**< Last seq sent. */
+    uint8_t acked;                     /**< Last of our seq acknowledged, 0 if none. */
+    int32_t last_sent;                 /**< Time of the last frame, in us. */
+    int32_t budget;                    /**< Bytes per second. */
+    int32_t tokens;                    /**< Bytes we can send now, in 1/1000 byte. */
+
+    /* Reception. */
+    struct team_state received[TEAM_SYNC_HISTORY];
+    uint8_t peer_seq;                  /**< Last seq received, sent back as ack. */
+    int32_t peer_time;                 /**< Time of the last valid frame, in us. */
+    uint8_t frame[TEAM_SYNC_HEADER_LEN + TEAM_SYNC_MAX_PAYLOAD + 1];
+    uint8_t frame_pos;
+
+    /* Statistics. */
+    uint32_t bytes_sent;
+    uint32_t frames_sent, frames_received, frames_bad;
+};
+
+/** Inits the sync and schedules team_sync_manage(). Each state received
+ * from the teammate is merged in the claim table of ctx->strat.
+ * @param [in] ctx The robot, ctx->link is the link to use (nothing is sent
+ * while it is NULL). */
+void team_sync_init(struct team_sync *t, struct robot_context *ctx);
+
+/** Sets the number of bytes per second we are allowed to send. */
+void team_sync_set_budget(struct team_sync *t, int32_t bytes_per_second);
+
+/** Reads the frames of the teammate and sends ours if the budget allows it.
+ * @note Compatible with the scheduler, the param is the struct team_sync. */
+void team_sync_manage(void *t);
+
+/** Returns 1 if a frame of the teammate was received recently. */
+int team_sync_peer_alive(struct team_sync *t);
+
+/** Last known state of the teammate, NULL if it is lost. */
+const struct team_state *team_sync_peer(struct team_sync *t);
+
+/** Fills the obstacles known by the teammate : itself and the opponents it
+ * sees, in the frame of our color.
+ * @returns The number of points written, at most max. */
+int team_sync_get_tracks(struct team_sync *t, point_t *points, int max);
+
+#endif
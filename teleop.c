@@ -0,0 +1,143 @@
+/** @file teleop.c
+ * @brief Low-latency velocity teleoperation with a command watchdog.
+ * @sa teleop.h for the frame format.
+ */
+
+#include <aversive.h>
+#include <string.h>
+#include <uptime.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/trajectory_manager.h>
+
+#include "teleop.h"
+
+void teleop_init(struct teleop *t, struct robot_system_holonomic *rs,
+                 struct h_trajectory *traj) {
+    t->rs = rs;
+    t->traj = traj;
+    t->enabled = 0;
+    t->frame_pos = 0;
+    t->rejected_len = t->rejected_pos = 0;
+    t->setpoint_valid = 0;
+    t->speed = t->direction = t->omega = 0;
+    t->last_setpoint_time = 0;
+    t->timeout = TELEOP_DEFAULT_TIMEOUT_MS * 1000;
+    t->watchdog_fired = 0;
+    t->frames_ok = t->frames_bad = 0;
+}
+
+void teleop_enable(struct teleop *t, int32_t timeout_ms) {
+    holonomic_delete_event(t->traj);
+
+    t->timeout = timeout_ms * 1000;
+    t->speed = t->direction = t->omega = 0;
+    t->setpoint_valid = 0;
+    t->watchdog_fired = 0;
+    t->last_setpoint_time = uptime_get();
+    t->enabled = 1;
+}
+
+void teleop_disable(struct teleop *t) {
+    t->enabled = 0;
+    rsh_set_speed(t->rs, 0);
+    rsh_set_rotation_speed(t->rs, 0);
+}
+
+/** Drops the frame being received, its bytes go back to the command line.
+ * The start byte can not be typed, it is not handed back. */
+static void teleop_reject_frame(struct teleop *t) {
+    memcpy(t->rejected, t->frame + 1, t->frame_pos - 1);
+    t->rejected_len = t->frame_pos - 1;
+    t->rejected_pos = 0;
+    t->frame_pos = 0;
+    t->frames_bad++;
+}
+
+/** Decodes a complete frame and publishes it to the control loop. */
+static void teleop_decode_frame(struct teleop *t) {
+    uint8_t checksum = 0;
+    int i;
+
+    for(i=1;i<TELEOP_FRAME_LEN-1;i++)
+        checksum += t->frame[i];
+
+    if(checksum != t->frame[TELEOP_FRAME_LEN-1]) {
+        teleop_reject_frame(t);
+        return;
+    }
+
+    /* The control loop runs in interrupt context and only reads the setpoint
+     * when setpoint_valid is set, so clear it while we write. */
+    t->setpoint_valid = 0;
+    t->setpoint_speed = (int16_t)((t->frame[1] << 8) | t->frame[2]);
+    t->setpoint_direction = (int16_t)((t->frame[3] << 8) | t->frame[4]);
+    t->setpoint_omega = (int16_t)((t->frame[5] << 8) | t->frame[6]);
+    t->setpoint_valid = 1;
+
+    t->frames_ok++;
+}
+
+int teleop_input_char(struct teleop *t, uint8_t c) {
+    int32_t now = uptime_get();
+
+    if(t->frame_pos > 0 && now - t->last_byte_time > TELEOP_BYTE_TIMEOUT)
+        teleop_reject_frame(t);
+
+    if(t->frame_pos == 0) {
+        if(c != TELEOP_FRAME_START)
+            return 0;
+    }
+
+    t->frame[t->frame_pos++] = c;
+    t->last_byte_time = now;
+
+    if(t->frame_pos == TELEOP_FRAME_LEN) {
+        teleop_decode_frame(t);
+        t->frame_pos = 0;
+    }
+
+    return 1;
+}
+
+int teleop_get_rejected(struct teleop *t) {
+    if(t->rejected_pos >= t->rejected_len)
+        return -1;
+    return t->rejected[t->rejected_pos++];
+}
+
+/** Moves value toward zero by at most step. */
+static int32_t teleop_ramp_down(int32_t value, int32_t step) {
+    if(value > step)
+        return value - step;
+    if(value < -step)
+        return value + step;
+    return 0;
+}
+
+void teleop_manage(struct teleop *t) {
+    int32_t now;
+
+    if(!t->enabled)
+        return;
+
+    now = uptime_get();
+
+    if(t->setpoint_valid) {
+        t->speed = t->setpoint_speed;
+        t->direction = t->setpoint_direction;
+        t->omega = t->setpoint_omega;
+        t->setpoint_valid = 0;
+        t->last_setpoint_time = now;
+        t->watchdog_fired = 0;
+    }
+    else if(now - t->last_setpoint_time > t->timeout) {
+        /* Link lost : ramp down instead of keeping the last velocity forever. */
+        t->watchdog_fired = 1;
+        t->speed = teleop_ramp_down(t->speed, TELEOP_SPEED_DECELERATION);
+        t->omega = teleop_ramp_down(t->omega, TELEOP_OMEGA_DECELERATION);
+    }
+
+    rsh_set_speed(t->rs, t->speed);
+    rsh_set_direction_int(t->rs, t->direction);
+    rsh_set_rotation_speed(t->rs, t->omega);
+}
@@ -0,0 +1,125 @@
+/** @file teleop.h
+ * @brief Low-latency velocity teleoperation with a command watchdog.
+ *
+ * The teleop module lets a remote (a joystick bridge or a planner running on
+ * the PC) drive the robot by streaming compact binary velocity setpoints on
+ * the same UART as the command line. Frames start with a byte which can never
+ * be typed in a terminal, so they can be interleaved with shell commands.
+ *
+ * Frame layout (big endian, 8 bytes) :
+ *
+ *     0xA5 | speed (int16, mm/s) | direction (int16, deg) | omega (int16) | checksum
+ *
+ * The checksum is the sum of the 6 payload bytes modulo 256. The direction
+ * is relative to the robot, like the one of the speed command.
+ *
+ * A frame must arrive in one burst : if the gap between two of its bytes
+ * exceeds TELEOP_BYTE_TIMEOUT, it is dropped. The bytes after the start byte
+ * of a dropped frame, or of a frame with a bad checksum, are handed back to
+ * the command line (see teleop_get_rejected()), so a stray start byte does
+ * not swallow what was typed after it.
+ *
+ * A received setpoint is applied at the next control tick. If no setpoint
+ * arrives for longer than the configured timeout, the watchdog ramps the
+ * robot down to a stop.
+ */
+#ifndef _TELEOP_H_
+#define _TELEOP_H_
+
+#include <aversive.h>
+#include <holonomic/robot_system.h>
+#include <holonomic/trajectory_manager.h>
+
+/** First byte of a teleop frame. */
+#define TELEOP_FRAME_START 0xA5
+
+/** Total length of a frame, start byte and checksum included. */
+#define TELEOP_FRAME_LEN 8
+
+/** Longest gap between two bytes of a frame, in us. */
+#define TELEOP_BYTE_TIMEOUT 5000
+
+/** Default watchdog timeout, in ms. */
+#define TELEOP_DEFAULT_TIMEOUT_MS 200
+
+/** Speed decrease applied per control tick when the watchdog fired (mm/s). */
+#define TELEOP_SPEED_DECELERATION 20
+
+/** Rotation speed decrease applied per control tick when the watchdog fired. */
+#define TELEOP_OMEGA_DECELERATION 10
+
+/** Teleoperation state. */
+struct teleop {
+    struct robot_system_holonomic *rs; /**< Robot system we are driving. */
+    struct h_trajectory *traj;         /**< Trajectory manager to stop on enable. */
+
+    uint8_t enabled;                   /**< =1 if setpoints are applied. */
+
+    uint8_t frame[TELEOP_FRAME_LEN];   /**< Frame being received. */
+    uint8_t frame_pos;                 /**< Number of bytes received, 0 if idle. */
+    int32_t last_byte_time;            /**< uptime of the last byte of the frame, in us. */
+
+    uint8_t rejected[TELEOP_FRAME_LEN];/**< Bytes to hand back to the command line. */
+    uint8_t rejected_len;
+    uint8_t rejected_pos;
+
+    /** Last received setpoint, written by the UART side. */
+    volatile int32_t setpoint_speed;
+    volatile int32_t setpoint_direction;
+    volatile int32_t setpoint_omega;
+    volatile uint8_t setpoint_valid;   /**< =1 if a new setpoint is pending. */
+
+    /** Setpoint currently applied by the control loop. */
+    int32_t speed;
+    int32_t direction;
+    int32_t omega;
+
+    int32_t last_setpoint_time;        /**< uptime of the last setpoint, in us. */
+    int32_t timeout;                   /**< Watchdog timeout, in us. */
+    uint8_t watchdog_fired;            /**< =1 if we are ramping down. */
+
+    uint32_t frames_ok;                /**< Number of accepted frames. */
+    uint32_t frames_bad;               /**< Number of frames with a bad checksum or too slow. */
+};
+
+/** Inits the teleop module, disabled.
+ *
+ * @param [in] t The teleop instance.
+ * @param [in] rs The robot system the setpoints are applied to.
+ * @param [in] traj The trajectory manager, stopped when teleop is enabled.
+ */
+void teleop_init(struct teleop *t, struct robot_system_holonomic *rs,
+                 struct h_trajectory *traj);
+
+/** Enables teleoperation.
+ *
+ * The running trajectory is cancelled and the robot holds still until the
+ * first setpoint arrives.
+ * @param [in] timeout_ms Watchdog timeout, in ms.
+ */
+void teleop_enable(struct teleop *t, int32_t timeout_ms);
+
+/** Disables teleoperation and stops the robot. */
+void teleop_disable(struct teleop *t);
+
+/** Feeds a byte received on the UART to the frame decoder.
+ *
+ * @returns 1 if the byte was part of a teleop frame, 0 if it should be given
+ * to the command line instead.
+ */
+int teleop_input_char(struct teleop *t, uint8_t c);
+
+/** Returns the next byte of a rejected frame, or -1 if there is none.
+ *
+ * Drain it after each teleop_input_char(). Its bytes go to the command line
+ * before the byte just fed, if that one was not used.
+ */
+int teleop_get_rejected(struct teleop *t);
+
+/** Applies the pending setpoint and runs the watchdog.
+ *
+ * @note Must be called once per control tick, before rsh_update().
+ */
+void teleop_manage(struct teleop *t);
+
+#endif
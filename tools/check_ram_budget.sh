@@ -0,0 +1,34 @@
+#!/bin/sh
+# check_ram_budget.sh
+#
+# Fails if the static RAM footprint (.data, .bss and their small variants) of
+# a firmware image is bigger than the given budget. Run it on the Nios ELF
+# after each build, so that an overflow shows up on the PC and not as a
+# crashed robot.
+#
+# Usage: tools/check_ram_budget.sh firmware.elf budget_bytes
+#
+# The size tool defaults to nios2-elf-size, set SIZE to use another one.
+
+SIZE=${SIZE:-nios2-elf-size}
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 firmware.elf budget_bytes" >&2
+    exit 2
+fi
+
+ELF=$1
+BUDGET=$2
+
+$SIZE -A "$ELF" | awk -v budget="$BUDGET" '
+    $1 ~ /^\.(s?data|s?bss|rwdata)$/ {
+        printf "%-10s %8d\n", $1, $2
+        total += $2
+    }
+    END {
+        printf "%-10s %8d / %d bytes\n", "total", total, budget
+        if (total > budget) {
+            print "RAM budget exceeded" > "/dev/stderr"
+            exit 1
+        }
+    }'
@@ -0,0 +1,185 @@
+#!/usr/bin/env python
+"""
+rpc_client.py
+
+Host side of the binary RPC channel (see nastya/rpc.h). The requests are
+written on the same serial port as the shell, the text output of the robot
+found between the replies is kept apart.
+
+Many requests can be in flight : send() returns immediately with the request
+id, and replies are matched by id as they come back.
+
+    import serial
+    from rpc_client import RPCClient
+    rpc = RPCClient(serial.Serial("/dev/ttyUSB0", 57600, timeout=0.1))
+    ids = [rpc.send(rpc.GET_STATE) for _ in range(10)]
+    states = [rpc.wait(i) for i in ids]
+
+Usage: rpc_client.py port [method [count]]
+       method is one of ping, position, speed, delta_enc, currents, state.
+"""
+
+import struct
+import sys
+
+REQUEST_START = 0xA6
+REPLY_START = 0xA7
+MAX_PAYLOAD = 64
+
+STATUS_NAMES = {0: "ok", 1: "unknown method", 2: "bad length"}
+
+FLAG_TELEOP = 0x01
+FLAG_FOLLOWER = 0x02
+FLAG_STARTED = 0x04
+FLAG_WATCHDOG = 0x08
+
+
+class RPCError(Exception):
+    pass
+
+
+def _state(payload):
+    fields = struct.unpack(">BIhhhhhhhhhiiihBBB", payload)
+    if fields[0] != 1:
+        raise RPCError("unknown state vector version %d" % fields[0])
+    names = ["version", "uptime", "x", "y", "a_mrad",
+             "speed", "direction", "omega_mrad",
+             "consign_speed", "consign_direction_mrad", "consign_omega",
+             "delta_enc0", "delta_enc1", "delta_enc2",
+             "cs_manage_time_max", "strat_state", "match_time", "flags"]
+    return dict(zip(names, fields))
+
+
+# method name -> (number, reply decoder)
+METHODS = {
+    "ping": (0, lambda p: p),
+    "position": (1, lambda p: dict(zip(["x", "y", "a_mrad"], struct.unpack(">hhh", p)))),
+    "speed": (2, lambda p: dict(zip(["speed", "direction", "omega_mrad"], struct.unpack(">hhh", p)))),
+    "delta_enc": (3, lambda p: list(struct.unpack(">iii", p))),
+    "currents": (4, lambda p: list(struct.unpack(">6i", p))),
+    "state": (5, _state),
+}
+
+
+def checksum(data):
+    return sum(bytearray(data)) & 0xff
+
+
+def encode_request(req_id, method, payload=b""):
+    if len(payload) > MAX_PAYLOAD:
+        raise RPCError("payload too long")
+    body = struct.pack(">BBB", req_id, method, len(payload)) + payload
+    return bytearray([REQUEST_START]) + body + bytearray([checksum(body)])
+
+
+class ReplyParser(object):
+    """Splits the byte stream of the robot in replies and text."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.text = bytearray()
+
+    def feed(self, data):
+        """Returns the list of (id, status, payload) completed by data."""
+        self.buf += bytearray(data)
+        replies = []
+        while self.buf:
+            if self.buf[0] != REPLY_START:
+                self.text.append(self.buf.pop(0))
+                continue
+            if len(self.buf) < 4:
+                break
+            length = self.buf[3]
+            if length > MAX_PAYLOAD:
+                self.text.append(self.buf.pop(0))
+                continue
+            if len(self.buf) < 5 + length:
+                break
+            frame = self.buf[:5 + length]
+            if checksum(frame[1:-1]) != frame[-1]:
+                # Not a reply, just a byte which looks like one.
+                self.text.append(self.buf.pop(0))
+                continue
+            del self.buf[:5 + length]
+            replies.append((frame[1], frame[2], bytes(frame[4:-1])))
+        return replies
+
+
+class RPCClient(object):
+    PING, GET_POSITION, GET_SPEED, GET_DELTA_ENC, GET_CURRENTS, GET_STATE = range(6)
+
+    def __init__(self, port):
+        """port is any object with read(n) and write(data), e.g. serial.Serial."""
+        self.port = port
+        self.parser = ReplyParser()
+        self.next_id = 0
+        self.pending = {}
+        self.replies = {}
+
+    def send(self, method, payload=b""):
+        """Sends a request without waiting, returns its id."""
+        req_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xff
+        if req_id in self.pending:
+            raise RPCError("too many requests in flight")
+        self.pending[req_id] = method
+        self.port.write(bytes(encode_request(req_id, method, payload)))
+        return req_id
+
+    def poll(self):
+        """Reads what is available and stores the replies."""
+        data = self.port.read(max(1, getattr(self.port, "in_waiting", 0)))
+        if not data:
+            return False
+        for req_id, status, payload in self.parser.feed(data):
+            if req_id in self.pending:
+                self.replies[req_id] = (self.pending.pop(req_id), status, payload)
+        return True
+
+    def wait(self, req_id, retries=20):
+        """Returns the decoded reply of a request sent with send()."""
+        while req_id not in self.replies:
+            if not self.poll():
+                retries -= 1
+                if retries == 0:
+                    self.pending.pop(req_id, None)
+                    raise RPCError("timeout waiting for reply %d" % req_id)
+        method, status, payload = self.replies.pop(req_id)
+        if status != 0:
+            raise RPCError(STATUS_NAMES.get(status, "status %d" % status))
+        for number, decoder in METHODS.values():
+            if number == method:
+                return decoder(payload)
+        return payload
+
+    def call(self, method, payload=b""):
+        return self.wait(self.send(method, payload))
+
+    def text(self):
+        """Returns and clears the text output received so far."""
+        text = bytes(self.parser.text)
+        self.parser.text = bytearray()
+        return text
+
+
+def main():
+    import serial
+
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__)
+        sys.exit(1)
+
+    method = sys.argv[2] if len(sys.argv) > 2 else "state"
+    count = int(sys.argv[3]) if len(sys.argv) > 3 else 1
+    if method not in METHODS:
+        sys.stderr.write("unknown method %s\n" % method)
+        sys.exit(1)
+
+    rpc = RPCClient(serial.Serial(sys.argv[1], 57600, timeout=0.1))
+    ids = [rpc.send(METHODS[method][0]) for _ in range(count)]
+    for req_id in ids:
+        print(rpc.wait(req_id))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+"""
+trace2chrome.py
+
+Converts the output of the `trace` command (see nastya/trace.h) to the Chrome
+trace_event JSON format. Open the result in chrome://tracing or Perfetto.
+
+Events recorded in interrupt context are put on their own thread, so the
+preemption of the foreground work (strategy, commands) is visible.
+
+Usage: trace2chrome.py dump.txt > trace.json
+       (reads stdin if no file is given)
+"""
+
+import json
+import sys
+
+# Trace points running from the scheduler interrupt.
+INTERRUPT_EVENTS = set(["scheduler", "cs_manage", "path_follower", "beacon", "speed", "orca"])
+
+FOREGROUND_TID = 0
+INTERRUPT_TID = 1
+
+
+def convert(lines):
+    frequency = 1000000.
+    events = []
+    last = None
+    offset = 0
+
+    for line in lines:
+        line = line.strip()
+        if not line:
+            continue
+
+        if line.startswith("#"):
+            # "# trace <count> events, <freq> Hz"
+            fields = line.split()
+            if len(fields) >= 6 and fields[-1] == "Hz":
+                frequency = float(fields[-2])
+            continue
+
+        fields = line.split()
+        if len(fields) != 4 or fields[0] not in "BEC":
+            continue
+
+        kind, timestamp, name, value = fields[0], int(fields[1]), fields[2], int(fields[3])
+
+        # The timestamps are 32 bits and wrap around.
+        if last is not None and timestamp < last:
+            offset += 1 << 32
+        last = timestamp
+
+        event = {
+            "name": name,
+            "ph": kind,
+            "ts": (timestamp + offset) * 1e6 / frequency,
+            "pid": 1,
+            "tid": INTERRUPT_TID if name in INTERRUPT_EVENTS else FOREGROUND_TID,
+        }
+
+        if kind == "C":
+            event["args"] = {name: value}
+
+        events.append(event)
+
+    metadata = [
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": FOREGROUND_TID,
+         "args": {"name": "foreground"}},
+        {"name": "thread_name", "ph": "M", "pid": 1, "tid": INTERRUPT_TID,
+         "args": {"name": "interrupt"}},
+    ]
+
+    return {"traceEvents": metadata + events, "displayTimeUnit": "ms"}
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1]) as f:
+            lines = f.readlines()
+    else:
+        lines = sys.stdin.readlines()
+
+    json.dump(convert(lines), sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
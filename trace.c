@@ -0,0 +1,117 @@
+/** @file trace.c
+ * @brief Compile-time trace points.
+ * @sa trace.h
+ */
+
+#include <aversive.h>
+
+#include "fmt.h"
+#include "trace.h"
+
+#ifdef TRACE_ENABLED
+
+#ifdef COMPILE_ON_ROBOT
+#include <sys/alt_irq.h>
+#include <sys/alt_timestamp.h>
+#else
+#include <uptime.h>
+#endif
+
+static const char *trace_names[TRACE_NB_IDS] = {
+    "scheduler",
+    "cs_manage",
+    "path_follower",
+    "beacon",
+    "strat",
+    "command",
+    "speed",
+    "orca",
+};
+
+static struct trace_event trace_buffer[TRACE_BUFFER_SIZE];
+static uint16_t trace_head;    /**< Next slot to write. */
+static uint16_t trace_count;   /**< Number of valid events. */
+static volatile uint8_t trace_paused;
+
+#ifdef COMPILE_ON_ROBOT
+static uint8_t trace_started; /**< =1 once the timestamp timer runs. */
+#endif
+
+/** Returns the current timestamp, in CPU cycles on the robot. */
+static uint32_t trace_timestamp(void) {
+#ifdef COMPILE_ON_ROBOT
+    return alt_timestamp();
+#else
+    return uptime_get();
+#endif
+}
+
+/** Returns the frequency of the timestamps, in Hz. */
+static uint32_t trace_timestamp_frequency(void) {
+#ifdef COMPILE_ON_ROBOT
+    return alt_timestamp_freq();
+#else
+    return 1000000;
+#endif
+}
+
+void trace_record(trace_event_type_t type, trace_id_t id, int32_t value) {
+    struct trace_event *e;
+#ifdef COMPILE_ON_ROBOT
+    alt_irq_context ctx;
+#endif
+
+    if(trace_paused)
+        return;
+
+#ifdef COMPILE_ON_ROBOT
+    ctx = alt_irq_disable_all();
+    if(!trace_started) {
+        alt_timestamp_start();
+        trace_started = 1;
+    }
+#endif
+
+    e = &trace_buffer[trace_head];
+    e->timestamp = trace_timestamp();
+    e->value = value;
+    e->type = type;
+    e->id = id;
+
+    trace_head = (trace_head + 1) % TRACE_BUFFER_SIZE;
+    if(trace_count < TRACE_BUFFER_SIZE)
+        trace_count++;
+
+#ifdef COMPILE_ON_ROBOT
+    alt_irq_enable_all(ctx);
+#endif
+}
+
+void trace_dump(void) {
+    static const char types[] = {'B', 'E', 'C'};
+    struct trace_event *e;
+    uint16_t i, start;
+
+    /* Printing takes long, do not let new events overwrite what we print. */
+    trace_paused = 1;
+
+    start = (trace_head + TRACE_BUFFER_SIZE - trace_count) % TRACE_BUFFER_SIZE;
+    fmt_printf("# trace %u events, %u Hz\n", (unsigned int)trace_count,
+           (unsigned int)trace_timestamp_frequency());
+    for(i=0;i<trace_count;i++) {
+        e = &trace_buffer[(start + i) % TRACE_BUFFER_SIZE];
+        fmt_printf("%c %u %s %d\n", types[e->type], (unsigned int)e->timestamp,
+               trace_names[e->id], (int)e->value);
+    }
+
+    trace_paused = 0;
+}
+
+void trace_clear(void) {
+    trace_paused = 1;
+    trace_head = 0;
+    trace_count = 0;
+    trace_paused = 0;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/** @file trace.h
+ * @brief Compile-time trace points.
+ *
+ * The TRACE_BEGIN, TRACE_END and TRACE_COUNTER macros can be placed anywhere,
+ * in interrupt context too. Unless TRACE_ENABLED is defined they compile to
+ * nothing, so they can stay in the code of the match build.
+ *
+ * When enabled, each event is recorded with a timestamp in a RAM ring buffer.
+ * The `trace` command dumps it as text, and tools/trace2chrome.py converts
+ * the dump to the Chrome trace_event JSON format (chrome://tracing or
+ * Perfetto), which shows how the time of each tick is spent and where the
+ * foreground work is preempted by the interrupts.
+ */
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <aversive.h>
+
+/** Number of events kept in the ring buffer. */
+#define TRACE_BUFFER_SIZE 256
+
+/** The instrumented places. Add the name in trace.c too. */
+typedef enum {
+    TRACE_SCHEDULER=0,   /**< scheduler_interrupt(), robot only. */
+    TRACE_CS_MANAGE,     /**< cvra_cs_manage() */
+    TRACE_PATH_FOLLOWER, /**< path_follower_manage() */
+    TRACE_BEACON,        /**< beaconTask() */
+    TRACE_STRAT,         /**< One step of the strategy. */
+    TRACE_COMMAND,       /**< Command line processing. */
+    TRACE_SPEED,         /**< Counter : commanded translation speed. */
+    TRACE_ORCA,          /**< orca_manage() */
+    TRACE_NB_IDS
+} trace_id_t;
+
+typedef enum {
+    TRACE_EVENT_BEGIN=0,
+    TRACE_EVENT_END,
+    TRACE_EVENT_COUNTER
+} trace_event_type_t;
+
+/** A recorded event. */
+struct trace_event {
+    uint32_t timestamp; /**< In ticks of trace_timestamp_frequency(). */
+    int32_t value;      /**< Value of counters. */
+    uint8_t type;       /**< A trace_event_type_t. */
+    uint8_t id;         /**< A trace_id_t. */
+};
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_BEGIN(id) trace_record(TRACE_EVENT_BEGIN, (id), 0)
+#define TRACE_END(id) trace_record(TRACE_EVENT_END, (id), 0)
+#define TRACE_COUNTER(id, value) trace_record(TRACE_EVENT_COUNTER, (id), (int32_t)(value))
+
+/** Records an event, use the macros instead. */
+void trace_record(trace_event_type_t type, trace_id_t id, int32_t value);
+
+/** Prints the content of the buffer, oldest event first. */
+void trace_dump(void);
+
+/** Empties the buffer. */
+void trace_clear(void);
+
+#else
+
+#define TRACE_BEGIN(id) do {} while(0)
+#define TRACE_END(id) do {} while(0)
+#define TRACE_COUNTER(id, value) do {} while(0)
+
+#endif
+
+#endif